@@ -0,0 +1,332 @@
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "eph_block_csr.h"
+
+/*
+ * Checks the block sparse W operator of the PRL model on a cluster of atoms
+ * against a dense W built from the same pairs: W x, W^T x, the adjoint
+ * identity, momentum conservation and the fluctuation-dissipation identity
+ * cov(W xi) = W W^T. Then compares the time of the friction and random
+ * forces through the operator with the pair loops that rebuild the blocks in
+ * every pass.
+ */
+
+struct Pair {
+  int j;
+  double e_ij[3];
+  double inv_r_sq;
+  double rho_ji;
+  double rho_ij;
+};
+
+struct System {
+  size_t n;
+  std::vector<double> x;
+  std::vector<double> rho;
+  std::vector<double> alpha_rho;
+  std::vector<Pair> pairs;
+  std::vector<size_t> pair_first;
+};
+
+constexpr double r_cutoff {5.0};
+
+// model density and coupling with the shape of the real ones
+double get_rho(double r) { return (1. - r / r_cutoff) * (1. - r / r_cutoff); }
+double get_alpha(double rho) { return 0.1 * std::sqrt(rho); }
+
+// fcc cluster with n_cells^3 cells and displaced atoms, full list without ghosts
+System make_system(size_t n_cells, std::mt19937& gen) {
+  const double a {3.52};
+  const double basis[4][3] {{0, 0, 0}, {0.5, 0.5, 0}, {0.5, 0, 0.5}, {0, 0.5, 0.5}};
+  std::uniform_real_distribution<double> u(-0.1, 0.1);
+
+  System s;
+  for(size_t i = 0; i < n_cells; ++i)
+    for(size_t j = 0; j < n_cells; ++j)
+      for(size_t k = 0; k < n_cells; ++k)
+        for(size_t b = 0; b < 4; ++b) {
+          s.x.push_back((i + basis[b][0]) * a + u(gen));
+          s.x.push_back((j + basis[b][1]) * a + u(gen));
+          s.x.push_back((k + basis[b][2]) * a + u(gen));
+        }
+
+  s.n = s.x.size() / 3;
+  s.rho.assign(s.n, 0);
+  s.alpha_rho.assign(s.n, 0);
+
+  for(size_t i = 0; i < s.n; ++i) {
+    s.pair_first.push_back(s.pairs.size());
+    for(size_t j = 0; j < s.n; ++j) {
+      if(i == j) continue;
+      Pair p;
+      double r_sq {0};
+      for(size_t d = 0; d < 3; ++d) {
+        p.e_ij[d] = s.x[3 * j + d] - s.x[3 * i + d];
+        r_sq += p.e_ij[d] * p.e_ij[d];
+      }
+      if(r_sq >= r_cutoff * r_cutoff) continue;
+
+      p.j = j;
+      p.inv_r_sq = 1. / r_sq;
+      p.rho_ji = get_rho(std::sqrt(r_sq));
+      p.rho_ij = p.rho_ji;
+      s.rho[i] += p.rho_ji;
+      s.pairs.push_back(p);
+    }
+  }
+  s.pair_first.push_back(s.pairs.size());
+
+  for(size_t i = 0; i < s.n; ++i) {
+    if(s.rho[i] > 0) s.alpha_rho[i] = get_alpha(s.rho[i]) / s.rho[i];
+  }
+
+  return s;
+}
+
+// pairs as added in FixEPH::calculate_environment()
+void add_pairs(const System& s, EPH_BlockCSR& w) {
+  w.clear();
+  for(size_t i = 0; i < s.n; ++i) {
+    w.add_row();
+    for(size_t p = s.pair_first[i]; p != s.pair_first[i + 1]; ++p) {
+      const Pair& pair = s.pairs[p];
+      w.add_pair(pair.j, pair.e_ij, pair.rho_ji * pair.inv_r_sq, pair.rho_ij * pair.inv_r_sq);
+    }
+  }
+}
+
+// and scaled in FixEPH::force_prl() once alpha_rho of the ghosts is known
+void build(const System& s, EPH_BlockCSR& w) {
+  add_pairs(s, w);
+  w.assemble(s.alpha_rho.data());
+}
+
+// dense W, row major 3n x 3n
+std::vector<double> dense(const System& s) {
+  const size_t m {3 * s.n};
+  std::vector<double> w(m * m, 0);
+  for(size_t i = 0; i < s.n; ++i) {
+    for(size_t p = s.pair_first[i]; p != s.pair_first[i + 1]; ++p) {
+      const Pair& pair = s.pairs[p];
+      double a_ij {s.alpha_rho[i] * pair.rho_ji * pair.inv_r_sq};
+      double a_ji {s.alpha_rho[pair.j] * pair.rho_ij * pair.inv_r_sq};
+      for(size_t k = 0; k < 3; ++k) {
+        for(size_t l = 0; l < 3; ++l) {
+          double ee {pair.e_ij[k] * pair.e_ij[l]};
+          w[(3 * i + k) * m + 3 * i + l] += a_ij * ee;
+          w[(3 * i + k) * m + 3 * pair.j + l] -= a_ji * ee;
+        }
+      }
+    }
+  }
+  return w;
+}
+
+// row pointers into a flat [n][3] array, as LAMMPS per atom arrays
+std::vector<double*> rows(std::vector<double>& v) {
+  std::vector<double*> r(v.size() / 3);
+  for(size_t i = 0; i < r.size(); ++i) r[i] = &(v[3 * i]);
+  return r;
+}
+
+double max_abs(const std::vector<double>& v) {
+  double m {0};
+  for(double a : v) m = std::max(m, std::fabs(a));
+  return m;
+}
+
+bool check(const char* name, double error, double tolerance) {
+  bool ok {error < tolerance};
+  printf("%-40s %.3e %s\n", name, error, ok ? "OK" : "FAILED");
+  return ok;
+}
+
+int main(int args, char **argv) {
+  bool ok {true};
+  std::mt19937 gen(12345);
+  std::normal_distribution<double> normal;
+
+  System s {make_system(2, gen)};
+  const size_t m {3 * s.n};
+
+  EPH_BlockCSR w;
+  build(s, w);
+  std::vector<double> w_dense {dense(s)};
+
+  std::vector<double> x(m), y(m), wx(m), wty(m), ref(m);
+  for(double& v : x) v = normal(gen);
+  for(double& v : y) v = normal(gen);
+
+  auto x_r = rows(x); auto y_r = rows(y); auto wx_r = rows(wx); auto wty_r = rows(wty);
+
+  // W x and W^T x against the dense matrix
+  w.apply(x_r.data(), wx_r.data());
+  for(size_t k = 0; k < m; ++k) {
+    ref[k] = 0;
+    for(size_t l = 0; l < m; ++l) ref[k] += w_dense[k * m + l] * x[l];
+  }
+  double err {0};
+  for(size_t k = 0; k < m; ++k) err = std::max(err, std::fabs(wx[k] - ref[k]));
+  ok = check("W x against dense", err / max_abs(ref), 1e-12) && ok;
+
+  w.apply_transpose(y_r.data(), wty_r.data());
+  for(size_t k = 0; k < m; ++k) {
+    ref[k] = 0;
+    for(size_t l = 0; l < m; ++l) ref[k] += w_dense[l * m + k] * y[l];
+  }
+  err = 0;
+  for(size_t k = 0; k < m; ++k) err = std::max(err, std::fabs(wty[k] - ref[k]));
+  ok = check("W^T y against dense", err / max_abs(ref), 1e-12) && ok;
+
+  // <y, W x> = <W^T y, x>
+  double ywx {0}, wtyx {0};
+  for(size_t k = 0; k < m; ++k) { ywx += y[k] * wx[k]; wtyx += wty[k] * x[k]; }
+  ok = check("<y, W x> - <W^T y, x>", std::fabs(ywx - wtyx) / std::fabs(ywx), 1e-12) && ok;
+
+  // random forces sum to zero and friction does not act on a uniform velocity
+  double sum[3] {0, 0, 0};
+  for(size_t i = 0; i < s.n; ++i) for(size_t d = 0; d < 3; ++d) sum[d] += wx[3 * i + d];
+  ok = check("sum_i (W x)_i", max_abs(std::vector<double>(sum, sum + 3)) / max_abs(wx), 1e-12) && ok;
+
+  std::vector<double> u(m);
+  for(size_t i = 0; i < s.n; ++i) { u[3 * i] = 1.; u[3 * i + 1] = -2.; u[3 * i + 2] = 0.5; }
+  auto u_r = rows(u);
+  w.apply_transpose(u_r.data(), wty_r.data());
+  ok = check("W^T v for a uniform v", max_abs(wty) / max_abs(wx), 1e-12) && ok;
+
+  // the fused pass gives the same numbers as two passes
+  std::vector<double> wy(m), f1(m), f2(m);
+  auto wy_r = rows(wy); auto f1_r = rows(f1); auto f2_r = rows(f2);
+  w.apply(y_r.data(), wy_r.data());
+  w.apply(x_r.data(), f1_r.data(), y_r.data(), f2_r.data());
+  ok = check("fused apply against two passes", (f1 == wx && f2 == wy) ? 0. : 1., 0.5) && ok;
+
+  // rows split into blocks of atoms (one per thread in FixEPHOMP) give the same numbers
+  const size_t n_blocks {3};
+  std::vector<double> bx(m), bty(m);
+  auto bx_r = rows(bx); auto bty_r = rows(bty);
+  w.apply_transpose(y_r.data(), wty_r.data());
+  for(size_t b = 0; b < n_blocks; ++b) {
+    EPH_BlockCSR w_block;
+    w_block.first_row = (s.n * b) / n_blocks;
+    for(size_t i = w_block.first_row; i < (s.n * (b + 1)) / n_blocks; ++i) {
+      w_block.add_row();
+      for(size_t p = s.pair_first[i]; p != s.pair_first[i + 1]; ++p) {
+        const Pair& pair = s.pairs[p];
+        w_block.add_pair(pair.j, pair.e_ij, pair.rho_ji * pair.inv_r_sq, pair.rho_ij * pair.inv_r_sq);
+      }
+    }
+    w_block.assemble(s.alpha_rho.data());
+    w_block.apply(x_r.data(), bx_r.data());
+    w_block.apply_transpose(y_r.data(), bty_r.data());
+  }
+  ok = check("blocks of rows against one operator", (bx == wx && bty == wty) ? 0. : 1., 0.5) && ok;
+
+  // fluctuation-dissipation: cov(W xi) over samples against B = W W^T
+  std::vector<double> b(m * m, 0);
+  for(size_t k = 0; k < m; ++k)
+    for(size_t l = 0; l < m; ++l)
+      for(size_t q = 0; q < m; ++q) b[k * m + l] += w_dense[k * m + q] * w_dense[l * m + q];
+
+  constexpr size_t n_samples {100000};
+  std::vector<double> cov(m * m, 0), xi(m), f(m);
+  auto xi_r = rows(xi); auto f_r = rows(f);
+  for(size_t sample = 0; sample < n_samples; ++sample) {
+    for(double& v : xi) v = normal(gen);
+    w.apply(xi_r.data(), f_r.data());
+    for(size_t k = 0; k < m; ++k)
+      for(size_t l = 0; l < m; ++l) cov[k * m + l] += f[k] * f[l];
+  }
+  err = 0;
+  for(size_t k = 0; k < m * m; ++k) err = std::max(err, std::fabs(cov[k] / n_samples - b[k]));
+  // sampling error of a covariance is about sqrt(2 / n_samples) of the diagonal
+  ok = check("cov(W xi) - W W^T", err / max_abs(b), 10. * std::sqrt(2. / n_samples)) && ok;
+
+  // friction -W W^T v through the operator against B v
+  w.apply_transpose(x_r.data(), wty_r.data());
+  w.apply(wty_r.data(), f_r.data());
+  for(size_t k = 0; k < m; ++k) {
+    ref[k] = 0;
+    for(size_t l = 0; l < m; ++l) ref[k] += b[k * m + l] * x[l];
+  }
+  err = 0;
+  for(size_t k = 0; k < m; ++k) err = std::max(err, std::fabs(f[k] - ref[k]));
+  ok = check("W W^T v against B v", err / max_abs(ref), 1e-12) && ok;
+
+  // timing on a larger cluster
+  System t {make_system(10, gen)};
+  const size_t mt {3 * t.n};
+  std::vector<double> v(mt), w_i(mt), xi_t(mt), f_eph(mt), f_rng(mt);
+  for(double& a : v) a = normal(gen);
+  for(double& a : xi_t) a = normal(gen);
+  auto v_r = rows(v); auto w_r = rows(w_i); auto xi_tr = rows(xi_t);
+  auto fe_r = rows(f_eph); auto fr_r = rows(f_rng);
+
+  constexpr size_t repeats {20};
+  EPH_BlockCSR wt;
+
+  // pair loops of the PRL model: w = W^T v, then W w and W xi with the blocks rebuilt each time
+  auto t_0 = std::chrono::steady_clock::now();
+  for(size_t r = 0; r < repeats; ++r) {
+    std::fill(w_i.begin(), w_i.end(), 0);
+    std::fill(f_eph.begin(), f_eph.end(), 0);
+    std::fill(f_rng.begin(), f_rng.end(), 0);
+    for(size_t i = 0; i < t.n; ++i) {
+      for(size_t p = t.pair_first[i]; p != t.pair_first[i + 1]; ++p) {
+        const Pair& pair = t.pairs[p];
+        const double* e = pair.e_ij;
+        double prescaler {t.alpha_rho[i] * pair.rho_ji * pair.inv_r_sq};
+        double dvar {prescaler * (e[0] * v_r[i][0] + e[1] * v_r[i][1] + e[2] * v_r[i][2])
+          - prescaler * (e[0] * v_r[pair.j][0] + e[1] * v_r[pair.j][1] + e[2] * v_r[pair.j][2])};
+        for(size_t d = 0; d < 3; ++d) w_r[i][d] += dvar * e[d];
+      }
+    }
+    for(size_t i = 0; i < t.n; ++i) {
+      for(size_t p = t.pair_first[i]; p != t.pair_first[i + 1]; ++p) {
+        const Pair& pair = t.pairs[p];
+        const double* e = pair.e_ij;
+        const int j {pair.j};
+        double var1 {t.alpha_rho[i] * pair.rho_ji * (e[0] * w_r[i][0] + e[1] * w_r[i][1] + e[2] * w_r[i][2]) * pair.inv_r_sq};
+        double var2 {t.alpha_rho[j] * pair.rho_ij * (e[0] * w_r[j][0] + e[1] * w_r[j][1] + e[2] * w_r[j][2]) * pair.inv_r_sq};
+        for(size_t d = 0; d < 3; ++d) fe_r[i][d] -= (var1 - var2) * e[d];
+
+        var1 = t.alpha_rho[i] * pair.rho_ji * (e[0] * xi_tr[i][0] + e[1] * xi_tr[i][1] + e[2] * xi_tr[i][2]) * pair.inv_r_sq;
+        var2 = t.alpha_rho[j] * pair.rho_ij * (e[0] * xi_tr[j][0] + e[1] * xi_tr[j][1] + e[2] * xi_tr[j][2]) * pair.inv_r_sq;
+        for(size_t d = 0; d < 3; ++d) fr_r[i][d] += (var1 - var2) * e[d];
+      }
+    }
+  }
+  auto t_1 = std::chrono::steady_clock::now();
+  double norm_pairs {0};
+  for(size_t k = 0; k < mt; ++k) norm_pairs += f_eph[k] * f_eph[k] + f_rng[k] * f_rng[k];
+
+  // operator: pairs come from the density loop as the pair cache does, the step
+  // scales them once, applies W^T v and one fused pass for W w and W xi
+  double t_operator {0};
+  for(size_t r = 0; r < repeats; ++r) {
+    add_pairs(t, wt);
+
+    auto t_2 = std::chrono::steady_clock::now();
+    wt.assemble(t.alpha_rho.data());
+    wt.apply_transpose(v_r.data(), w_r.data());
+    wt.apply(w_r.data(), fe_r.data(), xi_tr.data(), fr_r.data());
+    auto t_3 = std::chrono::steady_clock::now();
+
+    t_operator += std::chrono::duration<double>(t_3 - t_2).count() / repeats;
+  }
+  double norm_operator {0};
+  for(size_t k = 0; k < mt; ++k) norm_operator += f_eph[k] * f_eph[k] + f_rng[k] * f_rng[k];
+
+  double t_pairs {std::chrono::duration<double>(t_1 - t_0).count() / repeats};
+  printf("%zu atoms, %zu pairs\n", t.n, t.pairs.size());
+  printf("pair loops %8.3f ms per step (|f|^2 %.10e)\n", 1e3 * t_pairs, norm_pairs);
+  printf("operator   %8.3f ms per step (|f|^2 %.10e); speedup %.2f\n", 1e3 * t_operator, norm_operator, t_pairs / t_operator);
+
+  return ok ? 0 : 1;
+}
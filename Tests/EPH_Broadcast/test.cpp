@@ -0,0 +1,96 @@
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <mpi.h>
+
+#include "eph_beta.h"
+#include "eph_broadcast.h"
+
+/*
+ * Checks that a beta(rho) file read on task 0 and broadcast gives the same
+ * tables on every task as reading the file directly, and that a truncated
+ * file is reported instead of being read. Run with several tasks.
+ */
+
+// max. absolute difference of rho(r), beta(rho) and alpha(rho) over a fine grid
+double compare(const Beta& a, const Beta& b) {
+  double max_diff {0};
+
+  for(size_t e = 0; e < a.get_n_elements(); ++e) {
+    if(a.get_element_name(e) != b.get_element_name(e) || a.get_element_number(e) != b.get_element_number(e))
+      return INFINITY;
+
+    for(size_t i = 0; i < 1000; ++i) {
+      double r = a.get_r_cutoff() * i / 1000;
+      double rho = a.get_rho_cutoff() * i / 1000;
+
+      max_diff = std::max(max_diff, std::fabs(a.get_rho(e, r) - b.get_rho(e, r)));
+      max_diff = std::max(max_diff, std::fabs(a.get_rho_r_sq(e, r * r) - b.get_rho_r_sq(e, r * r)));
+      max_diff = std::max(max_diff, std::fabs(a.get_beta(e, rho) - b.get_beta(e, rho)));
+      max_diff = std::max(max_diff, std::fabs(a.get_alpha(e, rho) - b.get_alpha(e, rho)));
+    }
+  }
+
+  return max_diff;
+}
+
+int main(int args, char **argv) {
+  MPI_Init(&args, &argv);
+
+  int my_id, nr_ps;
+  MPI_Comm_rank(MPI_COMM_WORLD, &my_id);
+  MPI_Comm_size(MPI_COMM_WORLD, &nr_ps);
+
+  bool ok {true};
+
+  for(const char* file : {"../../Data/Ni/Ni_PRB2019.beta", "../../Data/NiCoCrFe/NiCoCrFe_PRB2019.beta"}) {
+    double t0 = MPI_Wtime();
+    Beta local(file);
+    double t1 = MPI_Wtime();
+    Beta broadcast(eph_broadcast_table(file, MPI_COMM_WORLD));
+    double t2 = MPI_Wtime();
+
+    double diff = compare(local, broadcast);
+    bool same {diff == 0 && local.get_n_elements() == broadcast.get_n_elements()
+      && local.get_r_cutoff() == broadcast.get_r_cutoff() && local.get_rho_cutoff() == broadcast.get_rho_cutoff()};
+
+    int all_same = same;
+    MPI_Allreduce(MPI_IN_PLACE, &all_same, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+
+    if(my_id == 0) {
+      printf("%s: %zu elements, read %.3f s, broadcast to %d tasks %.3f s %s\n", file,
+        broadcast.get_n_elements(), t1 - t0, nr_ps, t2 - t1, all_same ? "OK" : "FAILED");
+    }
+
+    ok = ok && all_same;
+  }
+
+  // a file that ends early
+  if(my_id == 0) {
+    std::ifstream in("../../Data/Ni/Ni_PRB2019.beta");
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string data {ss.str()};
+
+    std::ofstream out("test_truncated.beta");
+    out << data.substr(0, data.size() / 2);
+    out.close();
+
+    bool thrown {false};
+    try { Beta broken("test_truncated.beta"); }
+    catch(std::runtime_error& e) { thrown = true; }
+    remove("test_truncated.beta");
+
+    printf("truncated file: %s\n", thrown ? "OK" : "FAILED");
+    ok = ok && thrown;
+
+    printf("%s\n", ok ? "ALL OK" : "SOME FAILED");
+  }
+
+  MPI_Finalize();
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <mpi.h>
+
+#include "eph_fdm.h"
+
+/*
+ * Saves a grid with varying node values, flags and temperature dependent
+ * parameters in the text and in the binary state format and loads it again,
+ * serially and broadcast from task 0. A binary round trip has to be exact,
+ * and the text written from a loaded binary state has to be identical to the
+ * text written from the original grid. Run with several tasks to check the
+ * broadcast.
+ */
+
+// grid size
+constexpr unsigned int n_x {24};
+constexpr unsigned int n_y {12};
+constexpr unsigned int n_z {6};
+
+// grid extent
+constexpr double x_0 {-10.0};
+constexpr double x_1 { 10.0};
+constexpr double y_0 {-5.0};
+constexpr double y_1 { 5.0};
+constexpr double z_0 {-2.5};
+constexpr double z_1 { 2.5};
+
+constexpr double dt {0.001};
+constexpr unsigned int max_steps {20};
+
+// C_e(T) and kappa_e(T) with the layout of the FDM parameter files
+void write_parameters(const char* filename) {
+  FILE* fd = fopen(filename, "w");
+  fprintf(fd, "# parameters\n#\n#\n");
+  fprintf(fd, "100 100.0\n");
+  for(int i = 0; i < 100; ++i) { fprintf(fd, "%.6e %.6e\n", 1.0 + 0.01 * i, 2.0 - 0.01 * i); }
+  fclose(fd);
+}
+
+void write_state_file(const char* filename) {
+  FILE* fd = fopen(filename, "w");
+  fprintf(fd, "# state\n#\n#\n");
+  fprintf(fd, "%u %u %u 1\n", n_x, n_y, n_z);
+  fprintf(fd, "%.6e %.6e\n%.6e %.6e\n%.6e %.6e\n", x_0, x_1, y_0, y_1, z_0, z_1);
+  fprintf(fd, "State_Parameters.data\n");
+
+  for(unsigned int k = 0; k < n_z; ++k) {
+    for(unsigned int j = 0; j < n_y; ++j) {
+      for(unsigned int i = 0; i < n_x; ++i) {
+        double T = 300.0 + 50.0 * std::sin(0.3 * i) * std::cos(0.5 * j) + 7.0 * k;
+        int flag = (i == 0 || i == n_x - 1) ? 0 : (j == 0 ? 2 : 1);
+        int T_dynamic = (i + j + k) % 3 == 0;
+        fprintf(fd, "%u %u %u %.6e %.6e %.6e %.6e %.6e %d %d\n",
+          i, j, k, T, 0.01 * (i % 5), 1.0, 1.0 + 0.1 * k, 0.5 + 0.01 * j, flag, T_dynamic);
+      }
+    }
+  }
+
+  fclose(fd);
+}
+
+std::string read_file(const char* filename) {
+  std::ifstream fd {filename, std::ios::binary};
+  std::stringstream ss;
+  ss << fd.rdbuf();
+  return ss.str();
+}
+
+// temperatures after a few steps, to compare the loaded parameters
+double run(EPH_FDM& electrons, int my_id, int nr_ps) {
+  electrons.set_comm(MPI_COMM_WORLD, my_id, nr_ps);
+  electrons.set_dt(dt);
+
+  for(unsigned int step = 0; step < max_steps; ++step) { electrons.solve(); }
+
+  return electrons.get_T_total();
+}
+
+int main(int args, char **argv) {
+  MPI_Init(&args, &argv);
+
+  int my_id, nr_ps;
+  MPI_Comm_rank(MPI_COMM_WORLD, &my_id);
+  MPI_Comm_size(MPI_COMM_WORLD, &nr_ps);
+
+  bool ok {true};
+
+  if(my_id == 0) {
+    write_parameters("State_Parameters.data");
+    write_state_file("State_Text.data");
+
+    EPH_FDM text {"State_Text.data"};
+    text.save_state("State_Text_Again.data");
+
+    text.set_binary_state(true);
+    text.save_state("State_Binary.data");
+
+    EPH_FDM binary {"State_Binary.data"};
+    binary.set_binary_state(true);
+    binary.save_state("State_Binary_Again.data");
+
+    binary.set_binary_state(false);
+    binary.save_state("State_From_Binary.data");
+
+    bool same_text {read_file("State_Text_Again.data") == read_file("State_From_Binary.data")};
+    bool same_binary {read_file("State_Binary.data") == read_file("State_Binary_Again.data")};
+
+    printf("text from binary state: %s\n", same_text ? "OK" : "FAILED");
+    printf("binary round trip: %s\n", same_binary ? "OK" : "FAILED");
+    printf("size text %zu binary %zu\n", read_file("State_Text_Again.data").size(), read_file("State_Binary.data").size());
+
+    ok = same_text && same_binary;
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // every task loads the same grid, with and without the broadcast
+  for(const char* filename : {"State_Text.data", "State_Binary.data"}) {
+    EPH_FDM local {filename};
+    EPH_FDM broadcast {filename, MPI_COMM_WORLD};
+
+    double T_local = run(local, my_id, 1);
+    double T_broadcast = run(broadcast, my_id, 1);
+
+    bool same {T_local == T_broadcast && std::isfinite(T_local)};
+    int all_same = same;
+    MPI_Allreduce(MPI_IN_PLACE, &all_same, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+
+    if(my_id == 0) { printf("%s broadcast to %d tasks: T %.10e %s\n", filename, nr_ps, T_broadcast, all_same ? "OK" : "FAILED"); }
+    ok = ok && all_same;
+  }
+
+  // a broken file is reported, not read
+  if(my_id == 0) {
+    std::string data {read_file("State_Binary.data")};
+    std::ofstream fd {"State_Truncated.data", std::ios::binary};
+    fd.write(data.data(), data.size() / 2);
+    fd.close();
+
+    bool thrown {false};
+    try { EPH_FDM broken {"State_Truncated.data"}; }
+    catch(std::runtime_error& e) { thrown = true; }
+
+    printf("truncated binary state: %s\n", thrown ? "OK" : "FAILED");
+    ok = ok && thrown;
+
+    for(const char* filename : {"State_Parameters.data", "State_Text.data", "State_Text_Again.data",
+      "State_Binary.data", "State_Binary_Again.data", "State_From_Binary.data", "State_Truncated.data"}) {
+      remove(filename);
+    }
+
+    printf("%s\n", ok ? "ALL OK" : "SOME FAILED");
+  }
+
+  MPI_Finalize();
+
+  return ok ? 0 : 1;
+}
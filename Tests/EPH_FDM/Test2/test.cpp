@@ -1,5 +1,6 @@
 
 #include <iostream>
+#include <string>
 #include <cmath>
 #include <mpi.h>
 
@@ -53,7 +54,10 @@ constexpr const char* save {"Out/T_out"};
 double dE[n_x]; // per timestep in eV
 
 // electrons as an FDM system
-EPH_FDM electrons {n_x, n_y, n_z};
+EPH_FDM electrons {
+  n_x, n_y, n_z,
+  x_0, x_1, y_0, y_1, z_0, z_1,
+  T_e, c_e, rho_e, kappa_e};
 
 // laser profile
 // v1 delta function with 
@@ -69,12 +73,12 @@ void laser_hit() {
 void add_energy(double t) {
   if(t >= t_0 && t < (t_1)) {
     for(unsigned int i = 0; i < n_x; ++i) {
-      electrons.setS(i, 0, 0, dE[i]);
+      electrons.set_S(i, 0, 0, dE[i]);
     }
   }
   else {
     for(unsigned int i = 0; i < n_x; ++i) {
-      electrons.setS(i, 0, 0, 0.0);
+      electrons.set_S(i, 0, 0, 0.0);
     }
   }
 }
@@ -88,12 +92,14 @@ int main(int args, char **argv) {
   MPI_Comm_rank(MPI_COMM_WORLD, &my_id);
   MPI_Comm_size(MPI_COMM_WORLD, &nr_ps);
   
-  electrons.setComm(MPI_COMM_WORLD, my_id, nr_ps);
-  electrons.setBox(x_0, x_1, y_0, y_1, z_0, z_1);
+  electrons.set_comm(MPI_COMM_WORLD, my_id, nr_ps);
+  electrons.set_steps(min_steps); // minimum nr. of steps
+  electrons.set_dt(dt); // in ps
   
-  electrons.setConstants(T_e, c_e, rho_e, kappa_e);
-  electrons.setSteps(min_steps); // minimum nr. of steps
-  electrons.setDt(dt); // in ps
+  // pass "implicit" to use the ADI solver
+  if(args > 1 && std::string(argv[1]) == "implicit") {
+    electrons.set_implicit(true);
+  }
   
   laser_hit();
   
@@ -102,14 +108,14 @@ int main(int args, char **argv) {
     electrons.set_C_e(i, 0, 0, 2.0 * c_e + c_e * sin(i*2.0*M_PI / n_x));
   }
   
-  //electrons.saveState("T_before.data");
+  //electrons.save_state("T_before.data");
   
   for(unsigned int i = 0; i <= max_steps; ++i) {
     add_energy(i*dt);
     electrons.solve();
     
     if(i%save_freq == 0) {
-      printf("Saving step %06d; t = %8.3f ps; T = %8.3f K;\n", i, dt*i, electrons.calcTtotal());
+      printf("Saving step %06d; t = %8.3f ps; T = %8.3f K;\n", i, dt*i, electrons.get_T_total());
       switch (i/save_freq) {
         case 0:
         case 1:
@@ -119,7 +125,7 @@ int main(int args, char **argv) {
         case 16:
         case 32:
         case 64:
-          electrons.saveTemperature(save, i/save_freq);
+          electrons.save_temperature(save, i/save_freq);
           break;
         default:
           break;
@@ -127,7 +133,7 @@ int main(int args, char **argv) {
     }
   }
   
-  //electrons.saveState("T_after.data");
+  //electrons.save_state("T_after.data");
   
   // do the MPI_Finalise
   MPI_Finalize();
@@ -1,133 +1,156 @@
-
 #include <iostream>
+#include <vector>
 #include <cmath>
+#include <cstring>
+#include <chrono>
 #include <mpi.h>
 
 #include "eph_fdm.h"
 
-/* 
+/*
  * This example will create an electronic system and heat it from one end with
- * a laser source.
+ * a laser source (1000x2x4 grid, 64 ps, heat maps in Out/).
+ *
+ * ./test_omp omp: a 256x128x64 system is solved with one thread and with
+ * all threads and the speedup is reported. The results have to be identical.
+ *
+ * ./test bench: the explicit solver against a copy of the stencil it had
+ * before the padded kernel, on one core, on the 1000x2x4 and 128^3 grids.
  */
 
-// grid size
-constexpr unsigned int n_x {1000};
-constexpr unsigned int n_y {2};
-constexpr unsigned int n_z {4};
-
-// grid extent
-constexpr double x_0 {-10.0};
-constexpr double x_1 { 10.0};
-constexpr double y_0 {-2.0};
-constexpr double y_1 { 2.0};
-constexpr double z_0 {-4.0};
-constexpr double z_1 { 4.0};
-constexpr double d_x {(x_1-x_0)/n_x};
-constexpr double d_y {(y_1-y_0)/n_y};
-constexpr double d_z {(z_1-z_0)/n_z};
-
 // electronic system properties
 constexpr double c_e {1.0}; // in eV
 constexpr double rho_e {1.0}; // scaling factor
 constexpr double kappa_e {1.0};
 constexpr double T_e {1.0}; // initial temperature
 
-constexpr double t_0 {0.0}; // laser turned on
-constexpr double t_1 {1.0}; // laser turned off
 constexpr double Q {10.0}; // laser power
 
 // solver proeprties
 constexpr unsigned int min_steps {1};
-constexpr double dt {0.0001};
-
-// simulation properties
-constexpr double max_T {64.0};
-constexpr double freq_t {1.0};
-
-constexpr unsigned int max_steps {static_cast<unsigned int> (max_T/dt)};
-constexpr unsigned int save_freq {static_cast<unsigned int> (freq_t/dt)};
 
-constexpr const char* save {"Out/T_out"};
+// grid of the runs below, C_e as 1+sin(x) and kappa_e as 1-sin(x)
+struct Grid {
+  unsigned int n_x, n_y, n_z;
+  double x_0, x_1, y_0, y_1, z_0, z_1;
 
-int on_off = 0;
+  double d_x() const { return (x_1 - x_0) / n_x; }
+  double d_y() const { return (y_1 - y_0) / n_y; }
+  double d_z() const { return (z_1 - z_0) / n_z; }
 
-// energy transfer from laser to electronic system
-double dE[n_x]; // per timestep in eV
+  double get_C_e(unsigned int i) const { return 2.0 * c_e + c_e * sin(i*2.0*M_PI / n_x); }
+  double get_kappa_e(unsigned int i) const { return 2.0 * kappa_e - kappa_e * sin(i*2.0*M_PI / n_x); }
 
-// electrons as an FDM system
-EPH_FDM electrons {n_x, n_y, n_z};
+  EPH_FDM create(int my_id, int nr_ps, double dt) const {
+    EPH_FDM electrons {
+      n_x, n_y, n_z,
+      x_0, x_1, y_0, y_1, z_0, z_1,
+      T_e, c_e, rho_e, kappa_e};
 
-// laser profile
-// v1 delta function with 
-void laser_hit() {
-  double d_V = d_x*d_y*d_z;
-  for(int i = 0; i < n_x; ++i) {
-    if((x_0 + i*d_x) == 0) dE[i] = Q / d_V;
-    else dE[i] = 0.0;
-  }
-}
+    electrons.set_comm(MPI_COMM_WORLD, my_id, nr_ps);
+    electrons.set_steps(min_steps); // minimum nr. of steps
+    electrons.set_dt(dt); // in ps
 
-// laser profile to energy input into the system
-void add_energy(double t) {
-  if((t >= t_0 && t < (t_1)) && !on_off) {
-    on_off = 1;
     for(unsigned int k = 0; k < n_z; ++k) {
       for(unsigned int j = 0; j < n_y; ++j) {
         for(unsigned int i = 0; i < n_x; ++i) {
-          electrons.setS(i, j, k, dE[i]);
+          electrons.set_C_e(i, j, k, get_C_e(i));
+          electrons.set_kappa_e(i, j, k, get_kappa_e(i));
         }
       }
     }
+
+    return electrons;
   }
-  else if((t < t_0 || t >= (t_1)) && on_off){
+
+  // largest difference of the temperatures at the cell centres
+  template<typename GetT>
+  double compare(const EPH_FDM& a, GetT b) const {
+    double max_diff = 0;
     for(unsigned int k = 0; k < n_z; ++k) {
       for(unsigned int j = 0; j < n_y; ++j) {
         for(unsigned int i = 0; i < n_x; ++i) {
-          electrons.setS(i, j, k, 0.0);
+          double x = x_0 + (i + 0.5) * d_x();
+          double y = y_0 + (j + 0.5) * d_y();
+          double z = z_0 + (k + 0.5) * d_z();
+          max_diff = std::max(max_diff, std::fabs(a.get_T(x, y, z) - b(i, j, k)));
         }
       }
     }
-    
-    on_off = 0;
+
+    return max_diff;
   }
+};
+
+// run the solver and return the time in seconds
+double run(EPH_FDM& electrons, unsigned int n) {
+  auto t_0 = std::chrono::steady_clock::now();
+
+  for(unsigned int i = 0; i < n; ++i) {
+    electrons.solve();
+  }
+
+  auto t_1 = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double>(t_1 - t_0).count();
 }
 
-int main(int args, char **argv) {
-  // do the MPI_Init
-  int my_id;
-  int nr_ps;
-  
-  MPI_Init(&args, &argv);
-  MPI_Comm_rank(MPI_COMM_WORLD, &my_id);
-  MPI_Comm_size(MPI_COMM_WORLD, &nr_ps);
-  
-  electrons.setComm(MPI_COMM_WORLD, my_id, nr_ps);
-  electrons.setBox(x_0, x_1, y_0, y_1, z_0, z_1);
-  
-  electrons.setConstants(T_e, c_e, rho_e, kappa_e);
-  electrons.setSteps(min_steps); // minimum nr. of steps
-  electrons.setDt(dt); // in ps
-  
-  laser_hit();
-  
-  /** define C_e as 1+sin(x) **/
-  for(unsigned int k = 0; k < n_z; ++k) {
-    for(unsigned int j = 0; j < n_y; ++j) {
-      for(unsigned int i = 0; i < n_x; ++i) {
-        electrons.set_C_e(i, j, k, 2.0 * c_e + c_e * sin(i*2.0*M_PI / n_x));
-        electrons.set_kappa_e(i, j, k, 2.0 * kappa_e - kappa_e * sin(i*2.0*M_PI / n_x));
-      }
-    }
+/*
+ * laser hitting the x = 0 plane during the first ps
+ */
+void laser(int my_id, int nr_ps) {
+  const Grid grid {1000, 2, 4, -10.0, 10.0, -2.0, 2.0, -4.0, 4.0};
+
+  constexpr double t_0 {0.0}; // laser turned on
+  constexpr double t_1 {1.0}; // laser turned off
+  constexpr double dt {0.0001};
+
+  // simulation properties
+  constexpr double max_T {64.0};
+  constexpr double freq_t {1.0};
+
+  constexpr unsigned int max_steps {static_cast<unsigned int> (max_T/dt)};
+  constexpr unsigned int save_freq {static_cast<unsigned int> (freq_t/dt)};
+
+  constexpr const char* save {"Out/T_out"};
+
+  EPH_FDM electrons = grid.create(my_id, nr_ps, dt);
+
+  // energy transfer from laser to electronic system
+  // v1 delta function with
+  const double d_V = grid.d_x() * grid.d_y() * grid.d_z();
+  std::vector<double> dE(grid.n_x); // per timestep in eV
+  for(unsigned int i = 0; i < grid.n_x; ++i) {
+    if((grid.x_0 + i*grid.d_x()) == 0) dE[i] = Q / d_V;
+    else dE[i] = 0.0;
   }
-  
-  //electrons.saveState("T_before.data");
-  
+
+  // laser profile to energy input into the system
+  int on_off = 0;
+  auto add_energy = [&](double t) {
+    if((t >= t_0 && t < t_1) && !on_off) {
+      on_off = 1;
+      for(unsigned int k = 0; k < grid.n_z; ++k)
+        for(unsigned int j = 0; j < grid.n_y; ++j)
+          for(unsigned int i = 0; i < grid.n_x; ++i)
+            electrons.set_S(i, j, k, dE[i]);
+    }
+    else if((t < t_0 || t >= t_1) && on_off) {
+      for(unsigned int k = 0; k < grid.n_z; ++k)
+        for(unsigned int j = 0; j < grid.n_y; ++j)
+          for(unsigned int i = 0; i < grid.n_x; ++i)
+            electrons.set_S(i, j, k, 0.0);
+
+      on_off = 0;
+    }
+  };
+
   for(unsigned int i = 0; i <= max_steps; ++i) {
     add_energy(i*dt);
     electrons.solve();
-    
+
     if(i%save_freq == 0) {
-      printf("Saving step %06d; t = %8.3f ps; T = %8.3f K;\n", i, dt*i, electrons.calcTtotal());
+      printf("Saving step %06d; t = %8.3f ps; T = %8.3f K;\n", i, dt*i, electrons.get_T_total());
       switch (i/save_freq) {
         case 0:
         case 1:
@@ -137,19 +160,257 @@ int main(int args, char **argv) {
         case 16:
         case 32:
         case 64:
-          electrons.saveTemperature(save, i/save_freq);
+          electrons.save_temperature(save, i/save_freq);
           break;
         default:
           break;
       }
     }
   }
-  
-  //electrons.saveState("T_after.data");
-  
+}
+
+/*
+ * threaded solvers against one thread
+ */
+void omp(int my_id, int nr_ps) {
+  const Grid grid {256, 128, 64, -10.0, 10.0, -5.0, 5.0, -2.5, 2.5};
+
+  constexpr double dt {0.001};
+  constexpr unsigned int max_steps {10};
+
+  // laser hitting the x = 0 plane
+  auto create_electrons = [&](bool implicit) {
+    EPH_FDM electrons = grid.create(my_id, nr_ps, dt);
+    electrons.set_implicit(implicit);
+
+    for(unsigned int k = 0; k < grid.n_z; ++k)
+      for(unsigned int j = 0; j < grid.n_y; ++j)
+        electrons.set_S(grid.n_x / 2, j, k, Q / (grid.d_x()*grid.d_y()*grid.d_z()));
+
+    return electrons;
+  };
+
+  for(bool implicit : {false, true}) {
+    const char* name = implicit ? "implicit" : "explicit";
+
+    EPH_FDM serial = create_electrons(implicit);
+#ifdef EPH_OMP
+    int threads = omp_get_max_threads();
+    omp_set_num_threads(1);
+#endif
+    double t_serial = run(serial, max_steps);
+    printf("%s: serial %8.3f s; T = %8.5f K;\n", name, t_serial, serial.get_T_total());
+
+#ifdef EPH_OMP
+    EPH_FDM threaded = create_electrons(implicit);
+    omp_set_num_threads(threads);
+    double t_threaded = run(threaded, max_steps);
+
+    double max_diff = grid.compare(serial,
+      [&](unsigned int i, unsigned int j, unsigned int k) {
+        double x = grid.x_0 + (i + 0.5) * grid.d_x();
+        double y = grid.y_0 + (j + 0.5) * grid.d_y();
+        double z = grid.z_0 + (k + 0.5) * grid.d_z();
+        return threaded.get_T(x, y, z);
+      });
+
+    printf("%s: %d threads %8.3f s; speedup %6.2f; max. difference %.3e K;\n",
+      name, threads, t_threaded, t_serial / t_threaded, max_diff);
+#endif
+  }
+}
+
+/*
+ * The explicit solver as it was before the padded stencil: branches for the
+ * periodic and zero derivative neighbours in the inner loop and a second
+ * pass for the update. Only the DYNAMIC nodes with constant parameters of
+ * the grids below are handled.
+ */
+struct Reference {
+  size_t nx, ny, nz, ntotal;
+  double dx, dy, dz, dt;
+  unsigned int steps;
+
+  std::vector<double> T_e, ddT_e, C_e, rho_e, kappa_e, S_e;
+  std::vector<signed short> flag;
+
+  Reference(const Grid& grid, double in_dt) :
+    nx {grid.n_x}, ny {grid.n_y}, nz {grid.n_z},
+    ntotal {nx * ny * nz},
+    dx {grid.d_x()}, dy {grid.d_y()}, dz {grid.d_z()},
+    dt {in_dt},
+    steps {min_steps},
+    T_e(ntotal, ::T_e), ddT_e(ntotal, 0), C_e(ntotal), rho_e(ntotal, ::rho_e),
+    kappa_e(ntotal), S_e(ntotal, 0), flag(ntotal, 1)
+  {
+    for(size_t r = 0; r < ntotal; ++r) {
+      C_e[r] = grid.get_C_e(r % nx);
+      kappa_e[r] = grid.get_kappa_e(r % nx);
+    }
+  }
+
+  void solve() {
+    double inner_dt = dt / steps;
+
+    double dtdxdydz = inner_dt * (1.0/dx/dx + 1.0/dy/dy + 1.0/dz/dz);
+
+    /* find smallest C_e and rho_e and largest kappa */
+    double c_min = C_e[0];
+    double rho_min = rho_e[0];
+    double kappa_max = kappa_e[0];
+
+    for(size_t i = 1; i < ntotal; ++i) {
+      if(flag[i] != 0) {
+        if(C_e[i] < c_min) c_min = C_e[i];
+        if(rho_e[i] < rho_min) rho_min = rho_e[i];
+        if(kappa_e[i] > kappa_max) kappa_max = kappa_e[i];
+      }
+    }
+
+    double r = dtdxdydz / c_min / rho_min * kappa_max;
+
+    unsigned int new_steps = steps;
+
+    if(r > 0.4) {
+      inner_dt = 0.4 * inner_dt / r; // get new stable timestep
+      new_steps = std::max(static_cast<unsigned int> (std::ceil(dt / inner_dt)), 1u);
+      inner_dt = dt / new_steps;
+    }
+
+    for(int n = 0; n < new_steps; ++n) {
+      for(size_t i = 0; i < ntotal; ++i) { ddT_e[i] = 0.0; }
+
+      for(unsigned int k = 0; k < nz; ++k) {
+        for(unsigned int j = 0; j < ny; ++j) {
+          for(unsigned int i = 0; i < nx; ++i) {
+            unsigned int q, p;
+            unsigned int r = i + j*nx + k*nx*ny;
+
+            if(flag[r] == 2) continue;
+
+            // +- dx
+            if(i > 0) p = (i-1) + j*nx + k*nx*ny;
+            else p = (nx-1) + j*nx + k*nx*ny;
+
+            if(i < (nx - 1)) q = (i+1) + j*nx + k*nx*ny;
+            else q = j*nx + k*nx*ny;
+
+            if(flag[q] == 2) q = r;
+            else if(flag[p] == 2) p = r;
+
+            ddT_e[r] += (kappa_e[q]-kappa_e[p]) * (T_e[q] - T_e[p]) / dx / dx / 4.0;
+            ddT_e[r] += kappa_e[r] * ((T_e[q]+T_e[p]-2.0*T_e[r]) / dx / dx);
+
+            // +- dy
+            if(j > 0) p = i + (j-1)*nx + k*nx*ny;
+            else p = i + (ny-1)*nx + k*nx*ny;
+
+            if(j < (ny - 1)) q = i + (j+1)*nx + k*nx*ny;
+            else q = i + k*nx*ny;
+
+            if(flag[q] == 2) q = r;
+            else if(flag[p] == 2) p = r;
+
+            ddT_e[r] += (kappa_e[q]-kappa_e[p]) * (T_e[q] - T_e[p]) / dy / dy / 4.0;
+            ddT_e[r] += kappa_e[r] * ((T_e[q]+T_e[p]-2.0*T_e[r]) / dy / dy);
+
+            // +- dz
+            if(k > 0) p = i + j*nx + (k-1)*nx*ny;
+            else p = i + j*nx + (nz-1)*nx*ny;
+
+            if(k < (nz - 1)) q = i + j*nx + (k+1)*nx*ny;
+            else q = i + j*nx;
+
+            if(flag[q] == 2) q = r;
+            else if(flag[p] == 2) p = r;
+
+            ddT_e[r] += (kappa_e[q]-kappa_e[p]) * (T_e[q] - T_e[p]) / dz / dz / 4.0;
+            ddT_e[r] += kappa_e[r] * ((T_e[q]+T_e[p]-2.0*T_e[r]) / dz / dz);
+          }
+        }
+      }
+
+      // do the actual step
+      for(size_t i = 0; i < ntotal; i++) {
+        double prescaler = rho_e[i] * C_e[i];
+
+        switch(flag[i]) {
+          case 1:
+            T_e[i] += (ddT_e[i] + S_e[i]) / prescaler * inner_dt;
+            break;
+          default:
+            break;
+        }
+
+        if(T_e[i] < 0.0) { T_e[i] = 0.0; }
+      }
+    }
+  }
+};
+
+void bench(int my_id, int nr_ps) {
+#ifdef EPH_OMP
+  omp_set_num_threads(1);
+#endif
+
+  struct Case {
+    const char* name;
+    Grid grid;
+    double dt;
+    unsigned int n;
+  };
+
+  const Case cases[] {
+    {"1000x2x4", {1000, 2, 4, -10.0, 10.0, -2.0, 2.0, -4.0, 4.0}, 0.0001, 2000},
+    {"128^3", {128, 128, 128, -6.4, 6.4, -6.4, 6.4, -6.4, 6.4}, 0.001, 10}};
+
+  for(const Case& c : cases) {
+    const Grid& grid = c.grid;
+    const double S = Q / (grid.d_x()*grid.d_y()*grid.d_z());
+
+    EPH_FDM electrons = grid.create(my_id, nr_ps, c.dt);
+    Reference reference {grid, c.dt};
+
+    for(unsigned int k = 0; k < grid.n_z; ++k) {
+      for(unsigned int j = 0; j < grid.n_y; ++j) {
+        electrons.set_S(grid.n_x / 2, j, k, S);
+        reference.S_e[grid.n_x / 2 + j*grid.n_x + k*grid.n_x*grid.n_y] = S;
+      }
+    }
+
+    auto t_0 = std::chrono::steady_clock::now();
+    for(unsigned int i = 0; i < c.n; ++i) { reference.solve(); }
+    auto t_1 = std::chrono::steady_clock::now();
+    double t_old = std::chrono::duration<double>(t_1 - t_0).count();
+
+    double t_new = run(electrons, c.n);
+
+    double max_diff = grid.compare(electrons,
+      [&](unsigned int i, unsigned int j, unsigned int k) {
+        return reference.T_e[i + j*grid.n_x + k*grid.n_x*grid.n_y];
+      });
+
+    const double n_nodes = static_cast<double>(reference.ntotal) * c.n;
+    printf("%-8s: before %7.2f ns/node; now %7.2f ns/node; speedup %5.2f; max. difference %.3e K;\n",
+      c.name, 1e9 * t_old / n_nodes, 1e9 * t_new / n_nodes, t_old / t_new, max_diff);
+  }
+}
+
+int main(int args, char **argv) {
+  // do the MPI_Init
+  int my_id;
+  int nr_ps;
+
+  MPI_Init(&args, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &my_id);
+  MPI_Comm_size(MPI_COMM_WORLD, &nr_ps);
+
+  if(args > 1 && strcmp(argv[1], "omp") == 0) omp(my_id, nr_ps);
+  else if(args > 1 && strcmp(argv[1], "bench") == 0) bench(my_id, nr_ps);
+  else laser(my_id, nr_ps);
+
   // do the MPI_Finalise
   MPI_Finalize();
-  
+
   return 0;
 }
-
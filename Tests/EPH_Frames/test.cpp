@@ -0,0 +1,154 @@
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <stdexcept>
+
+#include "eph_frames.h"
+
+/*
+ * Checks that EPH_FrameFile and EPH_FrameReader round trip the frames in
+ * float and double, that the file can be read after every append, that
+ * frames are found through the index in any order and that the text output
+ * has the layout of EPH_FDM::save_temperature().
+ */
+
+constexpr size_t n[3] {7, 5, 3};
+constexpr double lo[3] {-1.0, 0.0, 2.5};
+constexpr double hi[3] {6.0, 10.0, 4.0};
+constexpr size_t n_frames {6};
+
+static double value(size_t frame, size_t i) {
+  return 300.0 + 17.0 * frame + 0.125 * i + 1e-9 * i * i;
+}
+
+static bool check_frames(const char* filename, size_t value_size) {
+  bool ok {true};
+  const size_t n_values = n[0] * n[1] * n[2];
+  const double tolerance = value_size == sizeof(double) ? 0.0 : 1e-6;
+
+  {
+    EPH_FrameFile file(filename, value_size, n, lo, hi);
+    std::vector<double> T(n_values);
+
+    for(size_t k = 0; k < n_frames; ++k) {
+      for(size_t i = 0; i < n_values; ++i) { T[i] = value(k, i); }
+      file.append(10 * k, T.data());
+
+      // the file is complete after each append
+      EPH_FrameReader reader(filename);
+      ok = ok && reader.get_n_frames() == k + 1 && reader.get_step(k) == static_cast<int64_t>(10 * k);
+    }
+  }
+
+  printf("%zu byte values: index after every append %s\n", value_size, ok ? "OK" : "FAILED");
+
+  EPH_FrameReader reader(filename);
+  const EPH_FrameHeader& header = reader.get_header();
+
+  bool header_ok {header.value_size == value_size};
+  for(int i = 0; i < 3; ++i) {
+    header_ok = header_ok && header.n[i] == n[i] && header.lo[i] == lo[i] && header.hi[i] == hi[i];
+  }
+  printf("%zu byte values: header %s\n", value_size, header_ok ? "OK" : "FAILED");
+  ok = ok && header_ok;
+
+  // random access, last frame first
+  double max_error {0};
+  std::vector<double> T(n_values);
+  for(size_t k = n_frames; k-- > 0; ) {
+    reader.read_frame(k, T.data());
+    for(size_t i = 0; i < n_values; ++i) {
+      max_error = std::max(max_error, std::fabs(T[i] - value(k, i)) / value(k, i));
+    }
+  }
+
+  bool values_ok {max_error <= tolerance};
+  printf("%zu byte values: max relative error %.3g %s\n", value_size, max_error, values_ok ? "OK" : "FAILED");
+  ok = ok && values_ok;
+
+  // the size is the header, the frames and the index
+  FILE* fd = fopen(filename, "rb");
+  fseek(fd, 0, SEEK_END);
+  const long size = ftell(fd);
+  fclose(fd);
+
+  const long expected = sizeof(EPH_FrameHeader) + n_frames * n_values * value_size
+    + sizeof(uint64_t) + n_frames * sizeof(EPH_FrameEntry) + sizeof(uint64_t) + 8;
+  bool size_ok {size == expected};
+  printf("%zu byte values: file size %ld %s\n", value_size, size, size_ok ? "OK" : "FAILED");
+  ok = ok && size_ok;
+
+  return ok;
+}
+
+// same loops and format as EPH_FDM::save_temperature()
+static std::string text_reference(size_t frame) {
+  const double dx = (hi[0] - lo[0]) / n[0];
+  const double dy = (hi[1] - lo[1]) / n[1];
+  const double dz = (hi[2] - lo[2]) / n[2];
+
+  std::string text {"x y z Te\n"};
+  char line[256];
+
+  for(size_t k = 0; k < n[2]; ++k) {
+    for(size_t j = 0; j < n[1]; ++j) {
+      for(size_t i = 0; i < n[0]; ++i) {
+        size_t index = i + j * n[0] + k * n[0] * n[1];
+        sprintf(line, "%.6e %.6e %.6e %.6e\n", lo[0] + i * dx, lo[1] + j * dy, lo[2] + k * dz, value(frame, index));
+        text += line;
+      }
+    }
+  }
+
+  return text;
+}
+
+static bool check_text(const char* filename) {
+  EPH_FrameReader reader(filename);
+
+  FILE* fd = tmpfile();
+  reader.write_text(3, fd);
+
+  std::string text(ftell(fd), '\0');
+  rewind(fd);
+  size_t bytes = fread(&text[0], 1, text.size(), fd);
+  fclose(fd);
+
+  bool ok {bytes == text.size() && text == text_reference(3)};
+  printf("text output: %s\n", ok ? "OK" : "FAILED");
+
+  return ok;
+}
+
+static bool check_errors() {
+  FILE* fd = fopen("test_not_frames.bin", "wb");
+  fprintf(fd, "x y z Te\n");
+  fclose(fd);
+
+  bool ok {false};
+  try { EPH_FrameReader reader("test_not_frames.bin"); }
+  catch(std::runtime_error&) { ok = true; }
+  remove("test_not_frames.bin");
+
+  printf("rejecting a text file: %s\n", ok ? "OK" : "FAILED");
+
+  return ok;
+}
+
+int main(int args, char **argv) {
+  bool ok {true};
+
+  ok = check_frames("test_double.bin", sizeof(double)) && ok;
+  ok = check_text("test_double.bin") && ok;
+  ok = check_frames("test_float.bin", sizeof(float)) && ok;
+  ok = check_errors() && ok;
+
+  remove("test_double.bin");
+  remove("test_float.bin");
+
+  printf("%s\n", ok ? "ALL OK" : "SOME FAILED");
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "eph_gaussian.h"
+
+/*
+ * Checks the normal variates of EPH_Gaussian (moments and the Kolmogorov-
+ * Smirnov distance to the normal distribution), checks that fill() gives the
+ * same numbers as repeated gaussian() calls and compares the throughput
+ * of EPH_Gaussian::fill() against one gaussian() call per number with the
+ * Marsaglia generator and polar method of LAMMPS' RanMars.
+ */
+
+constexpr size_t n_samples {10000000};
+constexpr size_t n_ks {1000000};
+
+// same algorithm as RanMars in LAMMPS (random_mars.cpp)
+struct RanMars {
+  double u[98];
+  int i97, j97;
+  double c, cd, cm;
+  int save {0};
+  double second {0};
+
+  RanMars(int seed) {
+    int ij = (seed - 1) / 30082;
+    int kl = (seed - 1) - 30082 * ij;
+    int i = (ij / 177) % 177 + 2;
+    int j = ij % 177 + 2;
+    int k = (kl / 169) % 178 + 1;
+    int l = kl % 169;
+    for(int ii = 1; ii <= 97; ii++) {
+      double s = 0.0;
+      double t = 0.5;
+      for(int jj = 1; jj <= 24; jj++) {
+        int m = ((i * j) % 179) * k % 179;
+        i = j;
+        j = k;
+        k = m;
+        l = (53 * l + 1) % 169;
+        if((l * m) % 64 >= 32) s = s + t;
+        t = 0.5 * t;
+      }
+      u[ii] = s;
+    }
+    c = 362436.0 / 16777216.0;
+    cd = 7654321.0 / 16777216.0;
+    cm = 16777213.0 / 16777216.0;
+    i97 = 97;
+    j97 = 33;
+    uniform();
+  }
+
+  double uniform() {
+    double uni = u[i97] - u[j97];
+    if(uni < 0.0) uni += 1.0;
+    u[i97] = uni;
+    i97--;
+    if(i97 == 0) i97 = 97;
+    j97--;
+    if(j97 == 0) j97 = 97;
+    c -= cd;
+    if(c < 0.0) c += cm;
+    uni -= c;
+    if(uni < 0.0) uni += 1.0;
+    return uni;
+  }
+
+  double gaussian() {
+    double first, v1, v2, rsq, fac;
+
+    if(!save) {
+      do {
+        v1 = 2.0 * uniform() - 1.0;
+        v2 = 2.0 * uniform() - 1.0;
+        rsq = v1 * v1 + v2 * v2;
+      } while((rsq >= 1.0) || (rsq == 0.0));
+      fac = std::sqrt(-2.0 * std::log(rsq) / rsq);
+      second = v1 * fac;
+      first = v2 * fac;
+      save = 1;
+    } else {
+      first = second;
+      save = 0;
+    }
+    return first;
+  }
+};
+
+double normal_cdf(double x) {
+  return 0.5 * std::erfc(-x / std::sqrt(2.));
+}
+
+int main(int args, char **argv) {
+  bool ok {true};
+  std::vector<double> xi(n_samples);
+
+  // moments
+  EPH_Gaussian gaussian(12345);
+  gaussian.fill(xi.data(), n_samples);
+
+  double m1 {0}, m2 {0}, m3 {0}, m4 {0};
+  for(double v : xi) {
+    m1 += v;
+    m2 += v * v;
+    m3 += v * v * v;
+    m4 += v * v * v * v;
+  }
+  m1 /= n_samples; m2 /= n_samples; m3 /= n_samples; m4 /= n_samples;
+
+  // ~5 sigma bounds for the sample size
+  const double s {1. / std::sqrt(static_cast<double>(n_samples))};
+  bool moments {std::fabs(m1) < 5. * s && std::fabs(m2 - 1.) < 5. * std::sqrt(2.) * s &&
+    std::fabs(m3) < 5. * std::sqrt(15.) * s && std::fabs(m4 - 3.) < 5. * std::sqrt(96.) * s};
+  printf("<x> = %.5f <x^2> = %.5f <x^3> = %.5f <x^4> = %.5f %s\n",
+    m1, m2, m3, m4, moments ? "OK" : "FAILED");
+  ok = ok && moments;
+
+  // Kolmogorov-Smirnov distance; 1.95 / sqrt(n) is the 0.1% critical value
+  std::sort(xi.begin(), xi.begin() + n_ks);
+  double d {0};
+  for(size_t i = 0; i < n_ks; ++i) {
+    double cdf {normal_cdf(xi[i])};
+    d = std::max(d, std::max(cdf - static_cast<double>(i) / n_ks,
+      static_cast<double>(i + 1) / n_ks - cdf));
+  }
+  bool ks {d < 1.95 / std::sqrt(static_cast<double>(n_ks))};
+  printf("KS distance = %.3e (critical %.3e) %s\n",
+    d, 1.95 / std::sqrt(static_cast<double>(n_ks)), ks ? "OK" : "FAILED");
+  ok = ok && ks;
+
+  // fill() and gaussian() give the same stream
+  EPH_Gaussian a(777), b(777);
+  a.fill(xi.data(), n_ks);
+  bool same {true};
+  for(size_t i = 0; i < n_ks; ++i) { same = same && xi[i] == b.gaussian(); }
+  printf("fill() against gaussian(): %s\n", same ? "OK" : "FAILED");
+  ok = ok && same;
+
+  // throughput against RanMars
+  RanMars ran_mars(12345);
+  auto t_0 = std::chrono::steady_clock::now();
+  for(size_t i = 0; i < n_samples; ++i) {
+    xi[i] = ran_mars.gaussian();
+  }
+  auto t_1 = std::chrono::steady_clock::now();
+  double sum_mars {0};
+  for(double v : xi) { sum_mars += v; }
+
+  auto t_2 = std::chrono::steady_clock::now();
+  gaussian.fill(xi.data(), n_samples);
+  auto t_3 = std::chrono::steady_clock::now();
+  double sum_fill {0};
+  for(double v : xi) { sum_fill += v; }
+
+  double t_mars {std::chrono::duration<double>(t_1 - t_0).count()};
+  double t_fill {std::chrono::duration<double>(t_3 - t_2).count()};
+  printf("RanMars::gaussian() %6.2f ns per number (sum %.1f)\n", 1e9 * t_mars / n_samples, sum_mars);
+  printf("EPH_Gaussian::fill() %6.2f ns per number (sum %.1f); speedup %.2f\n",
+    1e9 * t_fill / n_samples, sum_fill, t_mars / t_fill);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+/*
+ * Tables of EPH_BetaKokkos against EPH_Beta on every enabled backend
+ */
+
+#include <cstdio>
+#include <cmath>
+
+#include <Kokkos_Core.hpp>
+
+#include "eph_beta.h"
+#include "eph_beta_kokkos.h"
+
+constexpr size_t n_points {4096};
+
+bool check(const char* name, double error, double tolerance) {
+  bool ok {error < tolerance};
+  printf("%-40s %.3e %s\n", name, error, ok ? "OK" : "FAILED");
+  return ok;
+}
+
+// values of the three tables of every element on a grid inside the cutoffs
+template<class Space>
+struct Evaluate {
+  EPH_BetaKokkos<Space> beta;
+  Kokkos::View<double*, Space> r_sq;
+  Kokkos::View<double*, Space> rho;
+  Kokkos::View<double**, Space> value; // [3 * n_elements][n_points]
+
+  KOKKOS_INLINE_FUNCTION
+  void operator()(const int& k) const {
+    for(int e = 0; e < beta.n_elements; ++e) {
+      value(3 * e, k) = beta.get_rho_r_sq(e, r_sq(k));
+      value(3 * e + 1, k) = beta.get_alpha(e, rho(k));
+      value(3 * e + 2, k) = beta.get_beta(e, rho(k));
+    }
+  }
+};
+
+// largest difference to the host tables
+template<class Space>
+struct Difference {
+  Kokkos::View<double**, Space> value;
+  Kokkos::View<double**, Space> reference;
+
+  KOKKOS_INLINE_FUNCTION
+  void operator()(const int& k, double& max) const {
+    for(size_t t = 0; t < value.extent(0); ++t) {
+      double d = fabs(value(t, k) - reference(t, k));
+      if(d > max) max = d;
+    }
+  }
+};
+
+template<class Space>
+bool test_space(const char* name, const Beta& beta) {
+  const int n_elements = beta.get_n_elements();
+
+  Evaluate<Space> evaluate;
+  evaluate.beta = EPH_BetaKokkos<Space>(beta);
+  evaluate.r_sq = Kokkos::View<double*, Space>("r_sq", n_points);
+  evaluate.rho = Kokkos::View<double*, Space>("rho", n_points);
+  evaluate.value = Kokkos::View<double**, Space>("value", 3 * n_elements, n_points);
+
+  auto h_r_sq = Kokkos::create_mirror_view(evaluate.r_sq);
+  auto h_rho = Kokkos::create_mirror_view(evaluate.rho);
+
+  Kokkos::View<double**, Space> reference("reference", 3 * n_elements, n_points);
+  auto h_reference = Kokkos::create_mirror_view(reference);
+
+  for(size_t k = 0; k < n_points; ++k) {
+    h_r_sq(k) = beta.get_r_cutoff_sq() * k / n_points;
+    h_rho(k) = beta.get_rho_cutoff() * k / n_points;
+
+    for(int e = 0; e < n_elements; ++e) {
+      h_reference(3 * e, k) = beta.get_rho_r_sq(e, h_r_sq(k));
+      h_reference(3 * e + 1, k) = beta.get_alpha(e, h_rho(k));
+      h_reference(3 * e + 2, k) = beta.get_beta(e, h_rho(k));
+    }
+  }
+
+  Kokkos::deep_copy(evaluate.r_sq, h_r_sq);
+  Kokkos::deep_copy(evaluate.rho, h_rho);
+  Kokkos::deep_copy(reference, h_reference);
+
+  Kokkos::parallel_for("eph:test:evaluate", Kokkos::RangePolicy<Space>(0, n_points), evaluate);
+
+  double error {0};
+  Difference<Space> difference {evaluate.value, reference};
+  Kokkos::parallel_reduce("eph:test:difference", Kokkos::RangePolicy<Space>(0, n_points),
+    difference, Kokkos::Max<double>(error));
+
+  // the same arithmetic as EPH_Spline; devices may contract it into fma
+  char label[64];
+  snprintf(label, sizeof(label), "%s tables against EPH_Beta", name);
+  return check(label, error, 1e-9);
+}
+
+int main(int args, char **argv) {
+  Kokkos::ScopeGuard guard(args, argv);
+
+  bool ok {true};
+  Beta beta("../EPH_Beta/NiFe.beta");
+
+  printf("%zu elements, r_cutoff %.2f, rho_cutoff %.2f\n",
+    beta.get_n_elements(), beta.get_r_cutoff(), beta.get_rho_cutoff());
+
+#ifdef KOKKOS_ENABLE_SERIAL
+  ok = test_space<Kokkos::Serial>("Serial", beta) && ok;
+#endif
+
+#ifdef KOKKOS_ENABLE_OPENMP
+  ok = test_space<Kokkos::OpenMP>("OpenMP", beta) && ok;
+#endif
+
+  ok = test_space<Kokkos::DefaultExecutionSpace>("default space", beta) && ok;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,659 @@
+/*
+ * Kernels of fix eph/kk against the kernels of fix eph on a periodic fcc
+ * alloy with ghost atoms: the densities, the forces of every model for every
+ * combination of terms and group, the force update and the integrators.
+ *
+ * The kernels run through FixEPHKokkosKernels on views and a neighbour view
+ * as in FixEPHKokkos::post_force(). The reference repeats the loops of
+ * FixEPH on the pair cache and the EPH_BlockCSR operator of the PRL model.
+ * The forward communication copies the values of the owners to the ghosts.
+ */
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <type_traits>
+
+#include <Kokkos_Core.hpp>
+
+#include "kokkos_type.h"
+#include "eph_beta.h"
+#include "eph_block_csr.h"
+#include "fix_eph_kokkos_kernels.h"
+
+using namespace LAMMPS_NS;
+
+constexpr double r_skin {1.0}; // the list holds pairs beyond r_cutoff as in LAMMPS
+constexpr double eta_factor {0.3};
+constexpr double dtv {1.0e-3};
+constexpr double dtf {0.5e-3};
+constexpr double mass[3] {0.0, 58.69, 55.85}; // per type, type 0 is not used
+constexpr int special_bit {1 << 30}; // special bond bits are masked by NEIGHMASK
+
+enum Model { TTM = 1, PRB = 2, PRLCM = 3, PRL = 4 };
+
+bool check(const char* name, double error, double tolerance) {
+  bool ok {error < tolerance};
+  printf("%-52s %.3e %s\n", name, error, ok ? "OK" : "FAILED");
+  return ok;
+}
+
+// largest difference of the local atoms relative to the largest reference value
+double difference(const std::vector<double>& a, const std::vector<double>& reference, size_t n) {
+  double max_diff {0};
+  double max_ref {0};
+
+  for(size_t k = 0; k < n; ++k) {
+    max_diff = std::max(max_diff, std::fabs(a[k] - reference[k]));
+    max_ref = std::max(max_ref, std::fabs(reference[k]));
+  }
+
+  return max_ref > 0 ? max_diff / max_ref : max_diff;
+}
+
+/*
+ * fcc cells of two elements with displaced atoms, the local atoms are
+ * followed by their periodic images within r_cutoff + r_skin of the box
+ */
+struct Lattice {
+  int nlocal;
+  int ntotal;
+  std::vector<double> x, v, f, xi; // [ntotal][3]
+  std::vector<double> T_e; // [ntotal]
+  std::vector<int> type, mask, owner; // owner of a ghost, an atom owns itself
+  std::vector<std::vector<int>> neighbours; // full list of the local atoms
+
+  Lattice(size_t n_cells, double r_list, std::mt19937& gen) {
+    const double a {3.52};
+    const double length {a * n_cells};
+    const double basis[4][3] {{0, 0, 0}, {0.5, 0.5, 0}, {0.5, 0, 0.5}, {0, 0.5, 0.5}};
+
+    std::uniform_real_distribution<double> displacement(-0.15, 0.15);
+    std::uniform_real_distribution<double> temperature(100.0, 1000.0);
+    std::normal_distribution<double> normal;
+    std::bernoulli_distribution second_element(0.3);
+
+    for(size_t i = 0; i < n_cells; ++i)
+      for(size_t j = 0; j < n_cells; ++j)
+        for(size_t k = 0; k < n_cells; ++k)
+          for(size_t b = 0; b < 4; ++b) {
+            double r[3] {(i + basis[b][0]) * a, (j + basis[b][1]) * a, (k + basis[b][2]) * a};
+            for(size_t d = 0; d < 3; ++d) { x.push_back(r[d] + displacement(gen)); }
+            for(size_t d = 0; d < 3; ++d) { v.push_back(normal(gen)); }
+            for(size_t d = 0; d < 3; ++d) { f.push_back(normal(gen)); }
+            for(size_t d = 0; d < 3; ++d) { xi.push_back(normal(gen)); }
+
+            T_e.push_back(temperature(gen));
+            type.push_back(second_element(gen) ? 2 : 1);
+            // group 2 is the lower half of the box
+            mask.push_back(1 | (r[2] < 0.5 * length ? 2 : 0));
+            owner.push_back(type.size() - 1);
+          }
+
+    nlocal = type.size();
+
+    for(int sx = -1; sx <= 1; ++sx)
+      for(int sy = -1; sy <= 1; ++sy)
+        for(int sz = -1; sz <= 1; ++sz) {
+          if(sx == 0 && sy == 0 && sz == 0) continue;
+
+          for(int i = 0; i < nlocal; ++i) {
+            double r[3] {x[3 * i] + sx * length, x[3 * i + 1] + sy * length, x[3 * i + 2] + sz * length};
+
+            bool inside {true};
+            for(size_t d = 0; d < 3; ++d) { inside = inside && r[d] > -r_list && r[d] < length + r_list; }
+            if(!inside) continue;
+
+            for(size_t d = 0; d < 3; ++d) { x.push_back(r[d]); }
+            for(size_t d = 0; d < 3; ++d) { v.push_back(v[3 * i + d]); }
+            for(size_t d = 0; d < 3; ++d) { f.push_back(0); }
+            for(size_t d = 0; d < 3; ++d) { xi.push_back(xi[3 * i + d]); }
+
+            T_e.push_back(0);
+            type.push_back(type[i]);
+            mask.push_back(mask[i]);
+            owner.push_back(i);
+          }
+        }
+
+    ntotal = type.size();
+
+    neighbours.resize(nlocal);
+    for(int i = 0; i < nlocal; ++i) {
+      for(int j = 0; j < ntotal; ++j) {
+        if(i == j) continue;
+
+        double r_sq {0};
+        for(size_t d = 0; d < 3; ++d) { r_sq += (x[3 * j + d] - x[3 * i + d]) * (x[3 * j + d] - x[3 * i + d]); }
+        if(r_sq >= r_list * r_list) continue;
+
+        neighbours[i].push_back(neighbours[i].size() % 7 == 3 ? j | special_bit : j);
+      }
+    }
+  }
+
+  // forward communication of a per atom array with dim values per atom
+  template<class Array>
+  void forward(Array& a, size_t dim) const {
+    for(int i = nlocal; i < ntotal; ++i) {
+      for(size_t d = 0; d < dim; ++d) { a[dim * i + d] = a[dim * owner[i] + d]; }
+    }
+  }
+};
+
+/*
+ * FixEPH::calculate_environment() and the force kernels of FixEPH with the
+ * electronic temperature of every atom in T_e
+ */
+struct Reference {
+  struct Pair {
+    int j;
+    double e_ij[3];
+    double inv_r_sq;
+    double rho_ji;
+    double rho_ij;
+  };
+
+  const Lattice& lattice;
+  const Beta& beta;
+  int groupbit;
+
+  std::vector<double> rho_i, alpha_rho_i; // [ntotal]
+  std::vector<double> w_i, f_EPH, f_RNG; // [ntotal][3]
+  std::vector<Pair> pairs;
+  std::vector<size_t> pair_first;
+  EPH_BlockCSR w_operator;
+
+  Reference(const Lattice& in_lattice, const Beta& in_beta, int in_groupbit) :
+    lattice(in_lattice), beta(in_beta), groupbit {in_groupbit},
+    rho_i(lattice.ntotal, 0), alpha_rho_i(lattice.ntotal, 0),
+    w_i(3 * lattice.ntotal, 0), f_EPH(3 * lattice.ntotal, 0), f_RNG(3 * lattice.ntotal, 0)
+  {}
+
+  bool in_group(int i) const { return lattice.mask[i] & groupbit; }
+  int element(int i) const { return lattice.type[i] - 1; }
+
+  // row pointers into a flat [n][3] array, as LAMMPS per atom arrays
+  static std::vector<double*> rows(std::vector<double>& a) {
+    std::vector<double*> r(a.size() / 3);
+    for(size_t i = 0; i < r.size(); ++i) { r[i] = &(a[3 * i]); }
+    return r;
+  }
+
+  static std::vector<const double*> rows(const std::vector<double>& a) {
+    std::vector<const double*> r(a.size() / 3);
+    for(size_t i = 0; i < r.size(); ++i) { r[i] = &(a[3 * i]); }
+    return r;
+  }
+
+  void environment(int model) {
+    const bool pair_densities = (model == PRB || model == PRLCM || model == PRL);
+    const bool build_w = (model == PRL);
+    const bool cache_pairs = pair_densities && !build_w;
+    const double r_cutoff_sq = beta.get_r_cutoff_sq();
+    const std::vector<double>& x = lattice.x;
+
+    pairs.clear();
+    pair_first.resize(lattice.nlocal + 1);
+    w_operator.clear();
+
+    for(int i = 0; i < lattice.nlocal; ++i) {
+      rho_i[i] = 0;
+      alpha_rho_i[i] = 0;
+      pair_first[i] = pairs.size();
+      if(build_w) { w_operator.add_row(); }
+
+      if(!in_group(i)) continue;
+
+      for(int jj : lattice.neighbours[i]) {
+        int j = jj & NEIGHMASK;
+
+        double e_ij[3] {x[3 * j] - x[3 * i], x[3 * j + 1] - x[3 * i + 1], x[3 * j + 2] - x[3 * i + 2]};
+        double r_sq = e_ij[0] * e_ij[0] + e_ij[1] * e_ij[1] + e_ij[2] * e_ij[2];
+
+        if(!(r_sq < r_cutoff_sq)) continue;
+
+        double v_rho_ji = beta.get_rho_r_sq(element(j), r_sq);
+        rho_i[i] += v_rho_ji;
+
+        double v_rho_ij = 0;
+        if(pair_densities) { v_rho_ij = beta.get_rho_r_sq(element(i), r_sq); }
+
+        if(cache_pairs) {
+          pairs.push_back(Pair {j, {e_ij[0], e_ij[1], e_ij[2]}, 1.0 / r_sq, v_rho_ji, v_rho_ij});
+        }
+
+        if(build_w) {
+          double inv_r_sq = 1.0 / r_sq;
+          w_operator.add_pair(j, e_ij, v_rho_ji * inv_r_sq, v_rho_ij * inv_r_sq);
+        }
+      }
+
+      if(rho_i[i] > 0) { alpha_rho_i[i] = beta.get_alpha(element(i), rho_i[i]) / rho_i[i]; }
+    }
+
+    pair_first[lattice.nlocal] = pairs.size();
+
+    lattice.forward(rho_i, 1);
+    lattice.forward(alpha_rho_i, 1);
+  }
+
+  void force(int model, bool friction, bool random) {
+    const std::vector<double>& v = lattice.v;
+    const std::vector<double>& xi = lattice.xi;
+    const std::vector<double>& T_e = lattice.T_e;
+
+    std::fill(w_i.begin(), w_i.end(), 0);
+    std::fill(f_EPH.begin(), f_EPH.end(), 0);
+    std::fill(f_RNG.begin(), f_RNG.end(), 0);
+
+    if(model == PRL) {
+      w_operator.assemble(alpha_rho_i.data());
+
+      auto v_r = rows(v);
+      auto xi_r = rows(xi);
+      auto w_r = rows(w_i);
+      auto f_EPH_r = rows(f_EPH);
+      auto f_RNG_r = rows(f_RNG);
+
+      if(friction) {
+        w_operator.apply_transpose(v_r.data(), w_r.data());
+        lattice.forward(w_i, 3);
+      }
+
+      auto w_c = rows(static_cast<const std::vector<double>&>(w_i));
+      if(friction) { w_operator.apply(w_c.data(), f_EPH_r.data()); }
+      if(random) { w_operator.apply(xi_r.data(), f_RNG_r.data()); }
+
+      for(int i = 0; i < lattice.nlocal; ++i) {
+        if(!in_group(i) || !(rho_i[i] > 0)) continue;
+
+        for(size_t d = 0; d < 3; ++d) {
+          f_EPH[3 * i + d] = -f_EPH[3 * i + d];
+          f_RNG[3 * i + d] *= eta_factor * std::sqrt(T_e[i]);
+        }
+      }
+
+      return;
+    }
+
+    // the w pass of PRLCM has to reach the ghosts before the forces
+    if(model == PRLCM && friction) {
+      for(int i = 0; i < lattice.nlocal; ++i) {
+        if(!in_group(i)) continue;
+
+        double alpha_i = beta.get_alpha(element(i), rho_i[i]);
+        for(size_t d = 0; d < 3; ++d) { w_i[3 * i + d] = alpha_i * v[3 * i + d]; }
+
+        if(!(rho_i[i] > 0.0)) continue;
+
+        for(size_t p = pair_first[i]; p != pair_first[i + 1]; ++p) {
+          double var = alpha_i * pairs[p].rho_ji / rho_i[i];
+          for(size_t d = 0; d < 3; ++d) { w_i[3 * i + d] -= var * v[3 * pairs[p].j + d]; }
+        }
+      }
+
+      lattice.forward(w_i, 3);
+    }
+
+    for(int i = 0; i < lattice.nlocal; ++i) {
+      if(!in_group(i)) continue;
+
+      double alpha_i = beta.get_alpha(element(i), rho_i[i]);
+
+      if(model == TTM) {
+        for(size_t d = 0; d < 3; ++d) {
+          if(friction) { f_EPH[3 * i + d] = -beta.get_beta(element(i), rho_i[i]) * v[3 * i + d]; }
+          if(random) { f_RNG[3 * i + d] = eta_factor * alpha_i * std::sqrt(T_e[i]) * xi[3 * i + d]; }
+        }
+      }
+      else if(model == PRB) {
+        if(friction && rho_i[i] > 0) {
+          for(size_t d = 0; d < 3; ++d) { f_EPH[3 * i + d] = v[3 * i + d]; }
+
+          for(size_t p = pair_first[i]; p != pair_first[i + 1]; ++p) {
+            double var = pairs[p].rho_ji / rho_i[i];
+            for(size_t d = 0; d < 3; ++d) { f_EPH[3 * i + d] -= var * v[3 * pairs[p].j + d]; }
+          }
+
+          for(size_t d = 0; d < 3; ++d) { f_EPH[3 * i + d] *= beta.get_beta(element(i), rho_i[i]); }
+        }
+
+        if(random) {
+          for(size_t d = 0; d < 3; ++d) { f_RNG[3 * i + d] = eta_factor * alpha_i * std::sqrt(T_e[i]) * xi[3 * i + d]; }
+        }
+      }
+      else if(model == PRLCM) {
+        for(size_t d = 0; d < 3; ++d) {
+          if(friction) { f_EPH[3 * i + d] = alpha_i * w_i[3 * i + d]; }
+          if(random) { f_RNG[3 * i + d] = alpha_i * xi[3 * i + d]; }
+        }
+
+        for(size_t p = pair_first[i]; p != pair_first[i + 1]; ++p) {
+          int j = pairs[p].j;
+          if(!(rho_i[j] > 0.0)) continue;
+
+          double var = alpha_rho_i[j] * pairs[p].rho_ij;
+          for(size_t d = 0; d < 3; ++d) {
+            if(friction) { f_EPH[3 * i + d] -= var * w_i[3 * j + d]; }
+            if(random) { f_RNG[3 * i + d] -= var * xi[3 * j + d]; }
+          }
+        }
+
+        if(random) {
+          for(size_t d = 0; d < 3; ++d) { f_RNG[3 * i + d] *= eta_factor * std::sqrt(T_e[i]); }
+        }
+      }
+    }
+  }
+};
+
+/*
+ * The views of FixEPHKokkosKernels filled from the lattice; the steps follow
+ * FixEPHKokkos::post_force() and the integrators
+ */
+template<class DeviceType>
+struct Kernels {
+  typedef ArrayTypes<DeviceType> AT;
+
+  const Lattice& lattice;
+  FixEPHKokkosKernels<DeviceType> kernels;
+
+  Kernels(const Lattice& in_lattice, const Beta& beta, int groupbit) :
+    lattice(in_lattice)
+  {
+    const int ntotal = lattice.ntotal;
+
+    kernels.x = typename AT::t_x_array("x", ntotal);
+    kernels.v = typename AT::t_v_array("v", ntotal);
+    kernels.f = typename AT::t_f_array("f", ntotal);
+    kernels.type = typename AT::t_int_1d("type", ntotal);
+    kernels.mask = typename AT::t_int_1d("mask", ntotal);
+    kernels.mass = typename AT::t_float_1d("mass", 3);
+
+    kernels.rho_i = typename AT::t_float_1d("rho_i", ntotal);
+    kernels.alpha_rho_i = typename AT::t_float_1d("alpha_rho_i", ntotal);
+    kernels.T_e_i = typename AT::t_float_1d("T_e_i", ntotal);
+    kernels.w_i = typename AT::t_f_array("w_i", ntotal);
+    kernels.xi_i = typename AT::t_f_array("xi_i", ntotal);
+    kernels.f_EPH = typename AT::t_f_array("f_EPH", ntotal);
+    kernels.f_RNG = typename AT::t_f_array("f_RNG", ntotal);
+
+    size_t max_neighbours {0};
+    for(const std::vector<int>& list : lattice.neighbours) { max_neighbours = std::max(max_neighbours, list.size()); }
+
+    kernels.numneigh = typename AT::t_int_1d("numneigh", lattice.nlocal);
+    kernels.neighbors = typename AT::t_neighbors_2d("neighbors", lattice.nlocal, max_neighbours);
+
+    auto h_numneigh = Kokkos::create_mirror_view(kernels.numneigh);
+    auto h_neighbors = Kokkos::create_mirror_view(kernels.neighbors);
+    for(int i = 0; i < lattice.nlocal; ++i) {
+      h_numneigh(i) = lattice.neighbours[i].size();
+      for(size_t jj = 0; jj < lattice.neighbours[i].size(); ++jj) { h_neighbors(i, jj) = lattice.neighbours[i][jj]; }
+    }
+    Kokkos::deep_copy(kernels.numneigh, h_numneigh);
+    Kokkos::deep_copy(kernels.neighbors, h_neighbors);
+
+    auto h_mass = Kokkos::create_mirror_view(kernels.mass);
+    for(int t = 0; t < 3; ++t) { h_mass(t) = mass[t]; }
+    Kokkos::deep_copy(kernels.mass, h_mass);
+
+    push(kernels.x, lattice.x);
+    push(kernels.v, lattice.v);
+    push(kernels.f, lattice.f);
+    push(kernels.xi_i, lattice.xi);
+    push(kernels.T_e_i, lattice.T_e);
+    push(kernels.type, lattice.type);
+    push(kernels.mask, lattice.mask);
+
+    kernels.beta = EPH_BetaKokkos<DeviceType>(beta);
+
+    // type 1 is the first element of the file and type 2 the second
+    kernels.type_map = Kokkos::View<int*, DeviceType>("type_map", 2);
+    auto h_type_map = Kokkos::create_mirror_view(kernels.type_map);
+    h_type_map(0) = 0;
+    h_type_map(1) = 1;
+    Kokkos::deep_copy(kernels.type_map, h_type_map);
+
+    kernels.groupbit = groupbit;
+    kernels.r_cutoff_sq = beta.get_r_cutoff_sq();
+    kernels.eta_factor = eta_factor;
+    kernels.dtv = dtv;
+    kernels.dtf = dtf;
+  }
+
+  // one value per atom or three with a [3] extent
+  template<class View>
+  static constexpr size_t get_dim() { return std::is_array<typename View::data_type>::value ? 3 : 1; }
+
+  template<class View>
+  static decltype(auto) element(const View& view, size_t i, size_t, std::false_type) { return view(i); }
+
+  template<class View>
+  static decltype(auto) element(const View& view, size_t i, size_t d, std::true_type) { return view(i, d); }
+
+  template<class View>
+  static decltype(auto) element(const View& view, size_t i, size_t d) {
+    return element(view, i, d, std::is_array<typename View::data_type>());
+  }
+
+  // per atom values of the lattice into a view
+  template<class View, class Value>
+  static void push(const View& view, const std::vector<Value>& values) {
+    auto h_view = Kokkos::create_mirror_view(view);
+    const size_t dim = get_dim<View>();
+
+    for(size_t i = 0; i < view.extent(0); ++i) {
+      for(size_t d = 0; d < dim; ++d) { element(h_view, i, d) = values[dim * i + d]; }
+    }
+
+    Kokkos::deep_copy(view, h_view);
+  }
+
+  template<class View>
+  static std::vector<double> pull(const View& view) {
+    auto h_view = Kokkos::create_mirror_view(view);
+    Kokkos::deep_copy(h_view, view);
+
+    const size_t dim = get_dim<View>();
+    std::vector<double> values(dim * view.extent(0));
+    for(size_t i = 0; i < view.extent(0); ++i) {
+      for(size_t d = 0; d < dim; ++d) { values[dim * i + d] = element(h_view, i, d); }
+    }
+
+    return values;
+  }
+
+  // forward communication through the host as in FixEPHKokkos::forward_comm_host()
+  template<class View>
+  void forward(const View& view) const {
+    std::vector<double> values = pull(view);
+    lattice.forward(values, get_dim<View>());
+    push(view, values);
+  }
+
+  template<class Tag>
+  void launch() const {
+    Kokkos::parallel_for(Kokkos::RangePolicy<DeviceType, Tag>(0, lattice.nlocal), kernels);
+    Kokkos::fence();
+  }
+
+  void environment() {
+    launch<TagFixEPHEnvironment>();
+    forward(kernels.rho_i);
+    forward(kernels.alpha_rho_i);
+  }
+
+  template<bool friction, bool random, bool group_all>
+  void force(int model) {
+    Kokkos::deep_copy(kernels.w_i, 0.0);
+    Kokkos::deep_copy(kernels.f_EPH, 0.0);
+    Kokkos::deep_copy(kernels.f_RNG, 0.0);
+
+    switch(model) {
+      case TTM:
+        launch<TagFixEPHTTM<friction, random, group_all>>();
+        break;
+      case PRB:
+        launch<TagFixEPHPRB<friction, random, group_all>>();
+        break;
+      case PRLCM:
+        if(friction) {
+          launch<TagFixEPHPRLCMW<group_all>>();
+          forward(kernels.w_i);
+        }
+        launch<TagFixEPHPRLCM<friction, random, group_all>>();
+        break;
+      case PRL:
+        if(friction) {
+          launch<TagFixEPHPRLW<group_all>>();
+          forward(kernels.w_i);
+        }
+        launch<TagFixEPHPRL<friction, random, group_all>>();
+        break;
+    }
+  }
+};
+
+const char* model_name(int model) {
+  switch(model) {
+    case TTM: return "TTM";
+    case PRB: return "PRB";
+    case PRLCM: return "PRLCM";
+    case PRL: return "PRL";
+  }
+
+  return "unknown";
+}
+
+// every model for one combination of terms and group
+template<class DeviceType, bool friction, bool random, bool group_all>
+bool test_forces(const char* space, const Lattice& lattice, const Beta& beta) {
+  // group all is the first group and every atom has its bit
+  const int groupbit = group_all ? 1 : 2;
+  const size_t n = 3 * lattice.nlocal;
+
+  bool ok {true};
+  char label[128];
+
+  for(int model : {TTM, PRB, PRLCM, PRL}) {
+    Reference reference(lattice, beta, groupbit);
+    reference.environment(model);
+    reference.force(model, friction, random);
+
+    Kernels<DeviceType> device(lattice, beta, groupbit);
+    device.environment();
+    device.template force<friction, random, group_all>(model);
+
+    const char* terms = (friction && random) ? "friction+random" : (friction ? "friction" : "random");
+    const char* group = group_all ? "all" : "half";
+
+    std::vector<double> rho_i = Kernels<DeviceType>::pull(device.kernels.rho_i);
+    std::vector<double> alpha_rho_i = Kernels<DeviceType>::pull(device.kernels.alpha_rho_i);
+    snprintf(label, sizeof(label), "%s %s %s %s rho_i", space, model_name(model), terms, group);
+    ok = check(label, std::max(difference(rho_i, reference.rho_i, lattice.nlocal),
+      difference(alpha_rho_i, reference.alpha_rho_i, lattice.nlocal)), 1e-12) && ok;
+
+    std::vector<double> f_EPH = Kernels<DeviceType>::pull(device.kernels.f_EPH);
+    std::vector<double> f_RNG = Kernels<DeviceType>::pull(device.kernels.f_RNG);
+    snprintf(label, sizeof(label), "%s %s %s %s f_EPH, f_RNG", space, model_name(model), terms, group);
+    ok = check(label, std::max(difference(f_EPH, reference.f_EPH, n),
+      difference(f_RNG, reference.f_RNG, n)), 1e-12) && ok;
+
+    // f += f_EPH + f_RNG of the enabled terms
+    if(model == PRL) {
+      device.template launch<TagFixEPHApply<friction, random>>();
+
+      std::vector<double> f_ref = lattice.f;
+      for(size_t k = 0; k < n; ++k) {
+        if(friction) f_ref[k] += reference.f_EPH[k];
+        if(random) f_ref[k] += reference.f_RNG[k];
+      }
+
+      std::vector<double> f = Kernels<DeviceType>::pull(device.kernels.f);
+      snprintf(label, sizeof(label), "%s apply %s", space, terms);
+      ok = check(label, difference(f, f_ref, n), 1e-12) && ok;
+    }
+  }
+
+  return ok;
+}
+
+// velocity Verlet of the atoms in the group
+template<class DeviceType>
+bool test_integrators(const char* space, const Lattice& lattice, const Beta& beta) {
+  const int groupbit = 2;
+  const size_t n = 3 * lattice.nlocal;
+
+  std::vector<double> x_ref = lattice.x;
+  std::vector<double> v_initial = lattice.v;
+  std::vector<double> v_final = lattice.v;
+
+  for(int i = 0; i < lattice.nlocal; ++i) {
+    if(!(lattice.mask[i] & groupbit)) continue;
+
+    double dtfm = dtf / mass[lattice.type[i]];
+    for(size_t d = 0; d < 3; ++d) {
+      v_initial[3 * i + d] += dtfm * lattice.f[3 * i + d];
+      x_ref[3 * i + d] += dtv * v_initial[3 * i + d];
+      v_final[3 * i + d] += dtfm * lattice.f[3 * i + d];
+    }
+  }
+
+  bool ok {true};
+  char label[128];
+
+  Kernels<DeviceType> first_half(lattice, beta, groupbit);
+  first_half.template launch<TagFixEPHInitialIntegrate>();
+  snprintf(label, sizeof(label), "%s initial integrate x, v", space);
+  ok = check(label, std::max(difference(Kernels<DeviceType>::pull(first_half.kernels.x), x_ref, n),
+    difference(Kernels<DeviceType>::pull(first_half.kernels.v), v_initial, n)), 1e-12) && ok;
+
+  Kernels<DeviceType> second_half(lattice, beta, groupbit);
+  second_half.template launch<TagFixEPHFinalIntegrate>();
+  snprintf(label, sizeof(label), "%s final integrate v", space);
+  ok = check(label, difference(Kernels<DeviceType>::pull(second_half.kernels.v), v_final, n), 1e-12) && ok;
+
+  return ok;
+}
+
+template<class DeviceType>
+bool test_space(const char* space, const Lattice& lattice, const Beta& beta) {
+  bool ok {true};
+
+  ok = test_forces<DeviceType, true, true, true>(space, lattice, beta) && ok;
+  ok = test_forces<DeviceType, true, false, true>(space, lattice, beta) && ok;
+  ok = test_forces<DeviceType, false, true, true>(space, lattice, beta) && ok;
+  ok = test_forces<DeviceType, true, true, false>(space, lattice, beta) && ok;
+  ok = test_forces<DeviceType, true, false, false>(space, lattice, beta) && ok;
+  ok = test_forces<DeviceType, false, true, false>(space, lattice, beta) && ok;
+  ok = test_integrators<DeviceType>(space, lattice, beta) && ok;
+
+  return ok;
+}
+
+int main(int args, char **argv) {
+  Kokkos::ScopeGuard guard(args, argv);
+
+  bool ok {true};
+  std::mt19937 gen(12345);
+
+  Beta beta("../EPH_Beta/NiFe.beta");
+  Lattice lattice(4, beta.get_r_cutoff() + r_skin, gen);
+
+  size_t n_pairs {0};
+  for(const std::vector<int>& list : lattice.neighbours) { n_pairs += list.size(); }
+  printf("%d local atoms, %d ghosts, %zu neighbours\n", lattice.nlocal, lattice.ntotal - lattice.nlocal, n_pairs);
+
+  // the spaces fix eph/kk is instantiated for
+  ok = test_space<LMPDeviceType>("device", lattice, beta) && ok;
+#ifdef LMP_KOKKOS_GPU
+  ok = test_space<LMPHostType>("host", lattice, beta) && ok;
+#endif
+
+  printf("%s\n", ok ? "ALL OK" : "SOME FAILED");
+
+  return ok ? 0 : 1;
+}
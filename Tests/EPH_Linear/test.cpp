@@ -0,0 +1,83 @@
+
+#include <cmath>
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "eph_linear.h"
+
+/*
+ * Compares EPH_Linear::reverse() against the plain binary search over the 
+ * E(T) table that it replaces. The results have to be identical.
+ */
+
+// E(T) table as created in eph_kappa.h
+constexpr size_t n {3001};
+constexpr double dT {10.0};
+
+constexpr size_t n_lookups {10000000};
+
+// reference implementation (std::upper_bound over the whole table)
+double reverse_binary(const EPH_Linear& f, double _y) {
+  auto it {std::upper_bound(f.y.begin(), f.y.end(), _y)};
+  if(it != f.y.end() && it != f.y.begin()) {
+    size_t idx {static_cast<size_t>(std::distance(f.y.begin(), it))};
+    idx--;
+    return idx * f.dx + 1. / f.dy[idx] * (_y - f.y[idx]);
+  }
+  
+  return 0.;
+}
+
+int main(int args, char **argv) {
+  // C(T) grows linearly and saturates, with a flat part in E(T)
+  std::vector<double> E_T(n);
+  E_T[0] = 0.;
+  for(size_t i = 1; i < n; ++i) {
+    double T = i * dT;
+    double C = (i > 1000 && i < 1010) ? 0. : 1e-5 * std::min(T, 5000.) + 1e-6;
+    E_T[i] = E_T[i - 1] + C * dT;
+  }
+  
+  EPH_Linear linear(dT, E_T.begin(), E_T.end());
+  
+  std::mt19937_64 gen(12345);
+  std::uniform_real_distribution<double> dist(-0.01 * E_T.back(), 1.01 * E_T.back());
+  std::vector<double> E(n_lookups);
+  for(double& e : E) { e = dist(gen); }
+  
+  // table knots must map back exactly as well
+  for(size_t i = 0; i < n; ++i) { E[i] = E_T[i]; }
+  
+  { // test that both give the same results
+    size_t mismatches = 0;
+    for(double e : E) {
+      if(e < E_T.front()) continue; // undefined in the original
+      if(linear.reverse(e) != reverse_binary(linear, e)) { ++mismatches; }
+    }
+    
+    std::cout << "Mismatches: " << mismatches << '\n';
+    assert(mismatches == 0 && "inverse table differs from the binary search");
+  }
+  
+  { // benchmark
+    double sum {0.};
+    auto t_0 = std::chrono::steady_clock::now();
+    for(double e : E) { sum += reverse_binary(linear, e); }
+    auto t_1 = std::chrono::steady_clock::now();
+    for(double e : E) { sum -= linear.reverse(e); }
+    auto t_2 = std::chrono::steady_clock::now();
+    
+    double t_binary = std::chrono::duration<double>(t_1 - t_0).count();
+    double t_table = std::chrono::duration<double>(t_2 - t_1).count();
+    
+    std::cout << "Binary search: " << t_binary / n_lookups * 1e9 << " ns/lookup\n";
+    std::cout << "Inverse table: " << t_table / n_lookups * 1e9 << " ns/lookup\n";
+    std::cout << "Speedup: " << t_binary / t_table << " (" << sum << ")\n";
+  }
+  
+  return 0;
+}
@@ -0,0 +1,82 @@
+
+#include <cmath>
+#include <cassert>
+#include <cstdio>
+#include <cstdint>
+
+#include "eph_philox.h"
+
+/*
+ * Checks EPH_Philox against the Random123 known answers for Philox4x32-10
+ * and the first moments of the normal variates drawn over atom tags and
+ * timesteps. The same (tag, step) has to give the same numbers.
+ */
+
+constexpr uint64_t n_tags {100000};
+constexpr uint64_t n_steps {10};
+
+bool check_known_answer(uint32_t c, uint32_t k, const uint32_t* expected) {
+  uint32_t ctr[4] {c, c, c, c};
+  uint32_t key[2] {k, k};
+  EPH_Philox::block(ctr, key);
+
+  bool ok {true};
+  for(int i = 0; i < 4; ++i) { ok = ok && ctr[i] == expected[i]; }
+  printf("ctr = key = %08x: %08x %08x %08x %08x %s\n",
+    c, ctr[0], ctr[1], ctr[2], ctr[3], ok ? "OK" : "FAILED");
+  return ok;
+}
+
+int main(int args, char **argv) {
+  const uint32_t zero[4] {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8};
+  const uint32_t ones[4] {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd};
+
+  bool ok {true};
+  ok = check_known_answer(0x00000000, 0x00000000, zero) && ok;
+  ok = check_known_answer(0xffffffff, 0xffffffff, ones) && ok;
+
+  EPH_Philox philox(12345);
+
+  // moments of the normal variates
+  double m1 {0}, m2 {0}, m3 {0}, m4 {0};
+  double c01 {0};
+  size_t n {0};
+  for(uint64_t step = 0; step < n_steps; ++step) {
+    for(uint64_t tag = 1; tag <= n_tags; ++tag) {
+      double xi[3];
+      philox.get_gaussian3(tag, step, xi);
+
+      for(int k = 0; k < 3; ++k) {
+        m1 += xi[k];
+        m2 += xi[k] * xi[k];
+        m3 += xi[k] * xi[k] * xi[k];
+        m4 += xi[k] * xi[k] * xi[k] * xi[k];
+        ++n;
+      }
+      c01 += xi[0] * xi[2];
+    }
+  }
+
+  m1 /= n; m2 /= n; m3 /= n; m4 /= n;
+  c01 /= n_tags * n_steps;
+
+  // ~5 sigma bounds for the sample size
+  const double s {1. / std::sqrt(static_cast<double>(n))};
+  bool moments {std::fabs(m1) < 5. * s && std::fabs(m2 - 1.) < 5. * std::sqrt(2.) * s &&
+    std::fabs(m3) < 5. * std::sqrt(15.) * s && std::fabs(m4 - 3.) < 5. * std::sqrt(96.) * s &&
+    std::fabs(c01) < 5. * std::sqrt(3.) * s};
+  printf("<x> = %.5f <x^2> = %.5f <x^3> = %.5f <x^4> = %.5f <x0 x2> = %.5f %s\n",
+    m1, m2, m3, m4, c01, moments ? "OK" : "FAILED");
+  ok = ok && moments;
+
+  // the numbers depend on (tag, step) only
+  double a[3], b[3];
+  philox.get_gaussian3(42, 7, a);
+  philox.get_gaussian3(43, 7, b);
+  philox.get_gaussian3(42, 7, b);
+  bool repeat {a[0] == b[0] && a[1] == b[1] && a[2] == b[2]};
+  printf("repeated draw: %s\n", repeat ? "OK" : "FAILED");
+  ok = ok && repeat;
+
+  return ok ? 0 : 1;
+}
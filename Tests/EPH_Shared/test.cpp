@@ -0,0 +1,88 @@
+#include <cstdio>
+#include <cmath>
+#include <mpi.h>
+
+#include "eph_beta.h"
+#include "eph_shared.h"
+
+/*
+ * Checks that beta(rho) tables moved into a node shared window give the same
+ * values as the tables of the task and that every table of every task is a
+ * view with no copy of its own. Run with several tasks on one node.
+ */
+
+// every table reads the window and keeps no memory of its own
+bool all_views(Beta& beta) {
+  for(const Spline* spline : beta.get_splines()) {
+    if(!spline->is_table_view() || spline->get_table_capacity() != 0) { return false; }
+  }
+
+  return true;
+}
+
+// max. absolute difference of rho(r), beta(rho) and alpha(rho) over a fine grid
+double compare(const Beta& a, const Beta& b) {
+  double max_diff {0};
+
+  for(size_t e = 0; e < a.get_n_elements(); ++e) {
+    for(size_t i = 0; i < 1000; ++i) {
+      double r = a.get_r_cutoff() * i / 1000;
+      double rho = a.get_rho_cutoff() * i / 1000;
+
+      max_diff = std::max(max_diff, std::fabs(a.get_rho(e, r) - b.get_rho(e, r)));
+      max_diff = std::max(max_diff, std::fabs(a.get_rho_r_sq(e, r * r) - b.get_rho_r_sq(e, r * r)));
+      max_diff = std::max(max_diff, std::fabs(a.get_beta(e, rho) - b.get_beta(e, rho)));
+      max_diff = std::max(max_diff, std::fabs(a.get_alpha(e, rho) - b.get_alpha(e, rho)));
+    }
+  }
+
+  return max_diff;
+}
+
+int main(int args, char **argv) {
+  MPI_Init(&args, &argv);
+
+  int my_id, nr_ps;
+  MPI_Comm_rank(MPI_COMM_WORLD, &my_id);
+  MPI_Comm_size(MPI_COMM_WORLD, &nr_ps);
+
+  bool ok {true};
+
+  for(const char* file : {"../../Data/Ni/Ni_PRB2019.beta", "../../Data/NiCoCrFe/NiCoCrFe_PRB2019.beta"}) {
+    Beta local(file);
+    Beta shared(file);
+
+    bool same {false};
+    size_t table_bytes {0};
+
+    {
+      EPH_NodeShared tables(MPI_COMM_WORLD, shared.get_splines());
+
+      // copies of the fix share the window too
+      Beta copy {shared};
+      same = compare(local, shared) == 0 && compare(local, copy) == 0;
+      same = same && all_views(shared) && all_views(copy);
+
+      table_bytes = tables.memory_bytes();
+
+      long node_bytes = table_bytes;
+      MPI_Allreduce(MPI_IN_PLACE, &node_bytes, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+      int all_same = same;
+      MPI_Allreduce(MPI_IN_PLACE, &all_same, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+
+      if(my_id == 0) {
+        printf("%s: %zu bytes of tables once for %d tasks (%ld on all tasks) %s\n", file,
+          table_bytes, tables.get_node_size(), node_bytes, all_same ? "OK" : "FAILED");
+      }
+
+      ok = ok && all_same;
+    }
+  }
+
+  if(my_id == 0) { printf("%s\n", ok ? "ALL OK" : "SOME FAILED"); }
+
+  MPI_Finalize();
+
+  return ok ? 0 : 1;
+}
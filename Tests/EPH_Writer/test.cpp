@@ -0,0 +1,105 @@
+#include <cstdio>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "eph_writer.h"
+
+/*
+ * Checks that EPH_Writer runs the jobs in order on its own thread, that
+ * push() returns while the thread is busy and blocks only on a full queue,
+ * and that the buffers of finished jobs are handed out again.
+ */
+
+constexpr size_t n_jobs {20};
+constexpr size_t n_values {1000};
+
+int main(int args, char **argv) {
+  bool ok {true};
+
+  std::vector<size_t> order;
+  std::vector<double> sums;
+  std::atomic<bool> release {false};
+
+  {
+    EPH_Writer writer;
+
+    // the first job holds the thread until it is released
+    writer.push(writer.get_buffer(1), [&release] (const EPH_Writer::Buffer&) {
+      while(!release) { std::this_thread::yield(); }
+    });
+
+    // one job fits into the queue while the thread is busy
+    auto t0 = std::chrono::steady_clock::now();
+    writer.push(writer.get_buffer(1), [] (const EPH_Writer::Buffer&) {});
+    double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    bool async {dt < 0.1};
+    printf("push while busy: %.3g s %s\n", dt, async ? "OK" : "FAILED");
+    ok = ok && async;
+
+    // the next one waits for the queue
+    std::thread releaser([&release] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      release = true;
+    });
+
+    t0 = std::chrono::steady_clock::now();
+    writer.push(writer.get_buffer(1), [] (const EPH_Writer::Buffer&) {});
+    dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    releaser.join();
+
+    bool blocked {dt > 0.1};
+    printf("push on full queue: %.3g s %s\n", dt, blocked ? "OK" : "FAILED");
+    ok = ok && blocked;
+
+    writer.wait();
+
+    // snapshots are written in order and reuse the buffers
+    const double* first {nullptr};
+    size_t reused {0};
+    for(size_t n = 0; n < n_jobs; ++n) {
+      EPH_Writer::Buffer buffer {writer.get_buffer(n_values)};
+      if(n == 0) { first = buffer.data(); }
+      else if(buffer.data() == first) { ++reused; }
+
+      for(size_t i = 0; i < n_values; ++i) { buffer[i] = n; }
+
+      writer.push(std::move(buffer), [n, &order, &sums] (const EPH_Writer::Buffer& values) {
+        double sum {0};
+        for(double v : values) { sum += v; }
+        order.push_back(n);
+        sums.push_back(sum);
+      });
+
+      writer.wait();
+    }
+
+    printf("buffer reused %zu of %zu times %s\n", reused, n_jobs - 1, reused == n_jobs - 1 ? "OK" : "FAILED");
+    ok = ok && reused == n_jobs - 1;
+
+    // jobs still queued are written by the destructor
+    for(size_t n = n_jobs; n < 2 * n_jobs; ++n) {
+      EPH_Writer::Buffer buffer {writer.get_buffer(n_values)};
+      for(size_t i = 0; i < n_values; ++i) { buffer[i] = n; }
+
+      writer.push(std::move(buffer), [n, &order, &sums] (const EPH_Writer::Buffer& values) {
+        double sum {0};
+        for(double v : values) { sum += v; }
+        order.push_back(n);
+        sums.push_back(sum);
+      });
+    }
+  }
+
+  bool in_order {order.size() == 2 * n_jobs};
+  for(size_t n = 0; in_order && n < order.size(); ++n) {
+    in_order = order[n] == n && sums[n] == static_cast<double>(n * n_values);
+  }
+  printf("%zu snapshots written in order: %s\n", order.size(), in_order ? "OK" : "FAILED");
+  ok = ok && in_order;
+
+  printf("%s\n", ok ? "ALL OK" : "SOME FAILED");
+  return ok ? 0 : 1;
+}
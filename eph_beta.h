@@ -17,6 +17,7 @@
 
 // internal headers
 #include "eph_spline.h"
+#include "eph_table.h"
 
 /*
  * Stripped down version of beta(rho) class
@@ -36,18 +37,13 @@ class EPH_Beta {
       rho_cutoff {0}
       {}
 
-    EPH_Beta(const char* file) {
-      std::ifstream fd(file);
-
-      assert(fd.is_open());
-
-      char line[max_line_length];
+    EPH_Beta(const char* file) :
+      EPH_Beta(EPH_Table::read(file))
+      {}
 
-      // read first three lines
-      // these are comments so we ignore them
-      fd.getline(line, max_line_length);
-      fd.getline(line, max_line_length);
-      fd.getline(line, max_line_length);
+    // build the tables from the contents of a .beta file
+    explicit EPH_Beta(const EPH_Table& table) {
+      EPH_Table::Cursor fd(table);
 
       // read the header
       fd >> n_elements;
@@ -62,15 +58,9 @@ class EPH_Beta {
       beta.resize(n_elements);
       rho_r_sq.resize(n_elements);
 
-      // read the number of elements and their names
-      fd.getline(line, max_line_length);
-      std::string str(line);
-      std::istringstream strstream(str);
-
+      // the names of the elements
       for(size_t i = 0; i < n_elements; ++i) {
-        std::string elem;
-        strstream >> elem;
-        element_name[i] = elem;
+        element_name[i] = fd.get_name(i);
       }
 
       // read spline parameters
@@ -123,14 +113,25 @@ class EPH_Beta {
 
         alpha[i] = Spline(drho, l_beta);
       }
-
-      fd.close();
     }
 
     size_t get_n_elements() const {
       return n_elements;
     }
 
+    // bytes of the spline tables and the element data
+    size_t memory_bytes() const {
+      size_t bytes = element_number.capacity() * sizeof(uint8_t);
+      bytes += element_name.capacity() * sizeof(std::string);
+
+      for(const auto& splines : {&rho, &rho_r_sq, &alpha, &beta}) {
+        bytes += splines->capacity() * sizeof(Spline);
+        for(const Spline& spline : *splines) { bytes += spline.memory_bytes(); }
+      }
+
+      return bytes;
+    }
+
     Float get_r_cutoff() const {
       return r_cutoff;
     }
@@ -182,6 +183,33 @@ class EPH_Beta {
       return alpha[index](rho_i);
     }
 
+    // splines of element index, for copies of the tables (e.g. device views)
+    const Spline& get_rho_r_sq_spline(size_t index) const {
+      assert(index < n_elements);
+      return rho_r_sq[index];
+    }
+
+    const Spline& get_alpha_spline(size_t index) const {
+      assert(index < n_elements);
+      return alpha[index];
+    }
+
+    const Spline& get_beta_spline(size_t index) const {
+      assert(index < n_elements);
+      return beta[index];
+    }
+
+    // every spline of the tables, e.g. to move them into node shared memory
+    std::vector<Spline*> get_splines() {
+      std::vector<Spline*> splines;
+
+      for(auto* tables : {&rho, &rho_r_sq, &alpha, &beta}) {
+        for(Spline& spline : *tables) { splines.push_back(&spline); }
+      }
+
+      return splines;
+    }
+
   protected:
     static constexpr unsigned int max_line_length = 1024; // this is for parsing
 
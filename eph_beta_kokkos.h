@@ -0,0 +1,118 @@
+/*
+ * Authors of the extension Artur Tamm, Alfredo Correa
+ * e-mail: artur.tamm.work@gmail.com
+ */
+
+#ifndef EPH_BETA_KOKKOS
+#define EPH_BETA_KOKKOS
+
+// external headers
+#include <Kokkos_Core.hpp>
+
+// internal headers
+#include "eph_beta.h"
+
+/*
+ * Tables of EPH_Beta as flat Kokkos views.
+ *
+ * The splines rho(r^2), alpha(rho) and beta(rho) of every element are stored
+ * back to back in one view of polynomial coefficients; spline s covers the
+ * knots [first(s), first(s + 1)). The struct holds only views and numbers, so
+ * kernels take it by value on any execution space. The evaluation is the one
+ * of EPH_Spline and gives the same numbers.
+ */
+
+template<class DeviceType>
+struct EPH_BetaKokkos {
+  enum Table : int {
+    RHO_R_SQ = 0,
+    ALPHA = 1,
+    BETA = 2,
+    N_TABLES = 3
+  };
+
+  int n_elements {0};
+  Kokkos::View<double*[4], DeviceType> coefficients; // a, b, c, d per knot
+  Kokkos::View<int*, DeviceType> first; // first knot of every spline, size = [N_TABLES * n_elements + 1]
+  Kokkos::View<double*, DeviceType> inv_dx; // 1 / dx of every spline
+
+  EPH_BetaKokkos() {}
+
+  EPH_BetaKokkos(const Beta& beta) :
+    n_elements {static_cast<int>(beta.get_n_elements())}
+  {
+    const int n_splines = N_TABLES * n_elements;
+
+    first = Kokkos::View<int*, DeviceType>("eph:beta:first", n_splines + 1);
+    inv_dx = Kokkos::View<double*, DeviceType>("eph:beta:inv_dx", n_splines);
+
+    auto h_first = Kokkos::create_mirror_view(first);
+    auto h_inv_dx = Kokkos::create_mirror_view(inv_dx);
+
+    h_first(0) = 0;
+    for(int s = 0; s < n_splines; ++s) {
+      const Spline& spline = get_spline(beta, s);
+      h_first(s + 1) = h_first(s) + spline.get_n_points();
+      h_inv_dx(s) = spline.get_inv_dx();
+    }
+
+    coefficients = Kokkos::View<double*[4], DeviceType>("eph:beta:coefficients", h_first(n_splines));
+    auto h_coefficients = Kokkos::create_mirror_view(coefficients);
+
+    for(int s = 0; s < n_splines; ++s) {
+      const Spline& spline = get_spline(beta, s);
+
+      for(size_t k = 0; k < spline.get_n_points(); ++k) {
+        double abcd[4];
+        spline.get_coefficients(k, abcd);
+
+        for(int l = 0; l < 4; ++l) { h_coefficients(h_first(s) + k, l) = abcd[l]; }
+      }
+    }
+
+    Kokkos::deep_copy(first, h_first);
+    Kokkos::deep_copy(inv_dx, h_inv_dx);
+    Kokkos::deep_copy(coefficients, h_coefficients);
+  }
+
+  // bytes of the views
+  size_t memory_bytes() const {
+    return coefficients.size() * sizeof(double) + first.size() * sizeof(int)
+      + inv_dx.size() * sizeof(double);
+  }
+
+  KOKKOS_INLINE_FUNCTION
+  double evaluate(int spline, double x) const {
+    const int k = first(spline) + static_cast<int>(x * inv_dx(spline));
+    return coefficients(k, 0) + x * (coefficients(k, 1) + x * (coefficients(k, 2) + x * coefficients(k, 3)));
+  }
+
+  KOKKOS_INLINE_FUNCTION
+  double get_rho_r_sq(int index, double r_sq) const {
+    return evaluate(RHO_R_SQ * n_elements + index, r_sq);
+  }
+
+  KOKKOS_INLINE_FUNCTION
+  double get_alpha(int index, double rho_i) const {
+    return evaluate(ALPHA * n_elements + index, rho_i);
+  }
+
+  KOKKOS_INLINE_FUNCTION
+  double get_beta(int index, double rho_i) const {
+    return evaluate(BETA * n_elements + index, rho_i);
+  }
+
+  private:
+    // host spline behind index s of the flat table
+    const Spline& get_spline(const Beta& beta, int s) const {
+      const int index = s % n_elements;
+
+      switch(s / n_elements) {
+        case RHO_R_SQ: return beta.get_rho_r_sq_spline(index);
+        case ALPHA: return beta.get_alpha_spline(index);
+        default: return beta.get_beta_spline(index);
+      }
+    }
+};
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * Authors of the extension Artur Tamm, Alfredo Correa
+ * e-mail: artur.tamm.work@gmail.com
+ */
+
+#ifndef EPH_BLOCK_CSR
+#define EPH_BLOCK_CSR
+
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+/*
+ * Block sparse form of the W operator of the PRL model.
+ *
+ * Row i of W holds 3x3 blocks; a neighbour pair (i, j) adds
+ *   a_ij e_ij e_ij^T to the diagonal block (i, i) and
+ *   -a_ji e_ij e_ij^T to the block (i, j),
+ * where a_ij = alpha(rho_i) / rho_i * rho_j(r_ij) / r_ij^2 and e_ij = x_j - x_i.
+ * The transpose W^T has the same diagonal and -a_ij e_ij e_ij^T at (i, j).
+ *
+ * The pairs are added while the densities are summed; alpha(rho) / rho of the
+ * ghosts is known only after communication, so assemble() applies it later.
+ *
+ * Rows are stored in CSR order. Off diagonal blocks are rank one, so an entry
+ * keeps the column, e_ij and both coefficients (6 numbers instead of 9 for a
+ * full block); the diagonal blocks are kept as symmetric 3x3 matrices.
+ * The friction force is -W W^T v and the random force W xi.
+ *
+ * An operator can hold the rows of a contiguous block of atoms starting at
+ * first_row (one block per thread); columns are always atom indices.
+ */
+
+struct EPH_BlockCSR {
+  struct Entry {
+    int j; // column
+    double e[3]; // e_ij
+    double a_ij; // coefficient in W^T
+    double a_ji; // coefficient in W
+  };
+
+  size_t first_row {0}; // atom index of row 0 when the operator holds a block of atoms
+  std::vector<size_t> row_first; // entries of row i are [row_first[i], row_first[i + 1])
+  std::vector<double> diagonal; // xx, yy, zz, xy, xz, yz per row
+  std::vector<Entry> entries;
+
+  EPH_BlockCSR() : row_first(1, 0) {}
+
+  void clear() {
+    row_first.assign(1, 0);
+    diagonal.clear();
+    entries.clear();
+  }
+
+  size_t get_n_rows() const { return row_first.size() - 1; }
+  size_t get_n_entries() const { return entries.size(); }
+
+  // bytes of the rows, diagonal blocks and entries
+  size_t memory_bytes() const {
+    return row_first.capacity() * sizeof(size_t)
+      + diagonal.capacity() * sizeof(double)
+      + entries.capacity() * sizeof(Entry);
+  }
+
+  // rows are added in order; a row without pairs is a zero row
+  void add_row() {
+    row_first.back() = entries.size(); // close the previous row
+    row_first.push_back(entries.size());
+  }
+
+  // add pair (i, j) to the last row; g_ij and g_ji are the coefficients before
+  // assemble() scales them with the per atom factors
+  void add_pair(int j, const double* e_ij, double g_ij, double g_ji) {
+    Entry entry;
+    entry.j = j;
+    entry.e[0] = e_ij[0];
+    entry.e[1] = e_ij[1];
+    entry.e[2] = e_ij[2];
+    entry.a_ij = g_ij;
+    entry.a_ji = g_ji;
+    entries.push_back(entry);
+  }
+
+  // close the last row, set a_ij = factor[i] g_ij and a_ji = factor[j] g_ji and
+  // sum the diagonal blocks; a pair couples only if both factors are positive
+  void assemble(const double* factor) {
+    row_first.back() = entries.size();
+
+    const size_t n_rows = get_n_rows();
+    diagonal.resize(6 * n_rows);
+
+    for(size_t i = 0; i != n_rows; ++i) {
+      double d[6] {0., 0., 0., 0., 0., 0.};
+      const double f_i = factor[first_row + i];
+
+      for(size_t p = row_first[i]; p != row_first[i + 1]; ++p) {
+        Entry& entry = entries[p];
+        const double f_j = factor[entry.j];
+
+        if(!(f_i > 0) || !(f_j > 0)) {
+          entry.a_ij = 0.;
+          entry.a_ji = 0.;
+          continue;
+        }
+
+        entry.a_ij *= f_i;
+        entry.a_ji *= f_j;
+
+        const double* e = entry.e;
+        const double a = entry.a_ij;
+        d[0] += a * e[0] * e[0];
+        d[1] += a * e[1] * e[1];
+        d[2] += a * e[2] * e[2];
+        d[3] += a * e[0] * e[1];
+        d[4] += a * e[0] * e[2];
+        d[5] += a * e[1] * e[2];
+      }
+
+      std::copy(d, d + 6, &(diagonal[6 * i]));
+    }
+  }
+
+  // y_i = (W x)_i for every row i; x has to hold every column (ghosts included)
+  void apply(const double* const* x, double* const* y) const {
+    multiply<false>(x, y);
+  }
+
+  // y_i = (W^T x)_i for every row i
+  void apply_transpose(const double* const* x, double* const* y) const {
+    multiply<true>(x, y);
+  }
+
+  // y1 = W x1 and y2 = W x2 in one pass over the operator
+  void apply(const double* const* x1, double* const* y1,
+      const double* const* x2, double* const* y2) const {
+    const size_t n_rows = get_n_rows();
+    const Entry* entry = entries.data();
+
+    for(size_t i = 0; i != n_rows; ++i) {
+      const size_t ii = first_row + i;
+
+      double s1[3], s2[3];
+      diagonal_product(i, x1[ii], s1);
+      diagonal_product(i, x2[ii], s2);
+
+      for(size_t p = row_first[i]; p != row_first[i + 1]; ++p) {
+        const double* e = entry[p].e;
+        const double* x1_j = x1[entry[p].j];
+        const double* x2_j = x2[entry[p].j];
+
+        double v1 = entry[p].a_ji * (e[0] * x1_j[0] + e[1] * x1_j[1] + e[2] * x1_j[2]);
+        double v2 = entry[p].a_ji * (e[0] * x2_j[0] + e[1] * x2_j[1] + e[2] * x2_j[2]);
+
+        s1[0] -= v1 * e[0];
+        s1[1] -= v1 * e[1];
+        s1[2] -= v1 * e[2];
+
+        s2[0] -= v2 * e[0];
+        s2[1] -= v2 * e[1];
+        s2[2] -= v2 * e[2];
+      }
+
+      y1[ii][0] = s1[0];
+      y1[ii][1] = s1[1];
+      y1[ii][2] = s1[2];
+
+      y2[ii][0] = s2[0];
+      y2[ii][1] = s2[1];
+      y2[ii][2] = s2[2];
+    }
+  }
+
+  // s = D_i x
+  void diagonal_product(size_t i, const double* x, double* s) const {
+    const double* d = &(diagonal[6 * i]);
+    s[0] = d[0] * x[0] + d[3] * x[1] + d[4] * x[2];
+    s[1] = d[3] * x[0] + d[1] * x[1] + d[5] * x[2];
+    s[2] = d[4] * x[0] + d[5] * x[1] + d[2] * x[2];
+  }
+
+  // loop of apply() and apply_transpose()
+  template<bool transpose>
+  void multiply(const double* const* x, double* const* y) const {
+    const size_t n_rows = get_n_rows();
+    const Entry* entry = entries.data();
+
+    for(size_t i = 0; i != n_rows; ++i) {
+      const size_t ii = first_row + i;
+
+      double s[3];
+      diagonal_product(i, x[ii], s);
+
+      for(size_t p = row_first[i]; p != row_first[i + 1]; ++p) {
+        const double* e = entry[p].e;
+        const double* x_j = x[entry[p].j];
+
+        double a = transpose ? entry[p].a_ij : entry[p].a_ji;
+        double v = a * (e[0] * x_j[0] + e[1] * x_j[1] + e[2] * x_j[2]);
+
+        s[0] -= v * e[0];
+        s[1] -= v * e[1];
+        s[2] -= v * e[2];
+      }
+
+      y[ii][0] = s[0];
+      y[ii][1] = s[1];
+      y[ii][2] = s[2];
+    }
+  }
+};
+
+#endif
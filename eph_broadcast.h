@@ -0,0 +1,67 @@
+/*
+ * Authors of the extension Artur Tamm, Alfredo Correa
+ * e-mail: artur.tamm.work@gmail.com
+ */
+
+#ifndef EPH_BROADCAST
+#define EPH_BROADCAST
+
+// external headers
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#include <mpi.h>
+
+// internal headers
+#include "eph_table.h"
+
+/*
+ * Task 0 reads a table file and broadcasts its numbers to the other tasks,
+ * so the file is opened once per job instead of once per task.
+ * This is collective over comm.
+ */
+
+inline EPH_Table eph_broadcast_table(const char* file, MPI_Comm comm) {
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+
+  EPH_Table table;
+  std::string names; // separated by spaces
+
+  if(rank == 0) {
+    table = EPH_Table::read(file);
+
+    for(const std::string& name : table.names)
+      names += name + ' ';
+  }
+
+  uint64_t sizes[2] {names.size(), table.values.size()};
+  MPI_Bcast(sizes, 2, MPI_UINT64_T, 0, comm);
+
+  names.resize(sizes[0]);
+  table.values.resize(sizes[1]);
+
+  if(sizes[0] > 0)
+    MPI_Bcast(&names[0], static_cast<int>(sizes[0]), MPI_CHAR, 0, comm);
+
+  // MPI_Bcast takes an int count
+  constexpr size_t chunk = 1 << 30;
+  for(size_t first = 0; first < table.values.size(); first += chunk) {
+    int count = static_cast<int>(std::min(chunk, table.values.size() - first));
+    MPI_Bcast(table.values.data() + first, count, MPI_DOUBLE, 0, comm);
+  }
+
+  if(rank != 0) {
+    std::istringstream strstream(names);
+    for(std::string name; strstream >> name; )
+      table.names.push_back(name);
+  }
+
+  return table;
+}
+
+#endif
@@ -8,6 +8,9 @@
 
 #include "eph_spline.h"
 #include "eph_linear.h"
+#include "eph_timer.h"
+#include "eph_writer.h"
+#include "eph_frames.h"
 
 #include <iostream>
 #include <cassert>
@@ -16,9 +19,29 @@
 #include <cmath>
 #include <cstring>
 #include <numeric>
+#include <limits>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <cstdio>
+#include <memory>
+#include <cstdint>
+#include <initializer_list>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <mpi.h>
 
+#ifdef EPH_OMP
+#include <omp.h>
+#define EPH_PRAGMA_OMP(x) _Pragma(#x)
+#else
+#define EPH_PRAGMA_OMP(x)
+#endif
+
 class EPH_FDM
 {
   public:
@@ -45,77 +68,28 @@ class EPH_FDM
       parameter_filename = "NULL";
     }
     
+    // read a grid saved by save_state(); binary and text files are told apart by their first bytes
     EPH_FDM(const char *in_filename) 
     {
-      std::ifstream fd {in_filename}; assert(fd); // break code here
-      
-      // 3 first lines are comments
-      char line[lineLength];
-      fd.getline(line, lineLength); assert(line[0] == '#');
-      fd.getline(line, lineLength); assert(line[0] == '#');
-      fd.getline(line, lineLength); assert(line[0] == '#');
-      
-      // next line defines grid size
-      fd >> nx >> ny >> nz;
-      resize_vectors(nx, ny, nz);
-      
-      fd >> steps;
-      
-      // define box size
-      fd >> x0 >> x1
-         >> y0 >> y1
-         >> z0 >> z1;
-      
-      set_box_dimensions(x0, x1, y0, y1, z0, z1);
-      
-      fd >> parameter_filename;
+      read_state(in_filename);
+      set_parameters(read_parameters());
+    }
+    
+    // same as above but only task 0 of in_comm reads the files and broadcasts the grid
+    EPH_FDM(const char *in_filename, MPI_Comm in_comm) 
+    {
+      int rank;
+      MPI_Comm_rank(in_comm, &rank);
       
-      // load temperature dependent parameters 
-      if(parameter_filename != "NULL")
+      std::vector<double> table;
+      if(rank == 0) 
       {
-        std::ifstream fd {parameter_filename}; assert(fd);
-        
-        // 3 first lines are comments
-        char line[lineLength];
-        fd.getline(line, lineLength); assert(line[0] == '#');
-        fd.getline(line, lineLength); assert(line[0] == '#');
-        fd.getline(line, lineLength); assert(line[0] == '#');
-        
-        size_t n; fd >> n;
-        double dT; fd >> dT;
-        
-        std::vector<double> in_C_e_T(n);
-        std::vector<double> in_kappa_e_T(n);
-        
-        for(size_t i = 0; i < n; ++i)
-        {
-          fd >> in_C_e_T[i] >> in_kappa_e_T[i]; // read data from file
-        }
-        
-        C_e_T = Spline(dT, in_C_e_T);
-        kappa_e_T = Spline(dT, in_kappa_e_T);
-        
-        // create Ee(Te) mapping
-        in_C_e_T[0] = 0.;
-        for(size_t i = 1; i < in_C_e_T.size(); ++i) {
-          in_C_e_T[i] = in_C_e_T[i - 1] + in_C_e_T[i] * dT;
-        }
-        E_e_T = EPH_Linear(dT, in_C_e_T.begin(), in_C_e_T.end());
+        read_state(in_filename);
+        table = read_parameters();
       }
       
-      // read grid values
-      for(size_t i = 0; i != ntotal; ++i) {
-        int lx, ly, lz;
-        fd >> lx >> ly >> lz;
-        size_t index = lx + ly * nx + lz * nx * ny;   
-        fd >> T_e[index]
-           >> S_e[index]
-           >> rho_e[index]
-           >> C_e[index]
-           >> kappa_e[index]
-           >> flag[index]
-           >> T_dynamic_flag[index];
-      }
+      broadcast_state(in_comm, rank, table);
+      set_parameters(table);
     }
     
     // set box dimensions in Ang
@@ -137,6 +111,8 @@ class EPH_FDM
       dz = (in_z1 - in_z0)/nz;
       
       dV = dx*dy*dz;
+      
+      stencil.valid = false;
     }
     
     // set constant values for as grid parameters
@@ -149,6 +125,8 @@ class EPH_FDM
       std::fill(kappa_e.begin(), kappa_e.end(), in_kappa_e);
       std::fill(flag.begin(), flag.end(), 1);
       std::fill(T_dynamic_flag.begin(), T_dynamic_flag.end(), false);
+      
+      stencil.valid = false;
     }
     
     void set_dt(double in_dt) 
@@ -161,6 +139,17 @@ class EPH_FDM
       steps = in_steps;
     }
     
+    // select the implicit (ADI) solver; steps is then used as is
+    void set_implicit(bool in_implicit)
+    {
+      if(in_implicit && distributed) 
+      {
+        throw std::runtime_error("EPH_FDM: implicit solver does not support a distributed grid");
+      }
+      
+      implicit = in_implicit;
+    }
+    
     void set_comm(MPI_Comm in_comm, int in_myID, int in_nrPS) 
     {
       world = in_comm;
@@ -168,26 +157,185 @@ class EPH_FDM
       nrPS = in_nrPS;
     } 
     
+    // solve() adds its phases to this timer if one is set
+    void set_timer(EPH_Timer* in_timer)
+    {
+      timer = in_timer;
+    }
+    
+    // set values of a single node in a non-distributed grid
+    void set_S(size_t in_i, size_t in_j, size_t in_k, double in_S) 
+    {
+      S_e[get_node_index(in_i, in_j, in_k)] = in_S;
+    }
+    
+    void set_C_e(size_t in_i, size_t in_j, size_t in_k, double in_C_e) 
+    {
+      C_e[get_node_index(in_i, in_j, in_k)] = in_C_e;
+      stencil.valid = false;
+    }
+    
+    void set_kappa_e(size_t in_i, size_t in_j, size_t in_k, double in_kappa_e) 
+    {
+      kappa_e[get_node_index(in_i, in_j, in_k)] = in_kappa_e;
+      stencil.valid = false;
+    }
+    
+    void set_flag(size_t in_i, size_t in_j, size_t in_k, signed short in_flag) 
+    {
+      flag[get_node_index(in_i, in_j, in_k)] = in_flag;
+      stencil.valid = false;
+    }
+    
+    /*
+     * Distribute the grid over the ranks. Every rank keeps the cells whose 
+     * lower corner lies inside its subdomain [in_sublo, in_subhi) and in_halo 
+     * layers of ghost cells around them. in_neighbours are the ranks of the 
+     * adjacent subdomains in -/+ direction (periodic). This is collective.
+     */
+    void set_decomposition(
+      const double* in_sublo, const double* in_subhi, 
+      const int (*in_neighbours)[2], size_t in_halo)
+    {
+      if(implicit) 
+      {
+        throw std::runtime_error("EPH_FDM: implicit solver does not support a distributed grid");
+      }
+      
+      if(distributed) { *this = gather_grid(true); }
+      
+      const size_t n[3] {nx, ny, nz};
+      const double lo[3] {x0, y0, z0};
+      const double d[3] {dx, dy, dz};
+      
+      int valid = 1;
+      for(int i = 0; i < 3; ++i) 
+      {
+        sub_lo[i] = static_cast<size_t>(std::max(0., std::ceil((in_sublo[i] - lo[i]) / d[i])));
+        sub_hi[i] = static_cast<size_t>(std::max(0., std::ceil((in_subhi[i] - lo[i]) / d[i])));
+        sub_hi[i] = std::min(sub_hi[i], n[i]);
+        
+        // neighbours can provide only cells they own
+        if(sub_hi[i] < sub_lo[i] + in_halo) { valid = 0; }
+        
+        neighbours[i][0] = in_neighbours[i][0];
+        neighbours[i][1] = in_neighbours[i][1];
+      }
+      
+      MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_INT, MPI_MIN, world);
+      if(!valid) 
+      {
+        throw std::runtime_error("EPH_FDM: grid is too coarse for the domain decomposition");
+      }
+      
+      halo = in_halo;
+      for(int i = 0; i < 3; ++i) { l_n[i] = sub_hi[i] - sub_lo[i] + 2 * halo; }
+      l_total = l_n[0] * l_n[1] * l_n[2];
+      
+      // copy the local block and its ghost layers out of the full grid
+      std::vector<size_t> map(l_total);
+      for(size_t k = 0; k < l_n[2]; ++k) {
+        size_t gk = (sub_lo[2] + nz + k - halo) % nz;
+        for(size_t j = 0; j < l_n[1]; ++j) {
+          size_t gj = (sub_lo[1] + ny + j - halo) % ny;
+          for(size_t i = 0; i < l_n[0]; ++i) {
+            size_t gi = (sub_lo[0] + nx + i - halo) % nx;
+            map[i + j * l_n[0] + k * l_n[0] * l_n[1]] = gi + gj * nx + gk * nx * ny;
+          }
+        }
+      }
+      
+      slice_vector(T_e, map);
+      slice_vector(C_e, map);
+      slice_vector(rho_e, map);
+      slice_vector(kappa_e, map);
+      slice_vector(S_e, map);
+      slice_vector(flag, map);
+      slice_vector(T_dynamic_flag, map);
+      
+      allocate(dT_e, l_total, 0.);
+      allocate(ddT_e, l_total, 0.);
+      
+      distributed = true;
+      stencil.valid = false;
+      update_T_total();
+    }
+    
+    bool is_distributed() const 
+    {
+      return distributed;
+    }
+    
+    size_t get_nx() const { return nx; }
+    size_t get_ny() const { return ny; }
+    size_t get_nz() const { return nz; }
+    
+    void get_box_dimensions(double* out_lo, double* out_hi) const 
+    {
+      out_lo[0] = x0; out_lo[1] = y0; out_lo[2] = z0;
+      out_hi[0] = x1; out_hi[1] = y1; out_hi[2] = z1;
+    }
+    
     // add energy into a cell
     void insert_energy(double x, double y, double z, double E) 
     {
-      unsigned int index = get_index(x, y, z);
+      insert_energy(get_cell(x, y, z), E);
+    }
+    
+    // insert energy into a cell from get_cell()
+    void insert_energy(size_t index, double E) 
+    {
       double prescale = dV * dt;
       
       // convert energy into power per area
       dT_e[index] += E / prescale;
     }
     
+    // cell of a position; the index is local to the task with a distributed grid
+    size_t get_cell(double x, double y, double z) const 
+    {
+      return distributed ? get_local_index(x, y, z) : get_index(x, y, z);
+    }
+    
+    // number of cells get_cell() can return
+    size_t get_n_cells() const 
+    {
+      return dT_e.size();
+    }
+    
+    // bytes of the grid arrays, the stencil, the buffers and the temperature 
+    // dependent parameters held on this rank
+    size_t memory_bytes() const 
+    {
+      size_t bytes = 0;
+      
+      bytes += vector_bytes(T_e) + vector_bytes(dT_e) + vector_bytes(ddT_e);
+      bytes += vector_bytes(C_e) + vector_bytes(rho_e) + vector_bytes(kappa_e);
+      bytes += vector_bytes(S_e) + vector_bytes(flag) + vector_bytes(T_dynamic_flag);
+      bytes += vector_bytes(LT_e) + vector_bytes(T_pad) + vector_bytes(T_next);
+      
+      for(int i = 0; i < 6; ++i) { bytes += vector_bytes(stencil.c[i]); }
+      bytes += vector_bytes(stencil.scale) + vector_bytes(stencil.E_nodes);
+      
+      bytes += vector_bytes(send_buffer) + vector_bytes(recv_buffer);
+      
+      bytes += E_e_T.memory_bytes() + C_e_T.memory_bytes() + kappa_e_T.memory_bytes();
+      
+      return bytes;
+    }
+    
     // get temperature of a cell
     double get_T(double x, double y, double z) const 
     {
-      unsigned int index = get_index(x, y, z);
+      size_t index = distributed ? get_local_index(x, y, z) : get_index(x, y, z);
       
       return T_e[index];
     }
     
     double get_T_total() const 
     {
+      if(distributed) { return T_total; }
+      
       double result {std::accumulate(T_e.begin(), T_e.end(), 0.)};
       
       result /= ntotal; // this calculates the average temperature
@@ -195,213 +343,149 @@ class EPH_FDM
       return result;
     }
     
+    // save_temperature() and save_state() hand copies of the grid to this writer if one is set
+    void set_writer(EPH_Writer* in_writer) 
+    {
+      writer = in_writer;
+    }
+    
+    // this is collective if the grid is distributed
     void save_temperature(const char* in_filename, int in_n) const 
     {
+      Vector<double> g_T_e;
+      if(distributed) { gather_vector(T_e, g_T_e); }
+      if(distributed && myID != 0) { return; }
+      
+      const Vector<double>& l_T_e = distributed ? g_T_e : T_e;
+      
       char fn[512];
       sprintf(fn, "%s_%06d", in_filename, in_n);
-      FILE *fd = fopen(fn, "w");
       
-      assert(fd != nullptr);
-      
-      // this is needed for visit Point3D
-      fprintf(fd, "x y z Te\n");
+      const Header header {get_header()};
       
-      for(int k = 0; k < nz; ++k) {
-        for(int j = 0; j < ny; ++j) {
-          for(int i = 0; i < nx; ++i) {
-            unsigned int index = i + j * nx + k * nx * ny;
-            
-            double x = x0 + i * dx;
-            double y = y0 + j * dy;
-            double z = z0 + k * dz;
-            
-            fprintf(fd, "%.6e %.6e %.6e %.6e\n", x, y, z, T_e[index]);
-          }
-        }
+      if(writer == nullptr) 
+      {
+        write_temperature(fn, header, l_T_e.data());
+        return;
       }
       
-      fclose(fd);
+      EPH_Writer::Buffer buffer {writer->get_buffer(ntotal)};
+      std::copy(l_T_e.begin(), l_T_e.end(), buffer.begin());
+      
+      const std::string name {fn};
+      writer->push(std::move(buffer), [name, header] (const EPH_Writer::Buffer& T) {
+        write_temperature(name.c_str(), header, T.data());
+      });
     }
     
-    void save_state(const char* in_filename) const 
+    // append T_e of timestep in_step to a binary frame file held by task 0;
+    // this is collective if the grid is distributed
+    void save_temperature_frame(const std::shared_ptr<EPH_FrameFile>& in_frames, int64_t in_step) const 
     {
-      FILE *fd = fopen(in_filename, "w");
+      Vector<double> g_T_e;
+      if(distributed) { gather_vector(T_e, g_T_e); }
+      if(distributed && myID != 0) { return; }
       
-      assert(fd != nullptr);
+      const Vector<double>& l_T_e = distributed ? g_T_e : T_e;
       
-      // 3 first lines are comments
-      fprintf(fd, "# A comment\n");
-      fprintf(fd, "#\n");
-      fprintf(fd, "#\n");
+      if(writer == nullptr) 
+      {
+        in_frames->append(in_step, l_T_e.data());
+        return;
+      }
       
-      // next line is grid size and min number of steps
-      fprintf(fd, "%ld %ld %ld %ld\n", nx, ny, nz, steps);
+      EPH_Writer::Buffer buffer {writer->get_buffer(ntotal)};
+      std::copy(l_T_e.begin(), l_T_e.end(), buffer.begin());
       
-      // next we have box size
-      fprintf(fd, "%.6e %.6e\n", x0, x1);
-      fprintf(fd, "%.6e %.6e\n", y0, y1);
-      fprintf(fd, "%.6e %.6e\n", z0, z1);
+      std::shared_ptr<EPH_FrameFile> frames {in_frames};
+      writer->push(std::move(buffer), [frames, in_step] (const EPH_Writer::Buffer& T) {
+        frames->append(in_step, T.data());
+      });
+    }
+    
+    // save_state() writes the binary layout instead of the text one
+    void set_binary_state(bool in_binary_state)
+    {
+      binary_state = in_binary_state;
+    }
+    
+    // this is collective if the grid is distributed
+    void save_state(const char* in_filename) const 
+    {
+      if(distributed) 
+      {
+        EPH_FDM full {gather_grid(false)};
+        if(myID == 0) { full.save_state(in_filename); }
+        return;
+      }
       
-      // filename for temperature dependent parameters
-      fprintf(fd, "%s\n", parameter_filename.c_str());
+      const Header header {get_header()};
       
-      // finally we have grid values
-      for(int k = 0; k < nz; ++k) 
+      EPH_Writer::Buffer buffer {writer ? writer->get_buffer(n_state * ntotal) : EPH_Writer::Buffer(n_state * ntotal)};
+      pack_state(buffer.data());
+      
+      auto write = binary_state ? write_binary_state : write_state;
+      
+      if(writer == nullptr) 
       {
-        for(int j = 0; j < ny; ++j) 
-        {
-          for(int i = 0; i < nx; ++i) 
-          {
-            unsigned int index = i + j * nx + k * nx * ny;
-            fprintf(fd, "%d %d %d %.6e %.6e %.6e %.6e %.6e %d %d\n", 
-              i, j, k, T_e[index], S_e[index], 
-              rho_e[index], C_e[index], kappa_e[index], 
-              flag[index], T_dynamic_flag[index]);
-          }
-        }
+        write(in_filename, header, buffer.data());
+        return;
       }
-
-      fclose(fd);
+      
+      const std::string name {in_filename};
+      writer->push(std::move(buffer), [name, header, write] (const EPH_Writer::Buffer& values) {
+        write(name.c_str(), header, values.data());
+      });
     }
     
     void solve() 
     {
+      if(distributed) 
+      {
+        solve_distributed();
+        return;
+      }
+      
       sync_before();
+      lap(EPH_Timer::FDM_BEFORE);
       
       if(myID == 0) // solving is done only on task 0 
       {  
-        // this is strongly inspired by fix_ttm
-        // check for stability
-        double inner_dt = dt / steps;
-        
-        double dtdxdydz = inner_dt * (1.0/dx/dx + 1.0/dy/dy + 1.0/dz/dz);
-        
-        // update temperature dependent parameters
-        for(size_t i = 0; i < ntotal; ++i)
-        {
-          if(T_dynamic_flag[i])
-          {
-            C_e[i] = C_e_T(T_e[i]);
-            kappa_e[i] = kappa_e_T(T_e[i]);
-          }
-        }
-        
-        /* find smallest C_e and rho_e and largest kappa */
-        double c_min = C_e[0];
-        double rho_min = rho_e[0];
-        double kappa_max = kappa_e[0];
-        
-        for(size_t i = 1; i < ntotal; ++i) {
-          if(flag[i] != CONSTANT_VALUE) {
-            if(C_e[i] < c_min) c_min = C_e[i];
-            if(rho_e[i] < rho_min) rho_min = rho_e[i];
-            if(kappa_e[i] > kappa_max) kappa_max = kappa_e[i];
-          }
-        }
-        
-        double r = dtdxdydz / c_min / rho_min * kappa_max;
-        
-        unsigned int new_steps = steps;
-        
-        // This will become unstable if there are any large fluctuations 
-        // during the solving process; calling this at every step is expensive
-        if(r > 0.4) 
-        {
-          inner_dt = 0.4 * inner_dt / r; // get new stable timestep
-          new_steps = std::max(static_cast<unsigned int> (dt / inner_dt), 1u);
-          inner_dt = dt / new_steps;
-        }
-        
-        for(int n = 0; n < new_steps; ++n) 
-        {
-          std::fill(ddT_e.begin(), ddT_e.end(), 0.0);
-          
-          for(unsigned int k = 0; k < nz; ++k) {
-            for(unsigned int j = 0; j < ny; ++j) {
-              for(unsigned int i = 0; i < nx; ++i) {                
-                unsigned int q, p;
-                unsigned int r = i + j*nx + k*nx*ny;
-                
-                if(flag[r] == ZERO_DERIVATIVE) continue;
-                
-                // +- dx
-                if(i > 0) p = (i-1) + j*nx + k*nx*ny;
-                else p = (nx-1) + j*nx + k*nx*ny;
-                
-                if(i < (nx - 1)) q = (i+1) + j*nx + k*nx*ny;
-                else q = j*nx + k*nx*ny;
-                
-                if(flag[q] == ZERO_DERIVATIVE) q = r;
-                else if(flag[p] == ZERO_DERIVATIVE) p = r;
-                
-                ddT_e[r] += (kappa_e[q]-kappa_e[p]) * (T_e[q] - T_e[p]) / dx / dx / 4.0;
-                ddT_e[r] += kappa_e[r] * ((T_e[q]+T_e[p]-2.0*T_e[r]) / dx / dx);
-                
-                // +- dy
-                if(j > 0) p = i + (j-1)*nx + k*nx*ny;
-                else p = i + (ny-1)*nx + k*nx*ny;
-                
-                if(j < (ny - 1)) q = i + (j+1)*nx + k*nx*ny;
-                else q = i + k*nx*ny;
-                
-                if(flag[q] == ZERO_DERIVATIVE) q = r;
-                else if(flag[p] == ZERO_DERIVATIVE) p = r;
-                
-                ddT_e[r] += (kappa_e[q]-kappa_e[p]) * (T_e[q] - T_e[p]) / dy / dy / 4.0;
-                ddT_e[r] += kappa_e[r] * ((T_e[q]+T_e[p]-2.0*T_e[r]) / dy / dy);
-                
-                // +- dz
-                if(k > 0) p = i + j*nx + (k-1)*nx*ny;
-                else p = i + j*nx + (nz-1)*nx*ny;
-                
-                if(k < (nz - 1)) q = i + j*nx + (k+1)*nx*ny;
-                else q = i + j*nx;
-                
-                if(flag[q] == ZERO_DERIVATIVE) q = r;
-                else if(flag[p] == ZERO_DERIVATIVE) p = r;
-                
-                ddT_e[r] += (kappa_e[q]-kappa_e[p]) * (T_e[q] - T_e[p]) / dz / dz / 4.0;
-                ddT_e[r] += kappa_e[r] * ((T_e[q]+T_e[p]-2.0*T_e[r]) / dz / dz);
-              }
-            }
-          }
-          
-          /* TODO: there might be an issue with grid volume here */
-          // do the actual step
-          for(int i = 0; i < ntotal; i++) {
-            double prescaler = rho_e[i] * C_e[i];
-            assert(prescaler > 0);
-            
-            switch(flag[i]) {
-              case DYNAMIC:
-                // workaround
-                if(T_dynamic_flag[i] == 1) { // this should do the trick
-                  double E_e = E_e_T(T_e[i]);
-                  E_e += (ddT_e[i] + dT_e[i] + S_e[i]) / rho_e[i] * inner_dt;
-                  T_e[i] = E_e_T.reverse_lookup(E_e);
-                }
-                else {T_e[i] += (ddT_e[i] + dT_e[i] + S_e[i]) / prescaler * inner_dt;} // this works for constant Ce
-                break;
-              default:
-                break;
-            }
-            
-            // energy conservation issues
-            /* Add a sanity check somewhere for this */
-            if(T_e[i] < 0.0)
-            {
-              T_e[i] = 0.0;
-            }
-          }
-        }
+        if(implicit) { solve_implicit(); }
+        else { solve_explicit(); }
       }
+      lap(EPH_Timer::FDM_SOLVE);
       
       sync_after();
+      lap(EPH_Timer::FDM_AFTER);
     }
     
   private:
     static constexpr unsigned int lineLength = 1024;
     
+    // tile size of the threaded stencil loops
+    static constexpr size_t tile_x = 256;
+    static constexpr size_t tile_y = 8;
+    static constexpr size_t tile_z = 8;
+    
+    // allocator that leaves values uninitialised so that the thread which 
+    // first writes a node in allocate() also owns its memory page
+    template<typename T>
+    struct FirstTouchAllocator : std::allocator<T> 
+    {
+      template<typename U> struct rebind { using other = FirstTouchAllocator<U>; };
+      
+      FirstTouchAllocator() = default;
+      template<typename U> FirstTouchAllocator(const FirstTouchAllocator<U>&) {}
+      
+      template<typename U> void construct(U* p) { ::new(static_cast<void*>(p)) U; }
+      template<typename U, typename... Args> 
+      void construct(U* p, Args&&... args) { ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+    };
+    
+    template<typename T>
+    using Vector = std::vector<T, FirstTouchAllocator<T>>;
+    
     size_t nx, ny, nz; // number of nodes in x,y,z
     size_t ntotal; // total number of nodes
     
@@ -412,16 +496,16 @@ class EPH_FDM
     double dx, dy, dz;
     double dV; // volume of the element
     
-    std::vector<double> T_e; // current electronic temperature grid 
-    std::vector<double> dT_e; // source/sink term from atoms 
-    std::vector<double> ddT_e; // grid to store temporary values (almost second derivative)
+    Vector<double> T_e; // current electronic temperature grid 
+    Vector<double> dT_e; // source/sink term from atoms 
+    Vector<double> ddT_e; // grid to store temporary values (almost second derivative)
     
     // temperature dependence will be added later
-    std::vector<double> C_e; // specific heat at each point
-    std::vector<double> rho_e; // electronic density at each point
-    std::vector<double> kappa_e; // electronic heat conduction
+    Vector<double> C_e; // specific heat at each point
+    Vector<double> rho_e; // electronic density at each point
+    Vector<double> kappa_e; // electronic heat conduction
     
-    std::vector<double> S_e; // external sink and source term
+    Vector<double> S_e; // external sink and source term
     
     /*
      * -1 -> uninitialised
@@ -436,14 +520,14 @@ class EPH_FDM
       ZERO_DERIVATIVE = 2
     };
     
-    std::vector<signed short> flag; // node property
+    Vector<signed short> flag; // node property
     
     /*
      * 0 -> no temperature dependent parameters (C_e kappa_e)
      * 1 -> temperature dependent parameters
      */
     // T_dynamic_flag
-    std::vector<unsigned short> T_dynamic_flag; // temperature dependence of properties
+    Vector<unsigned short> T_dynamic_flag; // temperature dependence of properties
     
     // filename for the file where temperature dependent properties are saved
     std::string parameter_filename; // NULL is special value
@@ -455,43 +539,1052 @@ class EPH_FDM
     size_t steps; // number of steps 
     double dt; // value of global timestep
     
+    bool implicit {false}; // use solve_implicit() instead of solve_explicit()
+    Vector<double> LT_e; // explicit operator per direction for solve_implicit()
+    
+    /*
+     * Precomputed explicit stencil (see build_stencil()). The temperature grid 
+     * is padded with ghost layers (t layout) while node arrays such as C_e, 
+     * S_e and the coefficients use the c layout.
+     */
+    struct Stencil 
+    {
+      bool valid {false};
+      bool T_dynamic {false}; // some nodes have temperature dependent parameters
+      
+      size_t n[3]; // number of updated nodes in x,y,z
+      size_t t_first, t_sy, t_sz; // first updated node and strides in the t layout
+      size_t c_first, c_sy, c_sz; // first updated node and strides in the c layout
+      
+      Vector<double> c[6]; // coefficients of the -x,+x,-y,+y,-z,+z neighbours over rho_e C_e
+      Vector<double> scale; // 1/(rho_e C_e) for dynamic nodes with constant parameters
+      
+      struct Node 
+      {
+        size_t c_index, t_index;
+        double c[6]; // coefficients without 1/(rho_e C_e)
+      };
+      std::vector<Node> E_nodes; // dynamic nodes with temperature dependent parameters
+      
+      double c_min, rho_min, kappa_max; // for the stability criterion
+    } stencil;
+    
+    Vector<double> T_pad; // padded temperature grid for solve_explicit()
+    Vector<double> T_next; // padded temperature after a sub-step
+    
     MPI_Comm world; // communicator
     int myID;
     int nrPS;
     
+    // domain decomposition; local arrays are padded with halo ghost layers
+    bool distributed {false};
+    size_t halo; // number of ghost layers on each side
+    size_t sub_lo[3], sub_hi[3]; // owned global cells [sub_lo, sub_hi)
+    size_t l_n[3]; // local grid size including ghost layers
+    size_t l_total; // total number of local nodes
+    int neighbours[3][2]; // ranks of -/+ neighbours in x,y,z
+    double T_total; // cached average temperature of the full grid
+    
+    EPH_Timer* timer {nullptr}; // phases of solve(), owned by the caller
+    EPH_Writer* writer {nullptr}; // background output, owned by the caller
+    bool binary_state {false}; // save_state() format
+    
+    void lap(int phase) 
+    {
+      if(timer) { timer->lap(phase); }
+    }
+    
+    std::vector<char> send_buffer;
+    std::vector<char> recv_buffer;
+    
     void resize_vectors(size_t in_nx, size_t in_ny, size_t in_nz)
     {
       ntotal = in_nx * in_ny * in_nz;
       
-      T_e.resize(ntotal, 0);
-      dT_e.resize(ntotal, 0);
-      ddT_e.resize(ntotal, 0);
+      allocate(T_e, ntotal, 0.);
+      allocate(dT_e, ntotal, 0.);
+      allocate(ddT_e, ntotal, 0.);
       
-      C_e.resize(ntotal, 0);
-      rho_e.resize(ntotal, 0);
-      kappa_e.resize(ntotal, 0);
+      allocate(C_e, ntotal, 0.);
+      allocate(rho_e, ntotal, 0.);
+      allocate(kappa_e, ntotal, 0.);
       
-      S_e.resize(ntotal, 0);
-      flag.resize(ntotal, 1);
-      T_dynamic_flag.resize(ntotal, false);
+      allocate(S_e, ntotal, 0.);
+      allocate(flag, ntotal, static_cast<signed short>(1));
+      allocate(T_dynamic_flag, ntotal, static_cast<unsigned short>(0));
     }
     
-    void sync_before() // this is for MPI sync before solve is called
+    // what the output files need to know about the grid besides the values
+    struct Header 
     {
-      MPI_Allreduce(MPI_IN_PLACE, dT_e.data(), ntotal, MPI_DOUBLE, MPI_SUM, world);
-    }
+      size_t nx, ny, nz;
+      size_t steps;
+      double x0, x1, y0, y1, z0, z1;
+      double dx, dy, dz;
+      std::string parameter_filename;
+    };
     
-    void sync_after() // this is for MPI sync after solve is called
+    // T_e, S_e, rho_e, C_e, kappa_e, flag and T_dynamic_flag of every node
+    static constexpr size_t n_state = 7;
+    
+    Header get_header() const 
     {
-      // zero arrays
-      std::fill(dT_e.begin(), dT_e.end(), 0.0);
-  
-      // synchronize electronic temperature
-      MPI_Bcast(T_e.data(), ntotal, MPI_DOUBLE, 0, world);
+      return Header {nx, ny, nz, steps, x0, x1, y0, y1, z0, z1, dx, dy, dz, parameter_filename};
     }
     
-    // possible source of error if nx*ny*nz does not fit into int
-    size_t get_index(double x, double y, double z) const 
+    // copy the arrays of save_state() one after the other into values
+    void pack_state(double* values) const 
+    {
+      std::copy(T_e.begin(), T_e.end(), values);
+      std::copy(S_e.begin(), S_e.end(), values + ntotal);
+      std::copy(rho_e.begin(), rho_e.end(), values + 2 * ntotal);
+      std::copy(C_e.begin(), C_e.end(), values + 3 * ntotal);
+      std::copy(kappa_e.begin(), kappa_e.end(), values + 4 * ntotal);
+      std::copy(flag.begin(), flag.end(), values + 5 * ntotal);
+      std::copy(T_dynamic_flag.begin(), T_dynamic_flag.end(), values + 6 * ntotal);
+    }
+    
+    static void write_temperature(const char* in_filename, const Header& h, const double* T) 
+    {
+      FILE *fd = fopen(in_filename, "w");
+      
+      assert(fd != nullptr);
+      
+      // this is needed for visit Point3D
+      fprintf(fd, "x y z Te\n");
+      
+      for(int k = 0; k < h.nz; ++k) {
+        for(int j = 0; j < h.ny; ++j) {
+          for(int i = 0; i < h.nx; ++i) {
+            unsigned int index = i + j * h.nx + k * h.nx * h.ny;
+            
+            double x = h.x0 + i * h.dx;
+            double y = h.y0 + j * h.dy;
+            double z = h.z0 + k * h.dz;
+            
+            fprintf(fd, "%.6e %.6e %.6e %.6e\n", x, y, z, T[index]);
+          }
+        }
+      }
+      
+      fclose(fd);
+    }
+    
+    // values as packed by pack_state()
+    static void write_state(const char* in_filename, const Header& h, const double* values) 
+    {
+      const size_t n = h.nx * h.ny * h.nz;
+      
+      FILE *fd = fopen(in_filename, "w");
+      
+      assert(fd != nullptr);
+      
+      // 3 first lines are comments
+      fprintf(fd, "# A comment\n");
+      fprintf(fd, "#\n");
+      fprintf(fd, "#\n");
+      
+      // next line is grid size and min number of steps
+      fprintf(fd, "%ld %ld %ld %ld\n", h.nx, h.ny, h.nz, h.steps);
+      
+      // next we have box size
+      fprintf(fd, "%.6e %.6e\n", h.x0, h.x1);
+      fprintf(fd, "%.6e %.6e\n", h.y0, h.y1);
+      fprintf(fd, "%.6e %.6e\n", h.z0, h.z1);
+      
+      // filename for temperature dependent parameters
+      fprintf(fd, "%s\n", h.parameter_filename.c_str());
+      
+      // finally we have grid values
+      for(int k = 0; k < h.nz; ++k) 
+      {
+        for(int j = 0; j < h.ny; ++j) 
+        {
+          for(int i = 0; i < h.nx; ++i) 
+          {
+            unsigned int index = i + j * h.nx + k * h.nx * h.ny;
+            fprintf(fd, "%d %d %d %.6e %.6e %.6e %.6e %.6e %d %d\n", 
+              i, j, k, values[index], values[index + n], 
+              values[index + 2 * n], values[index + 3 * n], values[index + 4 * n], 
+              static_cast<int>(values[index + 5 * n]), static_cast<int>(values[index + 6 * n]));
+          }
+        }
+      }
+      
+      fclose(fd);
+    }
+    
+    /*
+     * Binary state file (native byte order):
+     *   StateHeader, parameter filename padded to 8 bytes,
+     *   T_e, S_e, rho_e, C_e, kappa_e (double), flag (int16), T_dynamic_flag (uint16)
+     * each array with nx * ny * nz values, x fastest
+     */
+    struct StateHeader 
+    {
+      char magic[8];
+      uint32_t version;
+      uint32_t name_length; // length of the parameter filename
+      uint64_t n[3]; // nx, ny, nz
+      uint64_t steps;
+      double lo[3]; // x0, y0, z0
+      double hi[3]; // x1, y1, z1
+    };
+    
+    static const char* state_magic() { return "EPHFDMS"; }
+    static constexpr uint32_t state_version = 1;
+    
+    static_assert(sizeof(signed short) == 2 && sizeof(unsigned short) == 2, "flags are stored in 16 bits");
+    
+    static size_t state_name_bytes(size_t in_length) { return (in_length + 7) / 8 * 8; }
+    
+    static size_t binary_state_bytes(const StateHeader& h) 
+    {
+      const size_t n = h.n[0] * h.n[1] * h.n[2];
+      return sizeof(StateHeader) + state_name_bytes(h.name_length) 
+        + n * (5 * sizeof(double) + sizeof(signed short) + sizeof(unsigned short));
+    }
+    
+    // values as packed by pack_state()
+    static void write_binary_state(const char* in_filename, const Header& h, const double* values) 
+    {
+      const size_t n = h.nx * h.ny * h.nz;
+      
+      FILE *fd = fopen(in_filename, "wb");
+      
+      assert(fd != nullptr);
+      
+      StateHeader header {};
+      std::memcpy(header.magic, state_magic(), sizeof(header.magic));
+      header.version = state_version;
+      header.name_length = h.parameter_filename.size();
+      header.n[0] = h.nx; header.n[1] = h.ny; header.n[2] = h.nz;
+      header.steps = h.steps;
+      header.lo[0] = h.x0; header.lo[1] = h.y0; header.lo[2] = h.z0;
+      header.hi[0] = h.x1; header.hi[1] = h.y1; header.hi[2] = h.z1;
+      
+      std::vector<char> name(state_name_bytes(header.name_length), '\0');
+      std::copy(h.parameter_filename.begin(), h.parameter_filename.end(), name.begin());
+      
+      fwrite(&header, sizeof(header), 1, fd);
+      fwrite(name.data(), 1, name.size(), fd);
+      
+      // T_e, S_e, rho_e, C_e and kappa_e follow each other in values
+      fwrite(values, sizeof(double), 5 * n, fd);
+      
+      // flags are converted back to their own types in blocks
+      constexpr size_t block = 4096;
+      signed short s_flags[block];
+      unsigned short u_flags[block];
+      
+      for(size_t first = 0; first < n; first += block) 
+      {
+        const size_t count = std::min(block, n - first);
+        for(size_t i = 0; i < count; ++i) { s_flags[i] = static_cast<signed short>(values[5 * n + first + i]); }
+        fwrite(s_flags, sizeof(signed short), count, fd);
+      }
+      
+      for(size_t first = 0; first < n; first += block) 
+      {
+        const size_t count = std::min(block, n - first);
+        for(size_t i = 0; i < count; ++i) { u_flags[i] = static_cast<unsigned short>(values[6 * n + first + i]); }
+        fwrite(u_flags, sizeof(unsigned short), count, fd);
+      }
+      
+      bool ok = !ferror(fd);
+      fclose(fd);
+      
+      assert(ok);
+    }
+    
+    static bool is_binary_state(const char* in_filename) 
+    {
+      char magic[8] {};
+      
+      FILE *fd = fopen(in_filename, "rb");
+      if(fd == nullptr) 
+      {
+        throw std::runtime_error(std::string("EPH_FDM: cannot open ") + in_filename);
+      }
+      
+      size_t bytes = fread(magic, 1, sizeof(magic), fd);
+      fclose(fd);
+      
+      return bytes == sizeof(magic) && std::memcmp(magic, state_magic(), sizeof(magic)) == 0;
+    }
+    
+    // grid, box, steps, parameter filename and node values of a saved state
+    void read_state(const char* in_filename) 
+    {
+      if(is_binary_state(in_filename)) { read_binary_state(in_filename); }
+      else { read_text_state(in_filename); }
+    }
+    
+    void read_text_state(const char* in_filename) 
+    {
+      std::ifstream fd {in_filename}; assert(fd); // break code here
+      
+      // 3 first lines are comments
+      char line[lineLength];
+      fd.getline(line, lineLength); assert(line[0] == '#');
+      fd.getline(line, lineLength); assert(line[0] == '#');
+      fd.getline(line, lineLength); assert(line[0] == '#');
+      
+      // next line defines grid size
+      fd >> nx >> ny >> nz;
+      resize_vectors(nx, ny, nz);
+      
+      fd >> steps;
+      
+      // define box size
+      fd >> x0 >> x1
+         >> y0 >> y1
+         >> z0 >> z1;
+      
+      set_box_dimensions(x0, x1, y0, y1, z0, z1);
+      
+      fd >> parameter_filename;
+      
+      // read grid values
+      for(size_t i = 0; i != ntotal; ++i) {
+        int lx, ly, lz;
+        fd >> lx >> ly >> lz;
+        size_t index = lx + ly * nx + lz * nx * ny;   
+        fd >> T_e[index]
+           >> S_e[index]
+           >> rho_e[index]
+           >> C_e[index]
+           >> kappa_e[index]
+           >> flag[index]
+           >> T_dynamic_flag[index];
+      }
+    }
+    
+    // the file is mapped and the arrays are copied out of it in one go
+    void read_binary_state(const char* in_filename) 
+    {
+      int fd = open(in_filename, O_RDONLY);
+      if(fd < 0) 
+      {
+        throw std::runtime_error(std::string("EPH_FDM: cannot open ") + in_filename);
+      }
+      
+      struct stat info;
+      fstat(fd, &info);
+      const size_t size = info.st_size;
+      
+      void* map = size >= sizeof(StateHeader) ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+      close(fd);
+      
+      if(map == MAP_FAILED) 
+      {
+        throw std::runtime_error(std::string("EPH_FDM: cannot map ") + in_filename);
+      }
+      
+      madvise(map, size, MADV_SEQUENTIAL);
+      const char* data = static_cast<const char*>(map);
+      
+      StateHeader header;
+      std::memcpy(&header, data, sizeof(header));
+      
+      const char* error = nullptr;
+      if(header.version != state_version) { error = "EPH_FDM: unsupported binary state version in "; }
+      else if(binary_state_bytes(header) != size) { error = "EPH_FDM: wrong size of binary state "; }
+      
+      if(error != nullptr) 
+      {
+        munmap(map, size);
+        throw std::runtime_error(std::string(error) + in_filename);
+      }
+      
+      nx = header.n[0]; ny = header.n[1]; nz = header.n[2];
+      resize_vectors(nx, ny, nz);
+      
+      steps = header.steps;
+      set_box_dimensions(header.lo[0], header.hi[0], header.lo[1], header.hi[1], header.lo[2], header.hi[2]);
+      
+      data += sizeof(header);
+      parameter_filename.assign(data, header.name_length);
+      data += state_name_bytes(header.name_length);
+      
+      for(Vector<double>* v : {&T_e, &S_e, &rho_e, &C_e, &kappa_e}) 
+      {
+        std::memcpy(v->data(), data, ntotal * sizeof(double));
+        data += ntotal * sizeof(double);
+      }
+      
+      std::memcpy(flag.data(), data, ntotal * sizeof(signed short));
+      data += ntotal * sizeof(signed short);
+      std::memcpy(T_dynamic_flag.data(), data, ntotal * sizeof(unsigned short));
+      
+      munmap(map, size);
+    }
+    
+    // dT followed by the C_e(T) and kappa_e(T) columns of the parameter file, empty for NULL
+    std::vector<double> read_parameters() const 
+    {
+      std::vector<double> table;
+      if(parameter_filename == "NULL") { return table; }
+      
+      std::ifstream fd {parameter_filename}; assert(fd);
+      
+      // 3 first lines are comments
+      char line[lineLength];
+      fd.getline(line, lineLength); assert(line[0] == '#');
+      fd.getline(line, lineLength); assert(line[0] == '#');
+      fd.getline(line, lineLength); assert(line[0] == '#');
+      
+      size_t n; fd >> n;
+      table.resize(1 + 2 * n);
+      fd >> table[0];
+      
+      for(size_t i = 0; i < n; ++i)
+      {
+        fd >> table[1 + i] >> table[1 + n + i]; // read data from file
+      }
+      
+      return table;
+    }
+    
+    // load temperature dependent parameters 
+    void set_parameters(const std::vector<double>& table) 
+    {
+      if(table.empty()) { return; }
+      
+      const size_t n = (table.size() - 1) / 2;
+      const double dT = table[0];
+      
+      Container<double> in_C_e_T(n);
+      Container<double> in_kappa_e_T(n);
+      std::copy(table.begin() + 1, table.begin() + 1 + n, in_C_e_T.begin());
+      std::copy(table.begin() + 1 + n, table.end(), in_kappa_e_T.begin());
+      
+      C_e_T = Spline(dT, in_C_e_T);
+      kappa_e_T = Spline(dT, in_kappa_e_T);
+      
+      // create Ee(Te) mapping
+      in_C_e_T[0] = 0.;
+      for(size_t i = 1; i < in_C_e_T.size(); ++i) {
+        in_C_e_T[i] = in_C_e_T[i - 1] + in_C_e_T[i] * dT;
+      }
+      E_e_T = EPH_Linear(dT, in_C_e_T.begin(), in_C_e_T.end());
+    }
+    
+    // MPI_Bcast takes an int count
+    template<typename T>
+    static void broadcast(T* data, size_t n, MPI_Datatype type, MPI_Comm comm) 
+    {
+      constexpr size_t chunk = 1 << 30;
+      
+      for(size_t first = 0; first < n; first += chunk) 
+      {
+        MPI_Bcast(data + first, static_cast<int>(std::min(chunk, n - first)), type, 0, comm);
+      }
+    }
+    
+    // send what task 0 has read to the other tasks of in_comm
+    void broadcast_state(MPI_Comm in_comm, int in_rank, std::vector<double>& table) 
+    {
+      uint64_t sizes[6] {nx, ny, nz, steps, parameter_filename.size(), table.size()};
+      double box[6] {x0, x1, y0, y1, z0, z1};
+      
+      MPI_Bcast(sizes, 6, MPI_UINT64_T, 0, in_comm);
+      MPI_Bcast(box, 6, MPI_DOUBLE, 0, in_comm);
+      
+      if(in_rank != 0) 
+      {
+        nx = sizes[0]; ny = sizes[1]; nz = sizes[2];
+        resize_vectors(nx, ny, nz);
+        
+        steps = sizes[3];
+        set_box_dimensions(box[0], box[1], box[2], box[3], box[4], box[5]);
+        
+        parameter_filename.resize(sizes[4]);
+        table.resize(sizes[5]);
+      }
+      
+      broadcast(&parameter_filename[0], parameter_filename.size(), MPI_CHAR, in_comm);
+      broadcast(table.data(), table.size(), MPI_DOUBLE, in_comm);
+      
+      for(Vector<double>* v : {&T_e, &S_e, &rho_e, &C_e, &kappa_e}) 
+      {
+        broadcast(v->data(), ntotal, MPI_DOUBLE, in_comm);
+      }
+      
+      broadcast(flag.data(), ntotal, MPI_SHORT, in_comm);
+      broadcast(T_dynamic_flag.data(), ntotal, MPI_UNSIGNED_SHORT, in_comm);
+    }
+    
+    template<typename T, typename A>
+    static size_t vector_bytes(const std::vector<T, A>& v) 
+    {
+      return v.capacity() * sizeof(T);
+    }
+    
+    // allocate a grid array and initialise it in parallel (first touch)
+    template<typename T>
+    static void allocate(Vector<T>& v, size_t n, T value) 
+    {
+      Vector<T>(n).swap(v);
+      
+      EPH_PRAGMA_OMP(omp parallel for schedule(static))
+      for(size_t i = 0; i < n; ++i) { v[i] = value; }
+    }
+    
+    void sync_before() // this is for MPI sync before solve is called
+    {
+      MPI_Allreduce(MPI_IN_PLACE, dT_e.data(), ntotal, MPI_DOUBLE, MPI_SUM, world);
+    }
+    
+    void sync_after() // this is for MPI sync after solve is called
+    {
+      // zero arrays
+      std::fill(dT_e.begin(), dT_e.end(), 0.0);
+  
+      // synchronize electronic temperature
+      MPI_Bcast(T_e.data(), ntotal, MPI_DOUBLE, 0, world);
+    }
+    
+    // refresh temperature dependent parameters; work is shared if called in a parallel region
+    void update_parameters(size_t in_n) 
+    {
+      EPH_PRAGMA_OMP(omp for schedule(static))
+      for(size_t i = 0; i < in_n; ++i)
+      {
+        if(T_dynamic_flag[i])
+        {
+          C_e[i] = C_e_T(T_e[i]);
+          kappa_e[i] = kappa_e_T(T_e[i]);
+        }
+      }
+    }
+    
+    // this is strongly inspired by fix_ttm
+    void solve_explicit()
+    {
+      double inner_dt = dt / steps;
+      
+      double dtdxdydz = inner_dt * (1.0/dx/dx + 1.0/dy/dy + 1.0/dz/dz);
+      
+      const size_t pn[3] {nx + 2, ny + 2, nz + 2};
+      
+      // coefficients change only with temperature dependent parameters
+      if(!stencil.valid || stencil.T_dynamic)
+      {
+        // update temperature dependent parameters
+        EPH_PRAGMA_OMP(omp parallel)
+        update_parameters(ntotal);
+        
+        stencil.n[0] = nx; stencil.n[1] = ny; stencil.n[2] = nz;
+        stencil.t_sy = pn[0];
+        stencil.t_sz = pn[0] * pn[1];
+        stencil.t_first = 1 + stencil.t_sy + stencil.t_sz;
+        stencil.c_sy = nx;
+        stencil.c_sz = nx * ny;
+        stencil.c_first = 0;
+        
+        Vector<double> kappa_pad;
+        Vector<signed short> flag_pad;
+        
+        EPH_PRAGMA_OMP(omp parallel)
+        {
+          pad_grid(kappa_e, kappa_pad);
+          pad_grid(flag, flag_pad);
+        }
+        
+        build_stencil(flag_pad.data(), kappa_pad.data(), true);
+      }
+      
+      double r = dtdxdydz / stencil.c_min / stencil.rho_min * stencil.kappa_max;
+      
+      unsigned int new_steps = steps;
+      
+      // This will become unstable if there are any large fluctuations
+      // during the solving process
+      if(r > 0.4)
+      {
+        inner_dt = 0.4 * inner_dt / r; // get new stable timestep
+        new_steps = std::max(static_cast<unsigned int> (std::ceil(dt / inner_dt)), 1u);
+        inner_dt = dt / new_steps;
+      }
+      
+      if(new_steps > 1 && T_next.size() != pn[0] * pn[1] * pn[2]) 
+      {
+        allocate(T_next, pn[0] * pn[1] * pn[2], 0.);
+      }
+      
+      EPH_PRAGMA_OMP(omp parallel)
+      {
+        pad_grid(T_e, T_pad);
+        
+        // the last sub-step writes into T_e directly
+        for(unsigned int n = 1; n < new_steps; ++n)
+        {
+          stencil_step(T_pad.data(), T_next.data(), true, inner_dt);
+          
+          EPH_PRAGMA_OMP(omp single)
+          T_pad.swap(T_next);
+          
+          fill_periodic_ghosts(T_pad);
+        }
+        
+        stencil_step(T_pad.data(), T_e.data(), false, inner_dt);
+      }
+    }
+    
+    /*
+     * Coefficients of the -x,+x,-y,+y,-z,+z neighbours of the dynamic node ti 
+     * such that sum c (T_n - T_ti) equals the stencil of the original solver 
+     * ((kappa_q - kappa_p)(T_q - T_p)/4 + kappa (T_q + T_p - 2 T)) / h^2. 
+     * A zero derivative neighbour is replaced by the node itself.
+     */
+    void get_stencil_coefficients(const signed short* in_flag, const double* in_kappa, 
+      size_t ti, double* out_c) const 
+    {
+      const size_t t_stride[3] {1, stencil.t_sy, stencil.t_sz};
+      const double h2[3] {dx * dx, dy * dy, dz * dz};
+      
+      for(int d = 0; d < 3; ++d)
+      {
+        const size_t p = ti - t_stride[d];
+        const size_t q = ti + t_stride[d];
+        const bool q_zd = in_flag[q] == ZERO_DERIVATIVE;
+        const bool p_zd = !q_zd && in_flag[p] == ZERO_DERIVATIVE;
+        
+        const double kappa_p = p_zd ? in_kappa[ti] : in_kappa[p];
+        const double kappa_q = q_zd ? in_kappa[ti] : in_kappa[q];
+        const double g = (kappa_q - kappa_p) / 4.0;
+        
+        out_c[2 * d] = p_zd ? 0.0 : (in_kappa[ti] - g) / h2[d];
+        out_c[2 * d + 1] = q_zd ? 0.0 : (in_kappa[ti] + g) / h2[d];
+      }
+    }
+    
+    /*
+     * Precompute the explicit stencil for the nodes described by the layout in
+     * stencil. in_flag and in_kappa use the layout of the padded temperature
+     * grid. The coefficients include kappa_e, the zero derivative neighbours, 
+     * 1/h^2 and 1/(rho_e C_e) so that stencil_step() has no branches. The 
+     * first node is always included in the stability extrema if in_first is 
+     * set (as in fix_ttm).
+     */
+    void build_stencil(const signed short* in_flag, const double* in_kappa, bool in_first)
+    {
+      const size_t* n = stencil.n;
+      const size_t c_total = stencil.c_first + (n[0] - 1) + (n[1] - 1) * stencil.c_sy + (n[2] - 1) * stencil.c_sz + 1;
+      for(int i = 0; i < 6; ++i)
+      {
+        if(stencil.c[i].size() != c_total) { allocate(stencil.c[i], c_total, 0.); }
+      }
+      if(stencil.scale.size() != c_total) { allocate(stencil.scale, c_total, 0.); }
+      
+      const double inf = std::numeric_limits<double>::infinity();
+      double c_min = inf, rho_min = inf, kappa_max = -inf;
+      bool T_dynamic = false;
+      
+      EPH_PRAGMA_OMP(omp parallel for collapse(2) schedule(static) reduction(min:c_min, rho_min) reduction(max:kappa_max) reduction(||:T_dynamic))
+      for(size_t k = 0; k < n[2]; ++k) {
+        for(size_t j = 0; j < n[1]; ++j) {
+          for(size_t i = 0; i < n[0]; ++i) {
+            const size_t ci = stencil.c_first + i + j * stencil.c_sy + k * stencil.c_sz;
+            const size_t ti = stencil.t_first + i + j * stencil.t_sy + k * stencil.t_sz;
+            
+            if(in_flag[ti] != CONSTANT_VALUE || (in_first && i == 0 && j == 0 && k == 0))
+            {
+              c_min = std::min(c_min, C_e[ci]);
+              rho_min = std::min(rho_min, rho_e[ci]);
+              kappa_max = std::max(kappa_max, in_kappa[ti]);
+            }
+            
+            if(T_dynamic_flag[ci]) { T_dynamic = true; }
+            
+            const bool linear = in_flag[ti] == DYNAMIC && !T_dynamic_flag[ci];
+            if(linear) { assert(rho_e[ci] * C_e[ci] > 0); }
+            const double scale = linear ? 1.0 / (rho_e[ci] * C_e[ci]) : 0.0;
+            stencil.scale[ci] = scale;
+            
+            double c[6] {};
+            if(in_flag[ti] == DYNAMIC) { get_stencil_coefficients(in_flag, in_kappa, ti, c); }
+            for(int d = 0; d < 6; ++d) { stencil.c[d][ci] = c[d] * scale; }
+          }
+        }
+      }
+      
+      // nodes that are updated through E_e_T keep unscaled coefficients
+      stencil.E_nodes.clear();
+      for(size_t k = 0; k < n[2]; ++k) {
+        for(size_t j = 0; j < n[1]; ++j) {
+          for(size_t i = 0; i < n[0]; ++i) {
+            const size_t ci = stencil.c_first + i + j * stencil.c_sy + k * stencil.c_sz;
+            const size_t ti = stencil.t_first + i + j * stencil.t_sy + k * stencil.t_sz;
+            if(in_flag[ti] != DYNAMIC || !T_dynamic_flag[ci]) continue;
+            
+            Stencil::Node node {ci, ti, {}};
+            get_stencil_coefficients(in_flag, in_kappa, ti, node.c);
+            stencil.E_nodes.push_back(node);
+          }
+        }
+      }
+      
+      stencil.c_min = c_min;
+      stencil.rho_min = rho_min;
+      stencil.kappa_max = kappa_max;
+      stencil.T_dynamic = T_dynamic;
+      stencil.valid = true;
+    }
+    
+    /*
+     * One explicit sub-step from the padded temperature grid in_T into out_T 
+     * which uses the t layout if out_padded is set and the c layout otherwise. 
+     * Ghost layers of in_T have to be up to date. Work is shared if called in 
+     * a parallel region.
+     */
+    void stencil_step(const double* in_T, double* out_T, bool out_padded, double inner_dt)
+    {
+      const size_t t_sy = stencil.t_sy;
+      const size_t t_sz = stencil.t_sz;
+      
+      for_stencil_rows([&](size_t ci, size_t ti, size_t i0, size_t i1) {
+        const double* __restrict T = in_T + ti;
+        const double* __restrict c_xm = &stencil.c[0][ci];
+        const double* __restrict c_xp = &stencil.c[1][ci];
+        const double* __restrict c_ym = &stencil.c[2][ci];
+        const double* __restrict c_yp = &stencil.c[3][ci];
+        const double* __restrict c_zm = &stencil.c[4][ci];
+        const double* __restrict c_zp = &stencil.c[5][ci];
+        const double* __restrict dT = &dT_e[ci];
+        const double* __restrict S = &S_e[ci];
+        const double* __restrict scale = &stencil.scale[ci];
+        double* __restrict T_new = out_T + (out_padded ? ti : ci);
+        
+        /* TODO: there might be an issue with grid volume here */
+        // non-dynamic nodes have zero coefficients and scale
+        EPH_PRAGMA_OMP(omp simd)
+        for(size_t i = i0; i < i1; ++i) {
+          const double T_r = T[i];
+          const double ddT =
+            c_xm[i] * (T[i - 1] - T_r) + c_xp[i] * (T[i + 1] - T_r) +
+            c_ym[i] * (T[i - t_sy] - T_r) + c_yp[i] * (T[i + t_sy] - T_r) +
+            c_zm[i] * (T[i - t_sz] - T_r) + c_zp[i] * (T[i + t_sz] - T_r);
+          
+          // energy conservation issues
+          const double T_n = T_r + (ddT + (dT[i] + S[i]) * scale[i]) * inner_dt;
+          T_new[i] = T_n < 0.0 ? 0.0 : T_n;
+        }
+      });
+      
+      // temperature dependent parameters go through E_e(T)
+      EPH_PRAGMA_OMP(omp for schedule(static))
+      for(size_t i = 0; i < stencil.E_nodes.size(); ++i) {
+        const Stencil::Node& node = stencil.E_nodes[i];
+        const size_t ci = node.c_index;
+        const double* T = in_T + node.t_index;
+        
+        const double T_r = T[0];
+        const double ddT =
+          node.c[0] * (T[-1] - T_r) + node.c[1] * (T[1] - T_r) +
+          node.c[2] * (T[-(long) t_sy] - T_r) + node.c[3] * (T[t_sy] - T_r) +
+          node.c[4] * (T[-(long) t_sz] - T_r) + node.c[5] * (T[t_sz] - T_r);
+        
+        double E_e = E_e_T(T_r);
+        E_e += (ddT + dT_e[ci] + S_e[ci]) / rho_e[ci] * inner_dt;
+        out_T[out_padded ? node.t_index : ci] = std::max(E_e_T.reverse_lookup(E_e), 0.0);
+      }
+    }
+    
+    // call f(ci, ti, i0, i1) for the row segments of the stencil tiles (shared in a parallel region)
+    template<typename F>
+    void for_stencil_rows(F f) const
+    {
+      const size_t* n = stencil.n;
+      const size_t tiles[3] {
+        (n[0] + tile_x - 1) / tile_x,
+        (n[1] + tile_y - 1) / tile_y,
+        (n[2] + tile_z - 1) / tile_z};
+      const size_t n_tiles = tiles[0] * tiles[1] * tiles[2];
+      
+      EPH_PRAGMA_OMP(omp for schedule(static))
+      for(size_t t = 0; t < n_tiles; ++t) {
+        const size_t i0 = (t % tiles[0]) * tile_x;
+        const size_t j0 = ((t / tiles[0]) % tiles[1]) * tile_y;
+        const size_t k0 = (t / tiles[0] / tiles[1]) * tile_z;
+        const size_t i1 = std::min(i0 + tile_x, n[0]);
+        const size_t j1 = std::min(j0 + tile_y, n[1]);
+        const size_t k1 = std::min(k0 + tile_z, n[2]);
+        
+        for(size_t k = k0; k < k1; ++k) {
+          for(size_t j = j0; j < j1; ++j) {
+            f(stencil.c_first + j * stencil.c_sy + k * stencil.c_sz,
+              stencil.t_first + j * stencil.t_sy + k * stencil.t_sz, i0, i1);
+          }
+        }
+      }
+    }
+    
+    // copy a grid into a grid padded with one periodic ghost layer (in a parallel region)
+    template<typename T>
+    void pad_grid(const Vector<T>& in, Vector<T>& out) const
+    {
+      const size_t pn[3] {nx + 2, ny + 2, nz + 2};
+      
+      EPH_PRAGMA_OMP(omp single)
+      {
+        if(out.size() != pn[0] * pn[1] * pn[2]) { Vector<T>(pn[0] * pn[1] * pn[2]).swap(out); }
+      }
+      
+      EPH_PRAGMA_OMP(omp for collapse(2) schedule(static))
+      for(size_t k = 0; k < nz; ++k) {
+        for(size_t j = 0; j < ny; ++j) {
+          const T* row = &in[j * nx + k * nx * ny];
+          std::copy(row, row + nx, &out[1 + (j + 1) * pn[0] + (k + 1) * pn[0] * pn[1]]);
+        }
+      }
+      
+      fill_periodic_ghosts(out);
+    }
+    
+    // update the ghost layers of a padded grid (in a parallel region)
+    template<typename T>
+    void fill_periodic_ghosts(Vector<T>& v) const
+    {
+      const size_t pn[3] {nx + 2, ny + 2, nz + 2};
+      const size_t stride[3] {1, pn[0], pn[0] * pn[1]};
+      
+      for(int d = 0; d < 3; ++d)
+      {
+        const int d1 = (d + 1) % 3;
+        const int d2 = (d + 2) % 3;
+        
+        EPH_PRAGMA_OMP(omp for schedule(static))
+        for(size_t b = 0; b < pn[d2]; ++b) {
+          for(size_t a = 0; a < pn[d1]; ++a) {
+            const size_t base = a * stride[d1] + b * stride[d2];
+            v[base] = v[base + (pn[d] - 2) * stride[d]];
+            v[base + (pn[d] - 1) * stride[d]] = v[base + stride[d]];
+          }
+        }
+      }
+    }
+    
+    /*
+     * Douglas ADI scheme (Crank-Nicolson in every direction), which is
+     * unconditionally stable and uses the same spatial discretisation as
+     * solve_explicit(). C_e and kappa_e are lagged at the beginning of every
+     * step. Nodes with temperature dependent parameters convert the change in
+     * temperature into energy and go through E_e_T as in the explicit solver.
+     */
+    void solve_implicit()
+    {
+      double inner_dt = dt / steps;
+      
+      const size_t n[3] {nx, ny, nz};
+      const size_t stride[3] {1, nx, nx * ny};
+      const double h[3] {dx, dy, dz};
+      
+      if(LT_e.size() != 3 * ntotal) { allocate(LT_e, 3 * ntotal, 0.); }
+      
+      EPH_PRAGMA_OMP(omp parallel)
+      {
+        // line buffers of this thread
+        size_t max_n = std::max(nx, std::max(ny, nz));
+        std::vector<double> a(max_n), b(max_n), c(max_n), d(max_n);
+        std::vector<double> work(3 * max_n);
+        
+        for(size_t s = 0; s < steps; ++s)
+        {
+          update_parameters(ntotal);
+          
+          // L_d T in every direction with the current temperature
+          for(int dim = 0; dim < 3; ++dim)
+          {
+            double* LT = &LT_e[dim * ntotal];
+            if(n[dim] == 1) continue; // no gradient along this direction; LT stays 0
+            
+            for_each_line(dim, [&](size_t base) {
+              for(size_t m = 0; m < n[dim]; ++m)
+              {
+                size_t r = base + m * stride[dim];
+                size_t p = base + ((m + n[dim] - 1) % n[dim]) * stride[dim];
+                size_t q = base + ((m + 1) % n[dim]) * stride[dim];
+                
+                double cp, cr, cq;
+                get_line_coefficients(r, p, q, h[dim], cp, cr, cq);
+                LT[r] = cp * T_e[p] + cr * T_e[r] + cq * T_e[q];
+              }
+            });
+          }
+          
+          // explicit part of the first stage
+          EPH_PRAGMA_OMP(omp for schedule(static))
+          for(size_t i = 0; i < ntotal; ++i)
+          {
+            ddT_e[i] = T_e[i];
+            if(flag[i] != DYNAMIC) continue;
+            
+            double source = (dT_e[i] + S_e[i]) / (rho_e[i] * C_e[i]);
+            ddT_e[i] += inner_dt * (0.5 * LT_e[i] + LT_e[ntotal + i] + LT_e[2 * ntotal + i] + source);
+          }
+          
+          // implicit line solves; ddT_e holds the intermediate solutions
+          for(int dim = 0; dim < 3; ++dim)
+          {
+            if(n[dim] == 1) continue;
+            const double* LT = &LT_e[dim * ntotal];
+            
+            for_each_line(dim, [&](size_t base) {
+              for(size_t m = 0; m < n[dim]; ++m)
+              {
+                size_t r = base + m * stride[dim];
+                size_t p = base + ((m + n[dim] - 1) % n[dim]) * stride[dim];
+                size_t q = base + ((m + 1) % n[dim]) * stride[dim];
+                
+                double cp, cr, cq;
+                get_line_coefficients(r, p, q, h[dim], cp, cr, cq);
+                a[m] = -0.5 * inner_dt * cp;
+                b[m] = 1.0 - 0.5 * inner_dt * cr;
+                c[m] = -0.5 * inner_dt * cq;
+                d[m] = ddT_e[r];
+                if(dim > 0) { d[m] -= 0.5 * inner_dt * LT[r]; }
+              }
+              
+              solve_cyclic(n[dim], a.data(), b.data(), c.data(), d.data(), work.data());
+              
+              for(size_t m = 0; m < n[dim]; ++m) { ddT_e[base + m * stride[dim]] = d[m]; }
+            });
+          }
+          
+          EPH_PRAGMA_OMP(omp for schedule(static))
+          for(size_t i = 0; i < ntotal; ++i)
+          {
+            if(flag[i] == DYNAMIC)
+            {
+              if(T_dynamic_flag[i] == 1)
+              {
+                double E_e = E_e_T(T_e[i]) + C_e[i] * (ddT_e[i] - T_e[i]);
+                T_e[i] = E_e_T.reverse_lookup(E_e);
+              }
+              else { T_e[i] = ddT_e[i]; }
+            }
+            
+            if(T_e[i] < 0.0)
+            {
+              T_e[i] = 0.0;
+            }
+          }
+        }
+      }
+    }
+    
+    // call f(base) for the first node of every grid line along in_d; 
+    // lines are shared if called in a parallel region
+    template<typename F>
+    void for_each_line(int in_d, F f) const
+    {
+      size_t hi[3] {nx, ny, nz};
+      hi[in_d] = 1;
+      
+      EPH_PRAGMA_OMP(omp for collapse(3) schedule(static))
+      for(size_t k = 0; k < hi[2]; ++k) {
+        for(size_t j = 0; j < hi[1]; ++j) {
+          for(size_t i = 0; i < hi[0]; ++i) {
+            f(i + j * nx + k * nx * ny);
+          }
+        }
+      }
+    }
+    
+    /*
+     * Stencil of solve_explicit() along one direction written as
+     * cp T[p] + cr T[r] + cq T[q] and divided by rho_e C_e. Zero derivative
+     * neighbours are folded into cr. Only dynamic nodes have a stencil.
+     */
+    void get_line_coefficients(size_t r, size_t p, size_t q, double h,
+      double& cp, double& cr, double& cq) const
+    {
+      cp = cr = cq = 0.0;
+      if(flag[r] != DYNAMIC) return;
+      
+      bool q_zd = flag[q] == ZERO_DERIVATIVE;
+      bool p_zd = !q_zd && flag[p] == ZERO_DERIVATIVE;
+      
+      double kappa_p = p_zd ? kappa_e[r] : kappa_e[p];
+      double kappa_q = q_zd ? kappa_e[r] : kappa_e[q];
+      double g = (kappa_q - kappa_p) / 4.0;
+      double prescaler = rho_e[r] * C_e[r] * h * h;
+      assert(prescaler > 0);
+      
+      cp = (kappa_e[r] - g) / prescaler;
+      cq = (kappa_e[r] + g) / prescaler;
+      cr = -2.0 * kappa_e[r] / prescaler;
+      
+      if(p_zd) { cr += cp; cp = 0.0; }
+      if(q_zd) { cr += cq; cq = 0.0; }
+    }
+    
+    /*
+     * Solve a[i] x[i-1] + b[i] x[i] + c[i] x[i+1] = d[i] with periodic
+     * boundaries (Sherman-Morrison); the solution is returned in d.
+     */
+    static void solve_cyclic(size_t n, const double* a, const double* b, const double* c,
+      double* d, double* work)
+    {
+      if(n == 1)
+      {
+        d[0] /= a[0] + b[0] + c[0];
+        return;
+      }
+      
+      if(n == 2)
+      {
+        double m01 = a[0] + c[0];
+        double m10 = a[1] + c[1];
+        double det = b[0] * b[1] - m01 * m10;
+        double x0 = (d[0] * b[1] - m01 * d[1]) / det;
+        double x1 = (b[0] * d[1] - m10 * d[0]) / det;
+        d[0] = x0; d[1] = x1;
+        return;
+      }
+      
+      double* z = work; // correction vector
+      double* cc = work + n; // modified upper diagonal
+      double* bb = work + 2 * n; // modified diagonal
+      
+      double gamma = -b[0];
+      double alpha = c[n - 1]; // coefficient of x[0] in the last row
+      double beta = a[0]; // coefficient of x[n-1] in the first row
+      
+      std::copy(b, b + n, bb);
+      bb[0] -= gamma;
+      bb[n - 1] -= alpha * beta / gamma;
+      
+      std::fill(z, z + n, 0.0);
+      z[0] = gamma;
+      z[n - 1] = alpha;
+      
+      // Thomas algorithm for both right hand sides
+      cc[0] = c[0] / bb[0];
+      d[0] /= bb[0];
+      z[0] /= bb[0];
+      for(size_t i = 1; i < n; ++i)
+      {
+        double m = bb[i] - a[i] * cc[i - 1];
+        cc[i] = c[i] / m;
+        d[i] = (d[i] - a[i] * d[i - 1]) / m;
+        z[i] = (z[i] - a[i] * z[i - 1]) / m;
+      }
+      
+      for(size_t i = n - 1; i-- > 0;)
+      {
+        d[i] -= cc[i] * d[i + 1];
+        z[i] -= cc[i] * z[i + 1];
+      }
+      
+      double fact = (d[0] + beta * d[n - 1] / gamma) / (1.0 + z[0] + beta * z[n - 1] / gamma);
+      for(size_t i = 0; i < n; ++i) { d[i] -= fact * z[i]; }
+    }
+    
+    // possible source of error if nx*ny*nz does not fit into int
+    size_t get_index(double x, double y, double z) const 
     {
       int lx = std::floor((x-x0) / dx);
       int px = std::floor( ((double) lx) / nx);
@@ -508,6 +1601,316 @@ class EPH_FDM
       return lx + ly*nx + lz*nx*ny;
     }
     
+    size_t get_node_index(size_t in_i, size_t in_j, size_t in_k) const 
+    {
+      assert(!distributed);
+      assert(in_i < nx && in_j < ny && in_k < nz);
+      
+      return in_i + in_j * nx + in_k * nx * ny;
+    }
+    
+    // index into the padded local grid; positions may fall into ghost layers
+    size_t get_local_index(double x, double y, double z) const 
+    {
+      const double r[3] {x - x0, y - y0, z - z0};
+      const double d[3] {dx, dy, dz};
+      const long n[3] {(long) nx, (long) ny, (long) nz};
+      
+      size_t index = 0;
+      size_t stride = 1;
+      for(int i = 0; i < 3; ++i) 
+      {
+        long g = std::floor(r[i] / d[i]);
+        g = ((g % n[i]) + n[i]) % n[i];
+        
+        long l = g - (long) sub_lo[i] + (long) halo;
+        if(l < 0) { l += n[i]; }
+        else if(l >= (long) l_n[i]) { l -= n[i]; }
+        
+        if(l < 0 || l >= (long) l_n[i]) 
+        {
+          throw std::out_of_range("EPH_FDM: position outside of the local grid");
+        }
+        
+        index += l * stride;
+        stride *= l_n[i];
+      }
+      
+      return index;
+    }
+    
+    // call f(index) for every node with halo layers [in_a, in_a + halo) in dimension in_d
+    template<typename F>
+    void for_layers(int in_d, size_t in_a, F f) const 
+    {
+      size_t lo[3] {0, 0, 0};
+      size_t hi[3] {l_n[0], l_n[1], l_n[2]};
+      lo[in_d] = in_a; 
+      hi[in_d] = in_a + halo;
+      
+      for(size_t k = lo[2]; k < hi[2]; ++k) {
+        for(size_t j = lo[1]; j < hi[1]; ++j) {
+          for(size_t i = lo[0]; i < hi[0]; ++i) {
+            f(i + j * l_n[0] + k * l_n[0] * l_n[1]);
+          }
+        }
+      }
+    }
+    
+    // send layers starting at in_send to in_to and receive layers at in_recv from in_from
+    template<typename T, bool add>
+    void transfer_layers(Vector<T>& v, int in_d, 
+      size_t in_send, int in_to, size_t in_recv, int in_from)
+    {
+      size_t n = halo;
+      for(int i = 0; i < 3; ++i) { if(i != in_d) { n *= l_n[i]; } }
+      
+      send_buffer.resize(n * sizeof(T));
+      recv_buffer.resize(n * sizeof(T));
+      
+      T* send = reinterpret_cast<T*>(send_buffer.data());
+      for_layers(in_d, in_send, [&](size_t i) { *send++ = v[i]; });
+      
+      MPI_Sendrecv(
+        send_buffer.data(), send_buffer.size(), MPI_BYTE, in_to, 0,
+        recv_buffer.data(), recv_buffer.size(), MPI_BYTE, in_from, 0,
+        world, MPI_STATUS_IGNORE);
+      
+      const T* recv = reinterpret_cast<const T*>(recv_buffer.data());
+      if(add) { for_layers(in_d, in_recv, [&](size_t i) { v[i] += *recv++; }); }
+      else { for_layers(in_d, in_recv, [&](size_t i) { v[i] = *recv++; }); }
+    }
+    
+    // copy owned boundary layers into the ghost layers of the neighbours
+    template<typename T>
+    void exchange_halo(Vector<T>& v) 
+    {
+      for(int d = 0; d < 3; ++d) 
+      {
+        size_t own = l_n[d] - 2 * halo;
+        transfer_layers<T, false>(v, d, own, neighbours[d][1], 0, neighbours[d][0]);
+        transfer_layers<T, false>(v, d, halo, neighbours[d][0], own + halo, neighbours[d][1]);
+      }
+    }
+    
+    // add ghost layer contributions to the owners (reverse of exchange_halo)
+    void reverse_halo_sum(Vector<double>& v) 
+    {
+      for(int d = 2; d >= 0; --d) 
+      {
+        size_t own = l_n[d] - 2 * halo;
+        transfer_layers<double, true>(v, d, 0, neighbours[d][0], own, neighbours[d][1]);
+        transfer_layers<double, true>(v, d, own + halo, neighbours[d][1], halo, neighbours[d][0]);
+      }
+    }
+    
+    template<typename T>
+    static void slice_vector(Vector<T>& v, const std::vector<size_t>& map) 
+    {
+      Vector<T> result(map.size());
+      
+      EPH_PRAGMA_OMP(omp parallel for schedule(static))
+      for(size_t i = 0; i < map.size(); ++i) { result[i] = v[map[i]]; }
+      v.swap(result);
+    }
+    
+    // collect owned blocks of a local array into a full grid on rank 0 or on all ranks
+    template<typename T>
+    void gather_vector(const Vector<T>& in_local, Vector<T>& out_full, bool all = false) const 
+    {
+      std::vector<long> ranges(6 * nrPS);
+      long range[6] {
+        (long) sub_lo[0], (long) sub_hi[0], 
+        (long) sub_lo[1], (long) sub_hi[1], 
+        (long) sub_lo[2], (long) sub_hi[2]};
+      MPI_Allgather(range, 6, MPI_LONG, ranges.data(), 6, MPI_LONG, world);
+      
+      std::vector<T> block;
+      block.reserve((sub_hi[0] - sub_lo[0]) * (sub_hi[1] - sub_lo[1]) * (sub_hi[2] - sub_lo[2]));
+      for(size_t k = halo; k < l_n[2] - halo; ++k) {
+        for(size_t j = halo; j < l_n[1] - halo; ++j) {
+          for(size_t i = halo; i < l_n[0] - halo; ++i) {
+            block.push_back(in_local[i + j * l_n[0] + k * l_n[0] * l_n[1]]);
+          }
+        }
+      }
+      
+      std::vector<size_t> offsets(nrPS + 1, 0);
+      for(int p = 0; p < nrPS; ++p) 
+      {
+        const long* r = &ranges[6 * p];
+        offsets[p + 1] = offsets[p] + (r[1] - r[0]) * (r[3] - r[2]) * (r[5] - r[4]);
+      }
+      
+      const bool receiver = all || myID == 0;
+      std::vector<T> blocks(receiver ? offsets[nrPS] : 0);
+      
+      MPI_Datatype type;
+      MPI_Type_contiguous(sizeof(T), MPI_BYTE, &type);
+      MPI_Type_commit(&type);
+      
+      // MPI takes int counts and displacements: gather the blocks of as many
+      // tasks at a time as stay below 2^30 values
+      constexpr size_t chunk = 1 << 30;
+      std::vector<int> counts(nrPS);
+      std::vector<int> displs(nrPS);
+      for(int first = 0; first < nrPS;) 
+      {
+        int last = first + 1;
+        while(last < nrPS && offsets[last + 1] - offsets[first] <= chunk) { ++last; }
+        
+        std::fill(counts.begin(), counts.end(), 0);
+        std::fill(displs.begin(), displs.end(), 0);
+        for(int p = first; p < last; ++p) 
+        {
+          counts[p] = static_cast<int>(offsets[p + 1] - offsets[p]);
+          displs[p] = static_cast<int>(offsets[p] - offsets[first]);
+        }
+        
+        int block_size = (myID >= first && myID < last) ? static_cast<int>(block.size()) : 0;
+        T* recv = receiver ? blocks.data() + offsets[first] : nullptr;
+        if(all) 
+        {
+          MPI_Allgatherv(block.data(), block_size, type, 
+            recv, counts.data(), displs.data(), type, world);
+        }
+        else 
+        {
+          MPI_Gatherv(block.data(), block_size, type, 
+            recv, counts.data(), displs.data(), type, 0, world);
+        }
+        
+        first = last;
+      }
+      
+      MPI_Type_free(&type);
+      if(!receiver) { out_full.clear(); return; }
+      
+      out_full.resize(ntotal);
+      size_t offset = 0;
+      for(int p = 0; p < nrPS; ++p) 
+      {
+        const long* r = &ranges[6 * p];
+        for(long k = r[4]; k < r[5]; ++k) {
+          for(long j = r[2]; j < r[3]; ++j) {
+            for(long i = r[0]; i < r[1]; ++i) {
+              out_full[i + j * nx + k * nx * ny] = blocks[offset++];
+            }
+          }
+        }
+      }
+    }
+    
+    // create a non-distributed copy of the grid (valid on rank 0 or on all ranks)
+    EPH_FDM gather_grid(bool all) const 
+    {
+      EPH_FDM full {*this};
+      
+      gather_vector(T_e, full.T_e, all);
+      gather_vector(C_e, full.C_e, all);
+      gather_vector(rho_e, full.rho_e, all);
+      gather_vector(kappa_e, full.kappa_e, all);
+      gather_vector(S_e, full.S_e, all);
+      gather_vector(flag, full.flag, all);
+      gather_vector(T_dynamic_flag, full.T_dynamic_flag, all);
+      
+      allocate(full.dT_e, ntotal, 0.);
+      allocate(full.ddT_e, ntotal, 0.);
+      
+      full.distributed = false;
+      full.stencil.valid = false;
+      
+      return full;
+    }
+    
+    void update_T_total() 
+    {
+      T_total = 0;
+      for(size_t k = halo; k < l_n[2] - halo; ++k) {
+        for(size_t j = halo; j < l_n[1] - halo; ++j) {
+          for(size_t i = halo; i < l_n[0] - halo; ++i) {
+            T_total += T_e[i + j * l_n[0] + k * l_n[0] * l_n[1]];
+          }
+        }
+      }
+      
+      MPI_Allreduce(MPI_IN_PLACE, &T_total, 1, MPI_DOUBLE, MPI_SUM, world);
+      T_total /= ntotal;
+    }
+    
+    // same scheme as solve_explicit() but every rank updates only its own block
+    void solve_distributed() 
+    {
+      // energy deposited into ghost cells belongs to the neighbours
+      reverse_halo_sum(dT_e);
+      lap(EPH_Timer::FDM_BEFORE);
+      
+      double inner_dt = dt / steps;
+      
+      double dtdxdydz = inner_dt * (1.0/dx/dx + 1.0/dy/dy + 1.0/dz/dz);
+      
+      // all ranks rebuild the stencil together
+      if(!stencil.valid || stencil.T_dynamic) 
+      {
+        // update temperature dependent parameters including ghost cells
+        EPH_PRAGMA_OMP(omp parallel)
+        update_parameters(l_total);
+        
+        for(int i = 0; i < 3; ++i) { stencil.n[i] = l_n[i] - 2 * halo; }
+        stencil.t_sy = stencil.c_sy = l_n[0];
+        stencil.t_sz = stencil.c_sz = l_n[0] * l_n[1];
+        stencil.t_first = stencil.c_first = halo + halo * l_n[0] + halo * l_n[0] * l_n[1];
+        
+        // the first node is always included in the extrema as in solve_explicit()
+        const bool has_origin = sub_lo[0] == 0 && sub_lo[1] == 0 && sub_lo[2] == 0;
+        build_stencil(flag.data(), kappa_e.data(), has_origin);
+        
+        double extrema[3] {stencil.c_min, stencil.rho_min, -stencil.kappa_max};
+        MPI_Allreduce(MPI_IN_PLACE, extrema, 3, MPI_DOUBLE, MPI_MIN, world);
+        stencil.c_min = extrema[0];
+        stencil.rho_min = extrema[1];
+        stencil.kappa_max = -extrema[2];
+        
+        int T_dynamic = stencil.T_dynamic;
+        MPI_Allreduce(MPI_IN_PLACE, &T_dynamic, 1, MPI_INT, MPI_MAX, world);
+        stencil.T_dynamic = T_dynamic;
+      }
+      
+      double r = dtdxdydz / stencil.c_min / stencil.rho_min * stencil.kappa_max;
+      
+      unsigned int new_steps = steps;
+      
+      if(r > 0.4) 
+      {
+        inner_dt = 0.4 * inner_dt / r; // get new stable timestep
+        new_steps = std::max(static_cast<unsigned int> (std::ceil(dt / inner_dt)), 1u);
+        inner_dt = dt / new_steps;
+      }
+      
+      if(T_next.size() != l_total) { allocate(T_next, l_total, 0.); }
+      
+      EPH_PRAGMA_OMP(omp parallel)
+      for(unsigned int n = 0; n < new_steps; ++n) 
+      {
+        stencil_step(T_e.data(), T_next.data(), true, inner_dt);
+        
+        // only the master thread communicates (MPI_THREAD_FUNNELED)
+        EPH_PRAGMA_OMP(omp master)
+        {
+          T_e.swap(T_next);
+          exchange_halo(T_e);
+        }
+        
+        EPH_PRAGMA_OMP(omp barrier)
+      }
+      
+      std::fill(dT_e.begin(), dT_e.end(), 0.0);
+      lap(EPH_Timer::FDM_SOLVE);
+      
+      update_T_total();
+      lap(EPH_Timer::FDM_AFTER);
+    }
+    
 };
 
 #endif
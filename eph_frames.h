@@ -0,0 +1,252 @@
+/*
+ * Authors of the extension Artur Tamm, Alfredo Correa
+ * e-mail: artur.tamm.work@gmail.com
+ */
+
+#ifndef EPH_FRAMES
+#define EPH_FRAMES
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+
+/*
+ * Single file container for the electronic temperature frames.
+ *
+ * layout (native byte order):
+ *   header: magic "EPHTFRM", version, bytes per value (4 or 8),
+ *           nx, ny, nz, x0, x1, y0, y1, z0, z1
+ *   frames: nx * ny * nz raw values of T_e each, x fastest
+ *   index:  number of frames, (timestep, offset) of every frame
+ *   footer: offset of the index, magic "EPHTIDX"
+ *
+ * A new frame overwrites the old index and writes it again behind the frame,
+ * so the file is complete after every append(). EPH_FrameReader finds the
+ * index through the footer and reads any frame directly.
+ */
+
+struct EPH_FrameHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t value_size; // 4 (float) or 8 (double)
+  uint64_t n[3]; // nx, ny, nz
+  double lo[3]; // x0, y0, z0
+  double hi[3]; // x1, y1, z1
+
+  static constexpr uint32_t current_version {1};
+
+  // 8 bytes with the terminating zero
+  static const char* frames_magic() { return "EPHTFRM"; }
+  static const char* index_magic() { return "EPHTIDX"; }
+
+  uint64_t get_n_values() const { return n[0] * n[1] * n[2]; }
+  uint64_t get_frame_bytes() const { return get_n_values() * value_size; }
+};
+
+struct EPH_FrameEntry {
+  int64_t step; // timestep of the frame
+  uint64_t offset; // position of the frame in the file
+};
+
+class EPH_FrameFile {
+  public:
+    EPH_FrameFile(const char* in_filename, size_t in_value_size,
+      const size_t* in_n, const double* in_lo, const double* in_hi)
+    {
+      if(in_value_size != sizeof(float) && in_value_size != sizeof(double))
+        throw std::runtime_error("EPH_FrameFile: values have to be float or double");
+
+      std::memcpy(header.magic, EPH_FrameHeader::frames_magic(), sizeof(header.magic));
+      header.version = EPH_FrameHeader::current_version;
+      header.value_size = in_value_size;
+      for(int i = 0; i < 3; ++i) {
+        header.n[i] = in_n[i];
+        header.lo[i] = in_lo[i];
+        header.hi[i] = in_hi[i];
+      }
+
+      fd = fopen(in_filename, "wb+");
+      if(fd == nullptr)
+        throw std::runtime_error(std::string("EPH_FrameFile: cannot open ") + in_filename);
+
+      write(&header, sizeof(header));
+      end_of_frames = sizeof(header);
+      write_index();
+    }
+
+    EPH_FrameFile(const EPH_FrameFile&) = delete;
+    EPH_FrameFile& operator=(const EPH_FrameFile&) = delete;
+
+    ~EPH_FrameFile() { fclose(fd); }
+
+    const EPH_FrameHeader& get_header() const { return header; }
+    size_t get_n_frames() const { return index.size(); }
+
+    // append nx * ny * nz values as the frame of timestep in_step
+    void append(int64_t in_step, const double* in_T)
+    {
+      const uint64_t n_values = header.get_n_values();
+
+      fseek(fd, end_of_frames, SEEK_SET);
+
+      if(header.value_size == sizeof(double)) {
+        write(in_T, n_values * sizeof(double));
+      }
+      else {
+        // convert in blocks to keep the copy small
+        constexpr uint64_t block = 4096;
+        float values[block];
+
+        for(uint64_t first = 0; first < n_values; first += block) {
+          const uint64_t count = std::min(block, n_values - first);
+          for(uint64_t i = 0; i < count; ++i) { values[i] = static_cast<float>(in_T[first + i]); }
+          write(values, count * sizeof(float));
+        }
+      }
+
+      index.push_back(EPH_FrameEntry {in_step, end_of_frames});
+      end_of_frames += header.get_frame_bytes();
+
+      write_index();
+    }
+
+  private:
+    FILE* fd;
+    EPH_FrameHeader header;
+    std::vector<EPH_FrameEntry> index;
+    uint64_t end_of_frames; // the index starts here
+
+    void write(const void* data, size_t bytes)
+    {
+      if(fwrite(data, 1, bytes, fd) != bytes)
+        throw std::runtime_error("EPH_FrameFile: write failed");
+    }
+
+    void write_index()
+    {
+      const uint64_t n_frames = index.size();
+
+      fseek(fd, end_of_frames, SEEK_SET);
+      write(&n_frames, sizeof(n_frames));
+      if(n_frames > 0) { write(index.data(), n_frames * sizeof(EPH_FrameEntry)); }
+      write(&end_of_frames, sizeof(end_of_frames));
+      write(EPH_FrameHeader::index_magic(), 8);
+
+      fflush(fd);
+    }
+};
+
+class EPH_FrameReader {
+  public:
+    explicit EPH_FrameReader(const char* in_filename)
+    {
+      fd = fopen(in_filename, "rb");
+      if(fd == nullptr)
+        throw std::runtime_error(std::string("EPH_FrameReader: cannot open ") + in_filename);
+
+      read(&header, sizeof(header), 0);
+      if(std::memcmp(header.magic, EPH_FrameHeader::frames_magic(), sizeof(header.magic)) != 0)
+        throw std::runtime_error("EPH_FrameReader: not a temperature frame file");
+      if(header.version != EPH_FrameHeader::current_version)
+        throw std::runtime_error("EPH_FrameReader: unsupported version");
+      if(header.value_size != sizeof(float) && header.value_size != sizeof(double))
+        throw std::runtime_error("EPH_FrameReader: unsupported value size");
+
+      // footer: index offset and magic
+      char magic[8];
+      uint64_t index_offset;
+      fseek(fd, -static_cast<long>(sizeof(index_offset) + sizeof(magic)), SEEK_END);
+      read(&index_offset, sizeof(index_offset));
+      read(magic, sizeof(magic));
+      if(std::memcmp(magic, EPH_FrameHeader::index_magic(), sizeof(magic)) != 0)
+        throw std::runtime_error("EPH_FrameReader: index not found");
+
+      uint64_t n_frames;
+      read(&n_frames, sizeof(n_frames), index_offset);
+      index.resize(n_frames);
+      if(n_frames > 0) { read(index.data(), n_frames * sizeof(EPH_FrameEntry)); }
+    }
+
+    EPH_FrameReader(const EPH_FrameReader&) = delete;
+    EPH_FrameReader& operator=(const EPH_FrameReader&) = delete;
+
+    ~EPH_FrameReader() { fclose(fd); }
+
+    const EPH_FrameHeader& get_header() const { return header; }
+    size_t get_n_frames() const { return index.size(); }
+    int64_t get_step(size_t in_frame) const { return index.at(in_frame).step; }
+
+    // values of frame in_frame as doubles, nx * ny * nz of them
+    void read_frame(size_t in_frame, double* out_T)
+    {
+      const uint64_t n_values = header.get_n_values();
+      fseek(fd, index.at(in_frame).offset, SEEK_SET);
+
+      if(header.value_size == sizeof(double)) {
+        read(out_T, n_values * sizeof(double));
+        return;
+      }
+
+      constexpr uint64_t block = 4096;
+      float values[block];
+
+      for(uint64_t first = 0; first < n_values; first += block) {
+        const uint64_t count = std::min(block, n_values - first);
+        read(values, count * sizeof(float));
+        for(uint64_t i = 0; i < count; ++i) { out_T[first + i] = values[i]; }
+      }
+    }
+
+    // frame in_frame in the text layout of EPH_FDM::save_temperature()
+    void write_text(size_t in_frame, FILE* out_fd)
+    {
+      std::vector<double> T(header.get_n_values());
+      read_frame(in_frame, T.data());
+
+      const double d[3] {
+        (header.hi[0] - header.lo[0]) / header.n[0],
+        (header.hi[1] - header.lo[1]) / header.n[1],
+        (header.hi[2] - header.lo[2]) / header.n[2]};
+
+      // this is needed for visit Point3D
+      fprintf(out_fd, "x y z Te\n");
+
+      for(uint64_t k = 0; k < header.n[2]; ++k) {
+        for(uint64_t j = 0; j < header.n[1]; ++j) {
+          for(uint64_t i = 0; i < header.n[0]; ++i) {
+            uint64_t index = i + j * header.n[0] + k * header.n[0] * header.n[1];
+
+            double x = header.lo[0] + i * d[0];
+            double y = header.lo[1] + j * d[1];
+            double z = header.lo[2] + k * d[2];
+
+            fprintf(out_fd, "%.6e %.6e %.6e %.6e\n", x, y, z, T[index]);
+          }
+        }
+      }
+    }
+
+  private:
+    FILE* fd;
+    EPH_FrameHeader header;
+    std::vector<EPH_FrameEntry> index;
+
+    void read(void* data, size_t bytes)
+    {
+      if(fread(data, 1, bytes, fd) != bytes)
+        throw std::runtime_error("EPH_FrameReader: file is truncated");
+    }
+
+    void read(void* data, size_t bytes, uint64_t offset)
+    {
+      fseek(fd, offset, SEEK_SET);
+      read(data, bytes);
+    }
+};
+
+#endif
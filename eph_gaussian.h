@@ -0,0 +1,136 @@
+/*
+ * Authors of the extension Artur Tamm, Alfredo Correa
+ * e-mail: artur.tamm.work@gmail.com
+ */
+
+#ifndef EPH_GAUSSIAN
+#define EPH_GAUSSIAN
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+
+/*
+ * Batched normal variates for the stochastic force.
+ *
+ * Uniform 64 bit words come from xoshiro256++ and are turned into normal
+ * variates with the 256 layer ziggurat (Marsaglia and Tsang 2000, Doornik
+ * 2005). About 99% of the draws are accepted with one table lookup and a
+ * compare, without log/sqrt or a rejection loop; the wedges and the tail
+ * take the slow path. fill() draws a whole array in one call with the fast
+ * path inlined into the loop.
+ */
+
+struct EPH_Gaussian {
+  static constexpr size_t layers {256};
+  static constexpr double R {3.6541528853610088}; // start of the tail
+  static constexpr double V {4.92867323399e-3}; // area of every layer
+
+  uint64_t s[4] {0, 0, 0, 0}; // xoshiro256++ state
+
+  double x[layers + 1]; // layer edges
+  double r[layers]; // x[i + 1] / x[i], the fast acceptance ratio
+  double f[layers + 1]; // exp(-x[i]^2 / 2)
+
+  EPH_Gaussian() : EPH_Gaussian(0) {}
+
+  EPH_Gaussian(uint64_t seed) {
+    // splitmix64 fills the state so that similar seeds give unrelated streams
+    for(size_t i = 0; i < 4; ++i) {
+      seed += 0x9E3779B97F4A7C15ULL;
+      uint64_t z {seed};
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      s[i] = z ^ (z >> 31);
+    }
+
+    double f_i {std::exp(-0.5 * R * R)};
+    x[0] = V / f_i;
+    x[1] = R;
+    x[layers] = 0.;
+
+    for(size_t i = 2; i < layers; ++i) {
+      x[i] = std::sqrt(-2. * std::log(V / x[i - 1] + f_i));
+      f_i = std::exp(-0.5 * x[i] * x[i]);
+    }
+
+    for(size_t i = 0; i < layers; ++i) {
+      r[i] = x[i + 1] / x[i];
+    }
+
+    for(size_t i = 0; i <= layers; ++i) {
+      f[i] = std::exp(-0.5 * x[i] * x[i]);
+    }
+  }
+
+  static uint64_t rotl(uint64_t v, int k) {
+    return (v << k) | (v >> (64 - k));
+  }
+
+  uint64_t next() {
+    uint64_t result {rotl(s[0] + s[3], 23) + s[0]};
+    uint64_t t {s[1] << 17};
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;
+  }
+
+  // uniform in [0, 1)
+  double uniform() {
+    return static_cast<int64_t>(next() >> 11) * (1. / 9007199254740992.); // 2^-53
+  }
+
+  // one normal variate
+  double gaussian() {
+    uint64_t bits {next()};
+
+    // top 53 bits give u in [-1, 1), the low 8 bits select the layer
+    double u {2. * (static_cast<int64_t>(bits >> 11) * (1. / 9007199254740992.)) - 1.};
+    size_t i {static_cast<size_t>(bits & (layers - 1))};
+
+    if(std::fabs(u) < r[i]) return u * x[i];
+
+    return gaussian_slow(u, i);
+  }
+
+  // fill out[0 .. n) with normal variates; same stream as calling gaussian() n times
+  void fill(double* out, size_t n) {
+    for(size_t k = 0; k < n; ++k) {
+      uint64_t bits {next()};
+      double u {2. * (static_cast<int64_t>(bits >> 11) * (1. / 9007199254740992.)) - 1.};
+      size_t i {static_cast<size_t>(bits & (layers - 1))};
+
+      out[k] = (std::fabs(u) < r[i]) ? u * x[i] : gaussian_slow(u, i);
+    }
+  }
+
+  // u was rejected by the rectangle of layer i
+  double gaussian_slow(double u, size_t i) {
+    if(i == 0) return tail(u < 0.);
+
+    // wedge between layers i and i + 1
+    double v {u * x[i]};
+    if(f[i] + uniform() * (f[i + 1] - f[i]) < std::exp(-0.5 * v * v)) return v;
+
+    return gaussian();
+  }
+
+  // Marsaglia's tail algorithm beyond R
+  double tail(bool negative) {
+    double v, w;
+    do {
+      v = -std::log(1. - uniform()) / R;
+      w = -std::log(1. - uniform());
+    } while(w + w < v * v);
+
+    return negative ? -(R + v) : R + v;
+  }
+};
+
+#endif
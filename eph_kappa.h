@@ -14,10 +14,12 @@
 #include <cassert>
 #include <fstream>
 #include <cstddef>
+#include <utility>
 
 // internal headers
 #include "eph_spline.h"
 #include "eph_linear.h"
+#include "eph_table.h"
 
 /*
  * this class reads the per atom electronic properties
@@ -53,23 +55,20 @@ struct EPH_kappa {
     T_max {0}
     {}
 
-  EPH_kappa(char const* file) {
-    std::ifstream fd(file);
-    assert(fd.is_open() && "Unable to open input file");
-    char line[max_line_length];
+  EPH_kappa(char const* file) :
+    EPH_kappa(EPH_Table::read(file))
+    {}
 
-    // read first three lines
-    // these are comments so we ignore them
-    fd.getline(line, max_line_length);
-    fd.getline(line, max_line_length);
-    fd.getline(line, max_line_length);
+  // build the tables from the contents of a .kappa file
+  explicit EPH_kappa(const EPH_Table& table) {
+    EPH_Table::Cursor fd(table);
 
     // read the header
     fd >> n_elements;
 
     assert(n_elements > 0 && "File contains zero elements");
 
-    n_pairs = (n_elements > 1) ? (n_elements + 1) * (n_elements - 1) / 2 : 1;
+    n_pairs = n_elements * (n_elements + 1) / 2;
 
     element_name.resize(n_elements);
     element_number.resize(n_elements);
@@ -79,15 +78,9 @@ struct EPH_kappa {
     E_T_atomic.resize(n_elements);
     K_T_atomic.resize(n_pairs);
 
-    // read the number of elements and their names
-    fd.getline(line, max_line_length);
-    std::string str(line);
-    std::istringstream strstream(str);
-
+    // the names of the elements
     for(size_t i = 0; i < n_elements; ++i) {
-      std::string elem;
-      strstream >> elem;
-      element_name[i] = elem;
+      element_name[i] = fd.get_name(i);
     }
 
     // read spline parameters
@@ -151,16 +144,33 @@ struct EPH_kappa {
       
       K_T_atomic[i] = EPH_Linear(dT, _K_T.begin(), _K_T.end());
     }
-
-    fd.close();
   }
 
-  Spline& get_K_T(int i_type, int j_type) { // this is a convenience function
+  Linear& get_K_T(int i_type, int j_type) { // this is a convenience function
     int k = i_j_to_k(i_type, j_type, n_elements);
     return K_T_atomic[k];
   }
 
+  // bytes of the tables and the element data
+  size_t memory_bytes() const {
+    size_t bytes = element_number.capacity() * sizeof(int);
+    bytes += element_name.capacity() * sizeof(std::string);
+
+    for(const auto& splines : {&rho_r, &rho_r_sq}) {
+      bytes += splines->capacity() * sizeof(Spline);
+      for(const Spline& spline : *splines) { bytes += spline.memory_bytes(); }
+    }
+
+    for(const auto& tables : {&E_T_atomic, &K_T_atomic}) {
+      bytes += tables->capacity() * sizeof(Linear);
+      for(const Linear& table : *tables) { bytes += table.memory_bytes(); }
+    }
+
+    return bytes;
+  }
+
   static int i_j_to_k(int i_type, int j_type, int n) { // temporary solution
+    if(i_type > j_type) { std::swap(i_type, j_type); } // pairs are symmetric
     int k = 0;
 
     for(int i = 0; i < n; ++i) {
@@ -17,6 +17,10 @@
 /*
  * This is a linear interpolation that supports reverse lookup.
  * Therefore the Ce(T) used has to be monotonic (growing or constant).
+ * 
+ * The reverse lookup uses a table over uniformly spaced y values that stores
+ * the first segment of every bin; the segment of a given y is found from 
+ * there with a short local search.
  */
 
 struct EPH_Linear {
@@ -24,6 +28,10 @@ struct EPH_Linear {
   std::vector<double> y;
   std::vector<double> dy;
   
+  // inverse table; empty if y is not growing
+  double inv_y_bin {0.};
+  std::vector<size_t> y_bins;
+  
   EPH_Linear() = default;
   
   template<typename y_it>
@@ -36,6 +44,27 @@ struct EPH_Linear {
     for(size_t i = 0; i < y.size() - 1; ++i) {
       dy.push_back((y[i+1] - y[i]) / dx);
     }
+    
+    build_inverse_table();
+  }
+  
+  // one bin per segment on average
+  void build_inverse_table() {
+    y_bins.clear();
+    
+    if(y.size() < 2 || !(y.back() > y.front())) { return; }
+    if(!std::is_sorted(y.begin(), y.end())) { return; }
+    
+    size_t n_bins = y.size() - 1;
+    inv_y_bin = n_bins / (y.back() - y.front());
+    
+    y_bins.resize(n_bins + 1);
+    size_t idx = 0;
+    for(size_t b = 0; b <= n_bins; ++b) {
+      double y_b = y.front() + b / inv_y_bin;
+      while(idx < y.size() - 2 && y[idx + 1] <= y_b) { ++idx; }
+      y_bins[b] = idx;
+    }
   }
   
   // given an x find the y value
@@ -50,6 +79,20 @@ struct EPH_Linear {
   
   // given a y find the appropriate x
   double reverse_lookup(double _y) {
+    if(!y_bins.empty()) {
+      // outside of the table as with std::upper_bound below
+      if(!(_y >= y.front() && _y < y.back())) { return 0.; }
+      
+      size_t b = static_cast<size_t>((_y - y.front()) * inv_y_bin);
+      size_t idx = y_bins[std::min(b, y_bins.size() - 1)];
+      
+      // the bin can be off by one due to rounding
+      while(idx > 0 && y[idx] > _y) { --idx; }
+      while(y[idx + 1] <= _y) { ++idx; }
+      
+      return idx * dx + 1. / dy[idx] * (_y - y[idx]);
+    }
+    
     auto it {std::upper_bound(y.begin(), y.end(), _y)};
     if(it != y.end()) {
       size_t idx {static_cast<size_t>(std::distance(y.begin(), it))};
@@ -72,6 +115,12 @@ struct EPH_Linear {
     return dy[dy.size() - 1];
   }
   
+  // bytes of the tables
+  size_t memory_bytes() const {
+    return (y.capacity() + dy.capacity()) * sizeof(double)
+      + y_bins.capacity() * sizeof(size_t);
+  }
+  
 };
 
 #endif
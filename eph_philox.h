@@ -0,0 +1,92 @@
+/*
+ * Authors of the extension Artur Tamm, Alfredo Correa
+ * e-mail: artur.tamm.work@gmail.com
+ */
+
+#ifndef EPH_PHILOX
+#define EPH_PHILOX
+
+#include <cstdint>
+#include <cmath>
+
+/*
+ * Counter based random numbers (Philox4x32-10, Salmon et al., SC'11).
+ *
+ * The numbers are a pure function of (seed, atom tag, timestep); every task
+ * can evaluate them for its ghost atoms directly and the result does not
+ * depend on the domain decomposition. One block gives four 32 bit uniforms
+ * that are turned into normal variates with Box-Muller; the 32 bit
+ * resolution limits the tails to about 6.66 sigma.
+ */
+
+struct EPH_Philox {
+  uint32_t key[2] {0, 0};
+
+  EPH_Philox() = default;
+
+  EPH_Philox(uint32_t seed) : key {seed, 0x45504821} {} // second word: "EPH!"
+
+  static void mulhilo(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo) {
+    uint64_t product {static_cast<uint64_t>(a) * b};
+    hi = static_cast<uint32_t>(product >> 32);
+    lo = static_cast<uint32_t>(product);
+  }
+
+  // ten rounds of Philox4x32 on ctr with key k
+  static void block(uint32_t* ctr, const uint32_t* k) {
+    constexpr uint32_t M0 {0xD2511F53};
+    constexpr uint32_t M1 {0xCD9E8D57};
+    constexpr uint32_t W0 {0x9E3779B9};
+    constexpr uint32_t W1 {0xBB67AE85};
+
+    uint32_t k0 {k[0]};
+    uint32_t k1 {k[1]};
+
+    for(int round = 0; round < 10; ++round) {
+      uint32_t hi0, lo0, hi1, lo1;
+      mulhilo(M0, ctr[0], hi0, lo0);
+      mulhilo(M1, ctr[2], hi1, lo1);
+
+      uint32_t c1 {ctr[1]};
+      uint32_t c3 {ctr[3]};
+      ctr[0] = hi1 ^ c1 ^ k0;
+      ctr[1] = lo1;
+      ctr[2] = hi0 ^ c3 ^ k1;
+      ctr[3] = lo0;
+
+      k0 += W0;
+      k1 += W1;
+    }
+  }
+
+  // four uniform 32 bit words for (tag, step)
+  void get_uint4(uint64_t tag, uint64_t step, uint32_t* out) const {
+    out[0] = static_cast<uint32_t>(tag);
+    out[1] = static_cast<uint32_t>(tag >> 32);
+    out[2] = static_cast<uint32_t>(step);
+    out[3] = static_cast<uint32_t>(step >> 32);
+
+    block(out, key);
+  }
+
+  // three independent normal variates for (tag, step)
+  void get_gaussian3(uint64_t tag, uint64_t step, double* xi) const {
+    constexpr double to_unit {1. / 4294967296.}; // 2^-32
+    constexpr double two_pi {2. * M_PI};
+
+    uint32_t u[4];
+    get_uint4(tag, step, u);
+
+    // u1 in (0, 1] for the logarithm, u2 in [0, 1) for the angle
+    double r1 {std::sqrt(-2. * std::log((u[0] + 1.) * to_unit))};
+    double a1 {two_pi * (u[1] * to_unit)};
+    double r2 {std::sqrt(-2. * std::log((u[2] + 1.) * to_unit))};
+    double a2 {two_pi * (u[3] * to_unit)};
+
+    xi[0] = r1 * std::cos(a1);
+    xi[1] = r1 * std::sin(a1);
+    xi[2] = r2 * std::cos(a2);
+  }
+};
+
+#endif
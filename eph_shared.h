@@ -0,0 +1,212 @@
+/*
+ * Authors of the extension Artur Tamm, Alfredo Correa
+ * e-mail: artur.tamm.work@gmail.com
+ */
+
+#ifndef EPH_SHARED
+#define EPH_SHARED
+
+// external headers
+#include <memory>
+#include <vector>
+#include <utility>
+#include <cassert>
+#include <cstddef>
+
+#include <mpi.h>
+
+/*
+ * Read-only spline tables shared by the tasks of a node.
+ *
+ * EPH_SharedVector is a container policy for the Container template of
+ * EPH_Spline and EPH_Beta: it behaves like std::vector but can be turned
+ * into a non-owning view of memory held elsewhere. Builds with
+ * -DEPH_SHARED_TABLES use it for all tables (see eph_spline.h).
+ *
+ * EPH_NodeShared allocates one MPI-3 shared memory window per node; task 0
+ * of the node copies the coefficient tables of the splines into it and then
+ * every task drops its own copy and reads the node's. The window has to
+ * outlive the splines (and their copies) that view it.
+ */
+
+template<typename T, typename A = std::allocator<T>>
+class EPH_SharedVector {
+  public:
+    using value_type = T;
+    using size_type = size_t;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    EPH_SharedVector() = default;
+
+    explicit EPH_SharedVector(size_t n) :
+      own(n)
+    {
+      sync();
+    }
+
+    EPH_SharedVector(size_t n, const T& value) :
+      own(n, value)
+    {
+      sync();
+    }
+
+    // a copy of a view views the same memory
+    EPH_SharedVector(const EPH_SharedVector& other) :
+      own(other.own),
+      ptr {other.ptr},
+      n {other.n},
+      shared {other.shared}
+    {
+      sync();
+    }
+
+    EPH_SharedVector(EPH_SharedVector&& other) :
+      EPH_SharedVector()
+    {
+      swap(other);
+    }
+
+    EPH_SharedVector& operator=(EPH_SharedVector other) {
+      swap(other);
+      return *this;
+    }
+
+    void swap(EPH_SharedVector& other) {
+      own.swap(other.own);
+      std::swap(ptr, other.ptr);
+      std::swap(n, other.n);
+      std::swap(shared, other.shared);
+    }
+
+    size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+
+    // a view owns nothing
+    size_t capacity() const { return own.capacity(); }
+
+    T* data() { return ptr; }
+    const T* data() const { return ptr; }
+
+    T& operator[](size_t i) { return ptr[i]; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+
+    iterator begin() { return ptr; }
+    iterator end() { return ptr + n; }
+    const_iterator begin() const { return ptr; }
+    const_iterator end() const { return ptr + n; }
+
+    void resize(size_t in_n) {
+      assert(!shared && "a view cannot be resized");
+      own.resize(in_n);
+      sync();
+    }
+
+    void push_back(const T& value) {
+      assert(!shared && "a view cannot be resized");
+      own.push_back(value);
+      sync();
+    }
+
+    bool is_view() const { return shared; }
+
+    // read in_n values from in_ptr from now on and free the own copy
+    void view(T* in_ptr, size_t in_n) {
+      std::vector<T, A>().swap(own);
+
+      ptr = in_ptr;
+      n = in_n;
+      shared = true;
+    }
+
+  private:
+    std::vector<T, A> own;
+    T* ptr {nullptr}; // own.data() or the viewed memory
+    size_t n {0};
+    bool shared {false};
+
+    void sync() {
+      if(shared) { return; }
+
+      ptr = own.data();
+      n = own.size();
+    }
+};
+
+class EPH_NodeShared {
+  public:
+    // collective over comm; the splines have to be the same on every task
+    template<typename Spline>
+    EPH_NodeShared(MPI_Comm comm, const std::vector<Spline*>& splines) {
+      MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node);
+      MPI_Comm_rank(node, &node_rank);
+      MPI_Comm_size(node, &node_size);
+
+      // every table starts on its own cache line
+      std::vector<size_t> offsets;
+      for(const Spline* spline : splines) {
+        offsets.push_back(bytes);
+        bytes += (spline->get_table_bytes() + alignment - 1) / alignment * alignment;
+      }
+
+      MPI_Win_allocate_shared(node_rank == 0 ? bytes : 0, 1, MPI_INFO_NULL, node, &base, &window);
+
+      if(node_rank != 0) {
+        MPI_Aint size;
+        int disp_unit;
+        MPI_Win_shared_query(window, 0, &size, &disp_unit, &base);
+      }
+
+      // task 0 of the node writes, the others wait until the tables are visible
+      MPI_Win_lock_all(MPI_MODE_NOCHECK, window);
+
+      if(node_rank == 0) {
+        for(size_t i = 0; i < splines.size(); ++i)
+          splines[i]->copy_table(static_cast<char*>(base) + offsets[i]);
+      }
+
+      MPI_Win_sync(window);
+      MPI_Barrier(node);
+      MPI_Win_sync(window);
+
+      MPI_Win_unlock_all(window);
+
+      for(size_t i = 0; i < splines.size(); ++i)
+        splines[i]->view_table(static_cast<char*>(base) + offsets[i]);
+    }
+
+    EPH_NodeShared(const EPH_NodeShared&) = delete;
+    EPH_NodeShared& operator=(const EPH_NodeShared&) = delete;
+
+    // the memory is gone with MPI itself if MPI was finalized first
+    ~EPH_NodeShared() {
+      int finalized;
+      MPI_Finalized(&finalized);
+      if(finalized) { return; }
+
+      MPI_Win_free(&window);
+      MPI_Comm_free(&node);
+    }
+
+    // bytes of the window held by this task (all of it on task 0 of the node)
+    size_t memory_bytes() const {
+      return node_rank == 0 ? bytes : 0;
+    }
+
+    int get_node_size() const {
+      return node_size;
+    }
+
+  private:
+    static constexpr size_t alignment = 64;
+
+    MPI_Comm node; // tasks sharing the memory
+    int node_rank;
+    int node_size;
+
+    MPI_Win window;
+    void* base {nullptr};
+    size_t bytes {0};
+};
+
+#endif
@@ -11,7 +11,11 @@
 #include <cmath>
 #include <cassert>
 #include <cstddef>
+#include <cstring>
 
+#ifdef EPH_SHARED_TABLES
+#include "eph_shared.h"
+#endif
 
 /// TEMPORARY
 #include <iostream>
@@ -141,6 +145,32 @@ class EPH_Spline {
       return c[index].a + x * (c[index].b + x * (c[index].c + x * c[index].d));
     }
 
+    size_t get_n_points() const { return c.size(); }
+    Float get_inv_dx() const { return inv_dx; }
+
+    // bytes of the coefficient table
+    size_t memory_bytes() const { return c.capacity() * sizeof(Coefficients); }
+
+    // raw coefficient table, e.g. to place it in memory shared by several tasks (eph_shared.h)
+    size_t get_table_bytes() const { return c.size() * sizeof(Coefficients); }
+    void copy_table(void* out) const { std::memcpy(out, &c[0], get_table_bytes()); }
+
+    // read the table from in instead of the own copy; needs a Container with view()
+    void view_table(void* in) { c.view(static_cast<Coefficients*>(in), c.size()); }
+
+    // after view_table() the table is a view and the own copy is freed (needs EPH_SharedVector)
+    bool is_table_view() const { return c.is_view(); }
+    size_t get_table_capacity() const { return c.capacity(); }
+
+    // polynomial a + b x + c x^2 + d x^3 of knot index, for copies of the table
+    void get_coefficients(size_t index, Float* abcd) const {
+      assert(index < c.size());
+      abcd[0] = c[index].a;
+      abcd[1] = c[index].b;
+      abcd[2] = c[index].c;
+      abcd[3] = c[index].d;
+    }
+
     Float reverse(Float y) const { // brute force binary search
       Float x0, y0;
       Float x1, y1;
@@ -208,8 +238,14 @@ using Float = double;
 template<typename _F = Float>
 using Allocator = std::allocator<_F>;
 
+// tables that can be moved into node shared memory (see eph_shared.h)
+#ifdef EPH_SHARED_TABLES
+template<typename _F = Float, typename _A = Allocator<_F>>
+using Container = EPH_SharedVector<_F, _A>;
+#else
 template<typename _F = Float, typename _A = Allocator<_F>>
 using Container = std::vector<_F, _A>;
+#endif
 
 using Spline = EPH_Spline<Float, Allocator, Container>;
 
@@ -0,0 +1,95 @@
+/*
+ * Authors of the extension Artur Tamm, Alfredo Correa
+ * e-mail: artur.tamm.work@gmail.com
+ */
+
+#ifndef EPH_TABLE
+#define EPH_TABLE
+
+// external headers
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstddef>
+#include <stdexcept>
+
+/*
+ * Contents of a tabulated input file (.beta, .kappa) in memory.
+ *
+ * The files start with three comment lines and a line with the number of
+ * elements followed by their names; everything after that are numbers.
+ * EPH_Beta and EPH_kappa build their splines from a table instead of the
+ * file, so one task can read the file and send the table to the others
+ * (see eph_broadcast.h).
+ */
+
+struct EPH_Table {
+  std::vector<std::string> names; // element names of the header line
+  std::vector<double> values; // number of elements and every number after the names
+
+  static EPH_Table read(const char* file) {
+    std::ifstream fd(file);
+
+    if(!fd.is_open())
+      throw std::runtime_error(std::string("EPH_Table: unable to open ") + file);
+
+    EPH_Table table;
+    std::string line;
+
+    // read first three lines
+    // these are comments so we ignore them
+    std::getline(fd, line);
+    std::getline(fd, line);
+    std::getline(fd, line);
+
+    // the number of elements and their names
+    double n_elements;
+    fd >> n_elements;
+    table.values.push_back(n_elements);
+
+    std::getline(fd, line);
+    std::istringstream strstream(line);
+
+    for(std::string elem; strstream >> elem; )
+      table.names.push_back(elem);
+
+    // spline parameters and knots
+    for(double value; fd >> value; )
+      table.values.push_back(value);
+
+    return table;
+  }
+
+  // reads the values in order, like the file stream did
+  class Cursor {
+    public:
+      explicit Cursor(const EPH_Table& in_table) :
+        table {in_table},
+        position {0}
+        {}
+
+      template<typename T>
+      Cursor& operator>>(T& value) {
+        if(position == table.values.size())
+          throw std::runtime_error("EPH_Table: not enough values in the file");
+
+        value = static_cast<T>(table.values[position++]);
+        return *this;
+      }
+
+      // element name i of the header line
+      std::string get_name(size_t i) const {
+        if(i >= table.names.size())
+          throw std::runtime_error("EPH_Table: not enough element names in the file");
+
+        return table.names[i];
+      }
+
+    private:
+      const EPH_Table& table;
+      size_t position;
+  };
+};
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ * Authors of the extension Artur Tamm, Alfredo Correa
+ * e-mail: artur.tamm.work@gmail.com
+ */
+
+#ifndef EPH_TIMER
+#define EPH_TIMER
+
+#include <cstddef>
+
+#include <mpi.h>
+
+/*
+ * Wall time spent in the phases of the fix on one rank.
+ *
+ * The phases of a step follow each other, so one time stamp is enough:
+ * start() sets it and lap(phase) adds the time since the last stamp to the
+ * phase and moves the stamp. A disabled timer does not read the clock.
+ */
+
+struct EPH_Timer {
+  enum Phase : int {
+    RANDOM = 0, // drawing xi_i
+    ENVIRONMENT, // rho_i, alpha_rho_i and the pair cache
+    COMM_RHO, // forward communication of rho_i (and xi_i)
+    W_PASS, // w_i of the friction
+    COMM_W, // forward communication of w_i
+    FORCES, // friction and random forces, added to f
+    COMM_REVERSE, // reverse communication with HALF_LIST
+    DEPOSIT, // energy inserted into the FDM grid
+    FDM_BEFORE, // MPI sync before the FDM solve
+    FDM_SOLVE, // FDM solver
+    FDM_AFTER, // MPI sync after the FDM solve
+    SAVE, // writing the temperature file
+    INTEGRATE, // initial and final integration
+    OTHER, // energy sum and per atom array
+    N_PHASES
+  };
+
+  bool enabled {true};
+  double stamp {0};
+  double total[N_PHASES] {};
+
+  static const char* get_name(int phase) {
+    static const char* names[N_PHASES] {
+      "Random", "Environment", "Comm rho", "W pass", "Comm w", "Forces",
+      "Comm reverse", "Deposit", "FDM sync before", "FDM solve",
+      "FDM sync after", "Save T", "Integrate", "Other"};
+
+    return names[phase];
+  }
+
+  void reset() {
+    for(size_t i = 0; i < N_PHASES; ++i) { total[i] = 0; }
+  }
+
+  void start() {
+    if(enabled) { stamp = MPI_Wtime(); }
+  }
+
+  void lap(int phase) {
+    if(!enabled) return;
+
+    double now = MPI_Wtime();
+    total[phase] += now - stamp;
+    stamp = now;
+  }
+
+  double get_total() const {
+    double sum = 0;
+    for(size_t i = 0; i < N_PHASES; ++i) { sum += total[i]; }
+
+    return sum;
+  }
+};
+
+#endif
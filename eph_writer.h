@@ -0,0 +1,134 @@
+/*
+ * Authors of the extension Artur Tamm, Alfredo Correa
+ * e-mail: artur.tamm.work@gmail.com
+ */
+
+#ifndef EPH_WRITER
+#define EPH_WRITER
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+ * Background thread that writes snapshots to files.
+ *
+ * The caller copies the data into a buffer from get_buffer() and hands it
+ * over with push() together with a function that formats and writes it;
+ * the thread calls the functions in order and recycles the buffers, so a
+ * steady output needs no new allocations (two buffers with the default
+ * queue of one frame in flight and one being written). push() returns at
+ * once unless the queue is full. The thread starts with the first push()
+ * and the destructor writes what is left before joining.
+ */
+
+class EPH_Writer
+{
+  public:
+    using Buffer = std::vector<double>;
+    using Job = std::function<void(const Buffer&)>;
+
+    explicit EPH_Writer(size_t in_capacity = 1) :
+      capacity {in_capacity > 0 ? in_capacity : 1}
+    {}
+
+    EPH_Writer(const EPH_Writer&) = delete;
+    EPH_Writer& operator=(const EPH_Writer&) = delete;
+
+    ~EPH_Writer()
+    {
+      {
+        std::lock_guard<std::mutex> lock {mutex};
+        stop = true;
+      }
+
+      not_empty.notify_one();
+      if(thread.joinable()) { thread.join(); }
+    }
+
+    // buffer of n values, recycled from an earlier snapshot if possible
+    Buffer get_buffer(size_t n)
+    {
+      Buffer buffer;
+
+      {
+        std::lock_guard<std::mutex> lock {mutex};
+        if(!free_buffers.empty())
+        {
+          buffer.swap(free_buffers.back());
+          free_buffers.pop_back();
+        }
+      }
+
+      buffer.resize(n);
+      return buffer;
+    }
+
+    // queue job(buffer); blocks only while the queue is full
+    void push(Buffer&& buffer, Job job)
+    {
+      std::unique_lock<std::mutex> lock {mutex};
+
+      if(!thread.joinable()) { thread = std::thread(&EPH_Writer::run, this); }
+
+      not_full.wait(lock, [this] { return jobs.size() < capacity; });
+      jobs.emplace_back(std::move(buffer), std::move(job));
+
+      lock.unlock();
+      not_empty.notify_one();
+    }
+
+    // block until every queued job is written
+    void wait()
+    {
+      std::unique_lock<std::mutex> lock {mutex};
+      idle.wait(lock, [this] { return jobs.empty() && !busy; });
+    }
+
+  private:
+    const size_t capacity; // jobs waiting for the thread
+
+    std::deque<std::pair<Buffer, Job>> jobs;
+    std::vector<Buffer> free_buffers;
+    bool busy {false}; // the thread is writing a job
+    bool stop {false};
+
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::condition_variable idle;
+    std::thread thread;
+
+    void run()
+    {
+      std::unique_lock<std::mutex> lock {mutex};
+
+      while(true)
+      {
+        not_empty.wait(lock, [this] { return stop || !jobs.empty(); });
+        if(jobs.empty()) { break; } // stop after the queue is drained
+
+        std::pair<Buffer, Job> job {std::move(jobs.front())};
+        jobs.pop_front();
+        busy = true;
+
+        lock.unlock();
+        not_full.notify_one();
+
+        job.second(job.first);
+
+        lock.lock();
+        busy = false;
+
+        if(free_buffers.size() <= capacity) { free_buffers.push_back(std::move(job.first)); }
+        if(jobs.empty()) { idle.notify_all(); }
+      }
+    }
+};
+
+#endif
@@ -5,6 +5,7 @@
 
 // external headers
 #include <iostream>
+#include <cstdio>
 #include <cstring> // TODO: remove
 #include <string>
 #include <cstdlib>
@@ -20,7 +21,6 @@
 #include "neigh_list.h"
 #include "atom.h"
 #include "memory.h"
-#include "random_mars.h"
 #include "force.h"
 #include "update.h"
 #include "comm.h"
@@ -29,6 +29,7 @@
 #include "fix_eph.h"
 #include "eph_beta.h"
 #include "eph_fdm.h"
+#include "eph_broadcast.h"
 
 using namespace LAMMPS_NS;
 using namespace FixConst;
@@ -69,21 +70,21 @@ FixEPH::FixEPH(LAMMPS *lmp, int narg, char **arg) :
   state = FixState::NONE;
 
   vector_flag = 1; // fix is able to output a vector compute
-  size_vector = 2; // 2 elements in the vector
   global_freq = 1; // frequency for vector data
-  extvector = 1; // external vector allocated by this fix???
   nevery = 1; // call end_of_step every step
   peratom_flag = 1; // fix provides per atom values
   size_peratom_cols = 8; // per atom has 8 dimensions
   peratom_freq = 1; // per atom values are provided every step
   //ghostneigh = 1; // neighbours of neighbours
 
-  comm_forward = 3; // forward communication is needed
+  comm_forward = 5; // forward communication is needed, at most RHO | XI
+  comm_reverse = 6; // reverse communication of forces with HALF_LIST
   comm->ghost_velocity = 1; // special: fix requires velocities for ghost atoms
 
   // initialise rng
   seed = atoi(arg[3]);
-  random = new RanMars(lmp, seed + myID);
+  gaussian = EPH_Gaussian(seed + myID);
+  philox = EPH_Philox(seed);
 
   // read model behaviour parameters
   eph_flag = strtol(arg[4], NULL, 0);
@@ -98,9 +99,32 @@ FixEPH::FixEPH(LAMMPS *lmp, int narg, char **arg) :
     if(eph_flag & Flag::NOINT) std::cout << "No integration: ON\n";
     if(eph_flag & Flag::NOFRICTION) std::cout << "No friction application: ON\n";
     if(eph_flag & Flag::NORANDOM) std::cout << "No random application: ON\n";
+    if(eph_flag & Flag::PHILOX) std::cout << "Counter based random numbers: ON\n";
+    if(eph_flag & Flag::FDM_DISTRIBUTED) std::cout << "Distributed FDM grid: ON\n";
+    if(eph_flag & Flag::FDM_IMPLICIT) std::cout << "Implicit FDM solver: ON\n";
+    if(eph_flag & Flag::HALF_LIST) std::cout << "Half neighbour list: ON\n";
+    if(eph_flag & Flag::NOTIMING) std::cout << "No timing: ON\n";
+    if(eph_flag & Flag::BINARY_T) std::cout << "Binary temperature frames (float): ON\n";
+    if(eph_flag & Flag::BINARY_T_DOUBLE) std::cout << "Binary temperature frames (double): ON\n";
+    if(eph_flag & Flag::BINARY_STATE) std::cout << "Binary FDM state: ON\n";
+    if(eph_flag & Flag::NODE_SHARED) std::cout << "Node shared beta(rho) tables: ON\n";
     std::cout << '\n';
   }
 
+  // Ee and T_e, followed by the time of every phase on this rank
+  timer.enabled = !(eph_flag & Flag::NOTIMING);
+  size_vector = timer.enabled ? 2 + EPH_Timer::N_PHASES : 2;
+
+  // energy and temperature are extensive as before, the times are not
+  extvector = -1;
+  extlist = new int[size_vector];
+  extlist[0] = 1;
+  extlist[1] = 1;
+  for(int i = 2; i < size_vector; ++i) { extlist[i] = 0; }
+
+  if((eph_flag & Flag::PHILOX) && !atom->tag_enable)
+    error->all(FLERR, "FixEPH: counter based random numbers require atom IDs");
+
   // read model selection
   eph_model = atoi(arg[5]);
 
@@ -118,6 +142,9 @@ FixEPH::FixEPH(LAMMPS *lmp, int narg, char **arg) :
     std::cout << std::endl;
   }
 
+  if((eph_flag & Flag::HALF_LIST) && eph_model != Model::PRL)
+    error->all(FLERR, "FixEPH: half neighbour list is only implemented for the PRL model");
+
   // electronic structure parameters
   double v_rho = atof(arg[6]);
   double v_Ce = atof(arg[7]);
@@ -151,7 +178,13 @@ FixEPH::FixEPH(LAMMPS *lmp, int narg, char **arg) :
     strcpy(T_state, "T.restart");
   }
   else {
-    fdm = EPH_FDM(arg[13]);
+    // task 0 reads the state (text or binary) and broadcasts it
+    try {
+      fdm = EPH_FDM(arg[13], world);
+    }
+    catch(std::runtime_error& e) {
+      error->one(FLERR, e.what());
+    }
 
     sprintf(T_state, "%s.restart", arg[13]);
   }
@@ -160,9 +193,35 @@ FixEPH::FixEPH(LAMMPS *lmp, int narg, char **arg) :
   if(T_freq > 0)
     sprintf(T_out, "%s", arg[15]);
 
+  // all temperature frames go into T_out instead of one text file per frame
+  if(T_freq > 0 && (eph_flag & (Flag::BINARY_T | Flag::BINARY_T_DOUBLE)) && myID == 0) {
+    const size_t grid[3] {fdm.get_nx(), fdm.get_ny(), fdm.get_nz()};
+    double lo[3], hi[3];
+    fdm.get_box_dimensions(lo, hi);
+
+    const size_t value_size = (eph_flag & Flag::BINARY_T_DOUBLE) ? sizeof(double) : sizeof(float);
+
+    try {
+      T_frames = std::make_shared<EPH_FrameFile>(T_out, value_size, grid, lo, hi);
+    }
+    catch(std::runtime_error& e) {
+      error->one(FLERR, e.what());
+    }
+  }
+
   // set the communicator
   fdm.set_comm(world, myID, nrPS);
   fdm.set_dt(update->dt);
+  fdm.set_timer(&timer);
+  fdm.set_writer(&writer);
+  fdm.set_binary_state(eph_flag & Flag::BINARY_STATE);
+
+  if(eph_flag & Flag::FDM_IMPLICIT) {
+    if(eph_flag & Flag::FDM_DISTRIBUTED)
+      error->all(FLERR, "FixEPH: implicit FDM solver cannot be used with a distributed grid");
+
+    fdm.set_implicit(true);
+  }
 
   // initialise beta(rho)
   types = atom->ntypes;
@@ -172,11 +231,26 @@ FixEPH::FixEPH(LAMMPS *lmp, int narg, char **arg) :
 
   type_map = new int[types]; // TODO: switch to vector
 
-  beta = Beta(arg[16]);
+  // task 0 reads the file and broadcasts the knots
+  try {
+    beta = Beta(eph_broadcast_table(arg[16], world));
+  }
+  catch(std::runtime_error& e) {
+    error->one(FLERR, e.what());
+  }
 
   if(beta.get_n_elements() < 1)
     error->all(FLERR, "Fix eph: no elements found in input file");
 
+  // the splines of every task view the same tables in node shared memory
+  if(eph_flag & Flag::NODE_SHARED) {
+#ifdef EPH_SHARED_TABLES
+    shared_tables = std::make_shared<EPH_NodeShared>(world, beta.get_splines());
+#else
+    error->all(FLERR, "FixEPH: node shared tables need a build with -DEPH_SHARED_TABLES");
+#endif
+  }
+
   r_cutoff = beta.get_r_cutoff();
   r_cutoff_sq = beta.get_r_cutoff_sq();
   rho_cutoff = beta.get_rho_cutoff();
@@ -206,6 +280,7 @@ FixEPH::FixEPH(LAMMPS *lmp, int narg, char **arg) :
   w_i = nullptr;
 
   rho_i = nullptr;
+  alpha_rho_i = nullptr;
   array = nullptr;
 
   xi_i = nullptr;
@@ -213,6 +288,7 @@ FixEPH::FixEPH(LAMMPS *lmp, int narg, char **arg) :
   T_e_i = nullptr;
 
   list = nullptr;
+  force_kernel = nullptr;
 
   // NO ARRAYS BEFORE THIS
   grow_arrays(atom->nmax);
@@ -223,6 +299,7 @@ FixEPH::FixEPH(LAMMPS *lmp, int narg, char **arg) :
   size_t ntotal = atom->nghost + nlocal;
 
   std::fill_n(&(rho_i[0]), ntotal, 0);
+  std::fill_n(&(alpha_rho_i[0]), ntotal, 0);
   std::fill_n(&(xi_i[0][0]), 3 * ntotal, 0);
   std::fill_n(&(w_i[0][0]), 3 * ntotal, 0);
 
@@ -238,12 +315,13 @@ FixEPH::FixEPH(LAMMPS *lmp, int narg, char **arg) :
 
 // destructor
 FixEPH::~FixEPH() {
-  delete random;
   delete[] type_map;
+  delete[] extlist;
 
   atom->delete_callback(id, 0);
 
   memory->destroy(rho_i);
+  memory->destroy(alpha_rho_i);
 
   memory->destroy(array);
 
@@ -267,8 +345,17 @@ void FixEPH::init() {
   /* copy paste from vcsgc */
   /** we are a fix and we need full neighbour list **/
   int request_style = NeighConst::REQ_FULL | NeighConst::REQ_GHOST;
+
+  // every pair once; pairs with ghosts are owned by one task only and reverse communicated
+  if(eph_flag & Flag::HALF_LIST)
+    request_style = NeighConst::REQ_DEFAULT | NeighConst::REQ_NEWTON_ON;
+
   auto req = neighbor->add_request(this, request_style);
   req->set_cutoff(r_cutoff);
+
+  // ghosts have to reach r_cutoff even if it is longer than the pair style cutoff
+  if(comm->cutghostuser < r_cutoff + neighbor->skin)
+    comm->cutghostuser = r_cutoff + neighbor->skin;
   
   //int irequest = neighbor->request((void*)this, this->instance_me);
   //neighbor->requests[irequest]->pair = 0;
@@ -279,6 +366,45 @@ void FixEPH::init() {
 
   //neighbor->requests[irequest]->cutoff = r_cutoff;
 
+  // every rank solves the part of the grid inside its subdomain
+  if(eph_flag & Flag::FDM_DISTRIBUTED) {
+    if(comm->layout == Comm::LAYOUT_TILED)
+      error->all(FLERR, "FixEPH: distributed FDM grid requires a brick decomposition");
+
+    double lo[3], hi[3];
+    fdm.get_box_dimensions(lo, hi);
+    for(int i = 0; i < 3; ++i) {
+      if(lo[i] != domain->boxlo[i] || hi[i] != domain->boxhi[i])
+        error->all(FLERR, "FixEPH: distributed FDM grid has to match the simulation box");
+    }
+
+    // owned atoms can drift up to half skin outside the subdomain between reneighbouring
+    size_t halo = 1;
+    const double d[3] {
+      (hi[0] - lo[0]) / fdm.get_nx(),
+      (hi[1] - lo[1]) / fdm.get_ny(),
+      (hi[2] - lo[2]) / fdm.get_nz()};
+    for(int i = 0; i < 3; ++i) {
+      halo = std::max(halo, 1 + static_cast<size_t>(std::ceil(0.5 * neighbor->skin / d[i])));
+    }
+
+    try {
+      fdm.set_decomposition(domain->sublo, domain->subhi, comm->procneigh, halo);
+    }
+    catch(std::runtime_error& e) {
+      error->all(FLERR, e.what());
+    }
+  }
+
+  // specialised force kernel for the model, the enabled terms and the group
+  select_force_kernel();
+
+  // the timers cover one run
+  timer.reset();
+
+  // the grid is in its final layout now
+  print_memory_usage();
+
   reset_dt();
 }
 
@@ -301,6 +427,8 @@ int FixEPH::setmask() {
 void FixEPH::initial_integrate(int) {
   if(eph_flag & Flag::NOINT) return;
 
+  timer.start();
+
   double **x = atom->x;
   double **v = atom->v;
   double **f = atom->f;
@@ -321,11 +449,15 @@ void FixEPH::initial_integrate(int) {
       x[i][2] += dtv * v[i][2];
     }
   }
+
+  timer.lap(EPH_Timer::INTEGRATE);
 }
 
 void FixEPH::final_integrate() {
   if(eph_flag & Flag::NOINT) return;
 
+  timer.start();
+
   double **v = atom->v;
   double **f = atom->f;
   double *mass = atom->mass;
@@ -341,12 +473,42 @@ void FixEPH::final_integrate() {
       v[i][2] += dtfm * f[i][2];
     }
   }
+
+  timer.lap(EPH_Timer::INTEGRATE);
 }
 
 void FixEPH::end_of_step() {
+  timer.start();
+
+  double E_local = deposit_energy();
+  timer.lap(EPH_Timer::DEPOSIT);
+
+  // the grid adds its sync and solve phases
+  if(eph_flag & Flag::FDM) {
+    fdm.solve();
+  }
+
+  // save heatmap
+  if((myID == 0 || fdm.is_distributed()) && T_freq > 0 && (update->ntimestep % T_freq) == 0) { // TODO: implement a counter instead
+    if(eph_flag & (Flag::BINARY_T | Flag::BINARY_T_DOUBLE))
+      fdm.save_temperature_frame(T_frames, update->ntimestep);
+    else
+      fdm.save_temperature(T_out, update->ntimestep / T_freq);
+  }
+  timer.lap(EPH_Timer::SAVE);
+
+  // this is for checking energy conservation
+  MPI_Allreduce(MPI_IN_PLACE, &E_local, 1, MPI_DOUBLE, MPI_SUM, world);
+
+  Ee += E_local;
+
+  populate_array();
+  timer.lap(EPH_Timer::OTHER);
+}
+
+double FixEPH::deposit_energy() {
   double **x = atom->x;
   double **v = atom->v;
-  int *type = atom->type;
   int *mask = atom->mask;
   int nlocal = atom->nlocal;
 
@@ -385,19 +547,13 @@ void FixEPH::end_of_step() {
     }
   }
 
-  if(eph_flag & Flag::FDM) {
-    fdm.solve();
-  }
-
-  // save heatmap
-  if(myID == 0 && T_freq > 0 && (update->ntimestep % T_freq) == 0) { // TODO: implement a counter instead
-    fdm.save_temperature(T_out, update->ntimestep / T_freq);
-  }
-
-  // this is for checking energy conservation
-  MPI_Allreduce(MPI_IN_PLACE, &E_local, 1, MPI_DOUBLE, MPI_SUM, world);
+  return E_local;
+}
 
-  Ee += E_local;
+void FixEPH::populate_array() {
+  int *type = atom->type;
+  int *mask = atom->mask;
+  int nlocal = atom->nlocal;
 
   for(size_t i = 0; i < nlocal; ++i) {
     if(mask[i] & groupbit) {
@@ -434,13 +590,32 @@ void FixEPH::calculate_environment()
   int *numneigh = list->numneigh;
   int **firstneigh = list->firstneigh;
 
+  // with a half list i also contributes to the density of j, ghosts included
+  const bool half_list = (eph_flag & Flag::HALF_LIST);
+
+  // the neighbour passes of the models reuse the pair geometry and densities and
+  // touch only pairs inside r_cutoff, the list also holds pairs out to r_cutoff + skin;
+  // the full list PRL model keeps them in its W operator instead
+  const bool pair_densities = (eph_model == Model::PRB || eph_model == Model::PRLCM || eph_model == Model::PRL);
+  const bool build_w = (eph_model == Model::PRL && !half_list);
+  const bool cache_pairs = pair_densities && !build_w;
+  pairs.clear();
+  pair_first.resize(nlocal + 1);
+  w_operator.clear();
+  if(half_list) { std::fill_n(&(rho_i[0]), nlocal + atom->nghost, 0); }
+
   // loop over atoms and their neighbours and calculate rho and beta(rho)
   for(size_t i = 0; i != nlocal; ++i)
   {
-    rho_i[i] = 0;
+    if(!half_list) { rho_i[i] = 0; }
+    alpha_rho_i[i] = 0;
+    pair_first[i] = pairs.size();
+    if(build_w) { w_operator.add_row(); }
 
     // check if current atom belongs to fix group and if an atom is local
-    if(mask[i] & groupbit)
+    // (a half list stores the pair only once, so j may be in the group while i is not)
+    const bool i_in_group = (mask[i] & groupbit);
+    if(i_in_group || half_list)
     {
       int itype = type[i];
       int *jlist = firstneigh[i];
@@ -451,17 +626,69 @@ void FixEPH::calculate_environment()
         jj &= NEIGHMASK;
 
         int jtype = type[jj];
-        double r_sq = get_distance_sq(x[jj], x[i]);
+        double e_ij[3];
+        double r_sq = get_difference_sq(x[jj], x[i], e_ij);
 
         if(r_sq < r_cutoff_sq)
         {
-          rho_i[i] += beta.get_rho_r_sq(type_map[jtype-1], r_sq);
+          double v_rho_ji = beta.get_rho_r_sq(type_map[jtype-1], r_sq);
+          if(i_in_group) { rho_i[i] += v_rho_ji; }
+
+          double v_rho_ij = 0;
+          if(pair_densities) { v_rho_ij = beta.get_rho_r_sq(type_map[itype-1], r_sq); }
+          if(half_list && (mask[jj] & groupbit)) { rho_i[jj] += v_rho_ij; }
+
+          if(cache_pairs)
+          {
+            Pair pair;
+            pair.j = jj;
+            pair.e_ij[0] = e_ij[0];
+            pair.e_ij[1] = e_ij[1];
+            pair.e_ij[2] = e_ij[2];
+            pair.inv_r_sq = 1.0 / r_sq;
+            pair.rho_ji = v_rho_ji;
+            pair.rho_ij = v_rho_ij;
+            pairs.push_back(pair);
+          }
+
+          // W_ij without alpha(rho) / rho, see force_prl()
+          if(build_w)
+          {
+            double inv_r_sq = 1.0 / r_sq;
+            w_operator.add_pair(jj, e_ij, v_rho_ji * inv_r_sq, v_rho_ij * inv_r_sq);
+          }
         }
       }
+
+      // prefactor used by every neighbour of i
+      if(!half_list && rho_i[i] > 0) { alpha_rho_i[i] = beta.get_alpha(type_map[itype - 1], rho_i[i]) / rho_i[i]; }
+    }
+  }
+
+  pair_first[nlocal] = pairs.size();
+
+  if(half_list)
+  {
+    // rho_i is complete only after the ghost contributions are added to their owners
+    timer.lap(EPH_Timer::ENVIRONMENT);
+    state = FixState::RHO;
+    comm->reverse_comm(this);
+    timer.lap(EPH_Timer::COMM_REVERSE);
+
+    for(size_t i = 0; i != nlocal; ++i)
+    {
+      if(rho_i[i] > 0) { alpha_rho_i[i] = beta.get_alpha(type_map[type[i] - 1], rho_i[i]) / rho_i[i]; }
     }
   }
 }
 
+/*
+ * The force kernels are templates over the friction and random terms and over
+ * a fix group that holds all atoms. Disabled terms and the group test vanish
+ * at compile time and the friction and random parts share one atom or pair
+ * loop wherever no communication separates them.
+ */
+template<bool friction, bool random, bool group_all>
 void FixEPH::force_ttm()
 {
   double **x = atom->x;
@@ -470,35 +697,32 @@ void FixEPH::force_ttm()
   int *type = atom->type;
   int nlocal = atom->nlocal;
 
-  // create friction forces
-  if(eph_flag & Flag::FRICTION) {
-    for(size_t i = 0; i < nlocal; ++i) {
-      if(mask[i] & groupbit) {
-        int itype = type[i];
-        double var = -beta.get_beta(type_map[itype - 1], rho_i[i]);
+  for(size_t i = 0; i < nlocal; ++i) {
+    if(!(group_all || (mask[i] & groupbit))) continue;
 
-        f_EPH[i][0] = var * v[i][0];
-        f_EPH[i][1] = var * v[i][1];
-        f_EPH[i][2] = var * v[i][2];
-      }
+    int itype = type[i];
+
+    // create friction forces
+    if(friction) {
+      double var = -beta.get_beta(type_map[itype - 1], rho_i[i]);
+
+      f_EPH[i][0] = var * v[i][0];
+      f_EPH[i][1] = var * v[i][1];
+      f_EPH[i][2] = var * v[i][2];
     }
-  }
 
-  // create random forces
-  if(eph_flag & Flag::RANDOM) {
-    for(size_t i = 0; i < nlocal; ++i) {
-      if(mask[i] & groupbit) {
-        int itype = type[i];
-        double v_Te = fdm.get_T(x[i][0], x[i][1], x[i][2]);
-        double var = eta_factor * beta.get_alpha(type_map[itype - 1], rho_i[i]) * sqrt(v_Te);
-        f_RNG[i][0] = var * xi_i[i][0];
-        f_RNG[i][1] = var * xi_i[i][1];
-        f_RNG[i][2] = var * xi_i[i][2];
-      }
+    // create random forces
+    if(random) {
+      double v_Te = fdm.get_T(x[i][0], x[i][1], x[i][2]);
+      double var = eta_factor * beta.get_alpha(type_map[itype - 1], rho_i[i]) * sqrt(v_Te);
+      f_RNG[i][0] = var * xi_i[i][0];
+      f_RNG[i][1] = var * xi_i[i][1];
+      f_RNG[i][2] = var * xi_i[i][2];
     }
   }
 }
 
+template<bool friction, bool random, bool group_all>
 void FixEPH::force_prb()
 {
   double **x = atom->x;
@@ -507,63 +731,50 @@ void FixEPH::force_prb()
   int *mask = atom->mask;
   int nlocal = atom->nlocal;
 
-  int *numneigh = list->numneigh;
-  int **firstneigh = list->firstneigh;
-
-  // create friction forces
-  if(eph_flag & Flag::FRICTION) {
-    for(size_t i = 0; i < nlocal; ++i) {
-      if(mask[i] & groupbit) {
-        int itype = type[i];
-        int *jlist = firstneigh[i];
-        int jnum = numneigh[i];
-
-        if(!(rho_i[i] > 0)) continue;
+  // neighbour loops go over the pairs cached in calculate_environment()
+  const Pair* pair = pairs.data();
 
-        f_EPH[i][0] = v[i][0];
-        f_EPH[i][1] = v[i][1];
-        f_EPH[i][2] = v[i][2];
+  for(size_t i = 0; i < nlocal; ++i) {
+    if(!(group_all || (mask[i] & groupbit))) continue;
 
-        for(size_t j = 0; j < jnum; ++j) {
-          int jj = jlist[j];
-          jj &= NEIGHMASK;
-          int jtype = type[jj];
+    int itype = type[i];
 
-          double r_sq = get_distance_sq(x[jj], x[i]);
+    // create friction forces
+    if(friction && rho_i[i] > 0) {
+      double inv_rho = 1.0 / rho_i[i];
 
-          if(r_sq < r_cutoff_sq) {
-            double var = beta.get_rho(jtype - 1, sqrt(r_sq)) / rho_i[i];
+      f_EPH[i][0] = v[i][0];
+      f_EPH[i][1] = v[i][1];
+      f_EPH[i][2] = v[i][2];
 
-            f_EPH[i][0] -= var * v[jj][0];
-            f_EPH[i][1] -= var * v[jj][1];
-            f_EPH[i][2] -= var * v[jj][2];
-          }
-        }
+      for(size_t p = pair_first[i]; p != pair_first[i + 1]; ++p) {
+        int jj = pair[p].j;
+        double var = pair[p].rho_ji * inv_rho;
 
-        double var = beta.get_beta(type_map[itype - 1], rho_i[i]);
-        f_EPH[i][0] *= var;
-        f_EPH[i][1] *= var;
-        f_EPH[i][2] *= var;
+        f_EPH[i][0] -= var * v[jj][0];
+        f_EPH[i][1] -= var * v[jj][1];
+        f_EPH[i][2] -= var * v[jj][2];
       }
+
+      double var = beta.get_beta(type_map[itype - 1], rho_i[i]);
+      f_EPH[i][0] *= var;
+      f_EPH[i][1] *= var;
+      f_EPH[i][2] *= var;
     }
-  }
 
-  // create random forces
-  if(eph_flag & Flag::RANDOM) {
-    for(size_t i = 0; i < nlocal; i++) {
-      if(mask[i] & groupbit) {
-        int itype = type[i];
-        double v_Te = fdm.get_T(x[i][0], x[i][1], x[i][2]);
-        double var = eta_factor * beta.get_alpha(type_map[itype - 1], rho_i[i]) * sqrt(v_Te);
+    // create random forces
+    if(random) {
+      double v_Te = fdm.get_T(x[i][0], x[i][1], x[i][2]);
+      double var = eta_factor * beta.get_alpha(type_map[itype - 1], rho_i[i]) * sqrt(v_Te);
 
-        f_RNG[i][0] = var * xi_i[i][0];
-        f_RNG[i][1] = var * xi_i[i][1];
-        f_RNG[i][2] = var * xi_i[i][2];
-      }
+      f_RNG[i][0] = var * xi_i[i][0];
+      f_RNG[i][1] = var * xi_i[i][1];
+      f_RNG[i][2] = var * xi_i[i][2];
     }
   }
 }
 
+template<bool friction, bool random, bool group_all>
 void FixEPH::force_prlcm() {
   double **x = atom->x;
   double **v = atom->v;
@@ -571,319 +782,400 @@ void FixEPH::force_prlcm() {
   int *mask = atom->mask;
   int nlocal = atom->nlocal;
 
-  int *numneigh = list->numneigh;
-  int **firstneigh = list->firstneigh;
+  // neighbour loops go over the pairs cached in calculate_environment()
+  const Pair* pair = pairs.data();
 
-  // create friction forces
-  if(eph_flag & Flag::FRICTION) {
+  // w_i of the friction has to reach the ghosts before the forces
+  if(friction) {
     for(size_t i = 0; i < nlocal; ++i) {
-      if(mask[i] & groupbit) {
-        int itype = type[i];
-        int *jlist = firstneigh[i];
-        int jnum = numneigh[i];
+      if(!(group_all || (mask[i] & groupbit))) continue;
 
-        double alpha_i = beta.get_alpha(type_map[itype - 1], rho_i[i]);
-        w_i[i][0] = alpha_i * v[i][0];
-        w_i[i][1] = alpha_i * v[i][1];
-        w_i[i][2] = alpha_i * v[i][2];
+      int itype = type[i];
 
-        for(size_t j = 0; j < jnum; ++j) {
-          int jj = jlist[j];
-          jj &= NEIGHMASK;
-          int jtype = type[jj];
+      double alpha_i = beta.get_alpha(type_map[itype - 1], rho_i[i]);
+      w_i[i][0] = alpha_i * v[i][0];
+      w_i[i][1] = alpha_i * v[i][1];
+      w_i[i][2] = alpha_i * v[i][2];
 
-          double r_sq = get_distance_sq(x[jj], x[i]);
+      if(!(rho_i[i] > 0.0)) continue;
 
-          if (r_sq < r_cutoff_sq && rho_i[i] > 0.0) {
-            double var = alpha_i * beta.get_rho(jtype-i, sqrt(r_sq)) / rho_i[i];
+      double inv_rho = 1.0 / rho_i[i];
 
-            w_i[i][0] -= var * v[jj][0];
-            w_i[i][1] -= var * v[jj][1];
-            w_i[i][2] -= var * v[jj][2];
-          }
-        }
+      for(size_t p = pair_first[i]; p != pair_first[i + 1]; ++p) {
+        int jj = pair[p].j;
+        double var = alpha_i * pair[p].rho_ji * inv_rho;
+
+        w_i[i][0] -= var * v[jj][0];
+        w_i[i][1] -= var * v[jj][1];
+        w_i[i][2] -= var * v[jj][2];
       }
     }
+    timer.lap(EPH_Timer::W_PASS);
 
     state = FixState::WI;
     comm->forward_comm(this);
+    timer.lap(EPH_Timer::COMM_W);
+  }
 
-    // now calculate the forces
-    for(size_t i = 0; i < nlocal; ++i) {
-      if(mask[i] & groupbit) {
-        int itype = type[i];
-        int *jlist = firstneigh[i];
-        int jnum = numneigh[i];
+  // now calculate the friction and random forces
+  for(size_t i = 0; i < nlocal; ++i) {
+    if(!(group_all || (mask[i] & groupbit))) continue;
+
+    int itype = type[i];
+
+    double alpha_i = beta.get_alpha(type_map[itype - 1], rho_i[i]);
 
-        double alpha_i = beta.get_alpha(type_map[itype - 1], rho_i[i]);
-        f_EPH[i][0] = alpha_i * w_i[i][0];
-        f_EPH[i][1] = alpha_i * w_i[i][1];
-        f_EPH[i][2] = alpha_i * w_i[i][2];
+    if(friction) {
+      f_EPH[i][0] = alpha_i * w_i[i][0];
+      f_EPH[i][1] = alpha_i * w_i[i][1];
+      f_EPH[i][2] = alpha_i * w_i[i][2];
+    }
 
-        for(size_t j = 0; j < jnum; ++j) {
-          int jj = jlist[j];
-          jj &= NEIGHMASK;
-          int jtype = type[jj];
+    if(random) {
+      f_RNG[i][0] = alpha_i * xi_i[i][0];
+      f_RNG[i][1] = alpha_i * xi_i[i][1];
+      f_RNG[i][2] = alpha_i * xi_i[i][2];
+    }
 
-          double r_sq = get_distance_sq(x[jj], x[i]);
+    for(size_t p = pair_first[i]; p != pair_first[i + 1]; ++p) {
+      int jj = pair[p].j;
 
-          if(r_sq < r_cutoff_sq && rho_i[jj] > 0.0) {
-            double alpha_j = beta.get_alpha(type_map[jtype - 1], rho_i[jj]); // switch formalism to alpha everywhere to avoid unnecessary sqrt
-            double var = alpha_j * beta.get_rho(itype - 1, sqrt(r_sq)) / rho_i[jj];
+      if(!(rho_i[jj] > 0.0)) continue;
 
-            f_EPH[i][0] -= var * w_i[jj][0];
-            f_EPH[i][1] -= var * w_i[jj][1];
-            f_EPH[i][2] -= var * w_i[jj][2];
-          }
-        }
+      double var = alpha_rho_i[jj] * pair[p].rho_ij;
+
+      if(friction) {
+        f_EPH[i][0] -= var * w_i[jj][0];
+        f_EPH[i][1] -= var * w_i[jj][1];
+        f_EPH[i][2] -= var * w_i[jj][2];
+      }
+
+      if(random) {
+        f_RNG[i][0] -= var * xi_i[jj][0];
+        f_RNG[i][1] -= var * xi_i[jj][1];
+        f_RNG[i][2] -= var * xi_i[jj][2];
       }
     }
+
+    if(random) {
+      double v_Te = fdm.get_T(x[i][0], x[i][1], x[i][2]);
+      double var = eta_factor * sqrt(v_Te);
+      f_RNG[i][0] *= var;
+      f_RNG[i][1] *= var;
+      f_RNG[i][2] *= var;
+    }
   }
+}
 
-  // create random forces
-  if(eph_flag & Flag::RANDOM) {
-    for(size_t i = 0; i < nlocal; ++i) {
-      if(mask[i] & groupbit) {
-        int itype = type[i];
-        int *jlist = firstneigh[i];
-        int jnum = numneigh[i];
+template<bool friction, bool random, bool group_all>
+void FixEPH::force_prl()
+{
+  double **x = atom->x;
+  double **v = atom->v;
+  int *mask = atom->mask;
+  int nlocal = atom->nlocal;
 
-        double var = beta.get_alpha(type_map[itype - 1], rho_i[i]);
+  // W couples to the ghosts through their alpha_rho_i, known after the RHO communication;
+  // all passes apply this operator
+  w_operator.assemble(alpha_rho_i);
 
-        f_RNG[i][0] = var * xi_i[i][0];
-        f_RNG[i][1] = var * xi_i[i][1];
-        f_RNG[i][2] = var * xi_i[i][2];
+  // w_i of the friction has to reach the ghosts before the forces
+  if(friction)
+  {
+    // w_i = W_ij^T v_j
+    w_operator.apply_transpose(v, w_i);
+    timer.lap(EPH_Timer::W_PASS);
 
-        for(size_t j = 0; j < jnum; ++j) {
-          int jj = jlist[j];
-          jj &= NEIGHMASK;
-          int jtype = type[jj];
+    state = FixState::WI;
+    comm->forward_comm(this);
+    timer.lap(EPH_Timer::COMM_W);
+  }
 
-          double r_sq = get_distance_sq(x[jj], x[i]);
+  // f_i = W_ij w_j and f_i = W_ij xi_j
+  if(friction && random) w_operator.apply(w_i, f_EPH, xi_i, f_RNG);
+  else if(friction) w_operator.apply(w_i, f_EPH);
+  else if(random) w_operator.apply(xi_i, f_RNG);
 
-          if(r_sq < r_cutoff_sq && rho_i[jj] > 0) {
-            double var = beta.get_alpha(type_map[jtype - 1], rho_i[jj]);
-            var *= beta.get_rho(itype - 1, sqrt(r_sq)) / rho_i[jj];
+  for(size_t i = 0; i != nlocal; ++i)
+  {
+    if(!(group_all || (mask[i] & groupbit))) continue;
+    if(!(rho_i[i] > 0)) continue;
 
-            f_RNG[i][0] -= var * xi_i[jj][0];
-            f_RNG[i][1] -= var * xi_i[jj][1];
-            f_RNG[i][2] -= var * xi_i[jj][2];
-          }
-        }
+    // friction is negative!
+    if(friction)
+    {
+      f_EPH[i][0] = -f_EPH[i][0];
+      f_EPH[i][1] = -f_EPH[i][1];
+      f_EPH[i][2] = -f_EPH[i][2];
+    }
 
-        double v_Te = fdm.get_T(x[i][0], x[i][1], x[i][2]);
-        var = eta_factor * sqrt(v_Te);
-        f_RNG[i][0] *= var;
-        f_RNG[i][1] *= var;
-        f_RNG[i][2] *= var;
-      }
+    if(random)
+    {
+      double v_Te = fdm.get_T(x[i][0], x[i][1], x[i][2]);
+      double var = eta_factor * sqrt(v_Te);
+      f_RNG[i][0] *= var;
+      f_RNG[i][1] *= var;
+      f_RNG[i][2] *= var;
     }
   }
 }
 
-void FixEPH::force_prl()
+template<bool friction, bool random, bool group_all>
+void FixEPH::force_prl_half()
 {
   double **x = atom->x;
   double **v = atom->v;
-  int *type = atom->type;
   int *mask = atom->mask;
   int nlocal = atom->nlocal;
 
-  int *numneigh = list->numneigh;
-  int **firstneigh = list->firstneigh;
+  // every pair is cached once; both atoms are updated and the ghost parts are
+  // summed back to their owners, e_ji = -e_ij gives the terms of the j side
+  const Pair* pair = pairs.data();
 
-  // create friction forces
-  if(eph_flag & Flag::FRICTION)
+  // w_i of the friction has to be complete on owners and ghosts before the forces
+  if(friction)
   {
     // w_i = W_ij^T v_j
     for(size_t i = 0; i != nlocal; ++i)
     {
-      if(mask[i] & groupbit) {
-        int itype = type[i];
-        int *jlist = firstneigh[i];
-        int jnum = numneigh[i];
-
-        if(!(rho_i[i] > 0)) continue;
+      for(size_t p = pair_first[i]; p != pair_first[i + 1]; ++p)
+      {
+        int jj = pair[p].j;
+        const double* e_ij = pair[p].e_ij;
 
-        double alpha_i = beta.get_alpha(type_map[itype - 1], rho_i[i]);
+        // W couples only atoms that both have a density, as EPH_BlockCSR::assemble()
+        if(!(rho_i[i] > 0) || !(rho_i[jj] > 0)) continue;
 
-        for(size_t j = 0; j != jnum; ++j)
+        // term of i
         {
-          int jj = jlist[j];
-          jj &= NEIGHMASK;
-          int jtype = type[jj];
-
-          // calculate the e_ij vector TODO: change these
-          double e_ij[3];
-          double e_r_sq = get_difference_sq(x[jj], x[i], e_ij);
-
-          // first sum
-          if(e_r_sq >= r_cutoff_sq) continue;
-
-          double v_rho_ji = beta.get_rho_r_sq(type_map[jtype - 1], e_r_sq);
-          double prescaler = alpha_i * v_rho_ji / (rho_i[i] * e_r_sq);
+          double prescaler = alpha_rho_i[i] * pair[p].rho_ji * pair[p].inv_r_sq;
 
-          double e_v_v1 = get_scalar(e_ij, v[i]);
-          double var1 = prescaler * e_v_v1;
-
-          double e_v_v2 = get_scalar(e_ij, v[jj]);
-          double var2 = prescaler * e_v_v2;
+          double var1 = prescaler * get_scalar(e_ij, v[i]);
+          double var2 = prescaler * get_scalar(e_ij, v[jj]);
 
           double dvar = var1 - var2;
           w_i[i][0] += dvar * e_ij[0];
           w_i[i][1] += dvar * e_ij[1];
           w_i[i][2] += dvar * e_ij[2];
         }
+
+        // term of j
+        {
+          double prescaler = alpha_rho_i[jj] * pair[p].rho_ij * pair[p].inv_r_sq;
+
+          double var1 = prescaler * get_scalar(e_ij, v[jj]);
+          double var2 = prescaler * get_scalar(e_ij, v[i]);
+
+          double dvar = var1 - var2;
+          w_i[jj][0] += dvar * e_ij[0];
+          w_i[jj][1] += dvar * e_ij[1];
+          w_i[jj][2] += dvar * e_ij[2];
+        }
       }
     }
 
+    timer.lap(EPH_Timer::W_PASS);
+
     state = FixState::WI;
+    comm->reverse_comm(this);
+    timer.lap(EPH_Timer::COMM_REVERSE);
     comm->forward_comm(this);
+    timer.lap(EPH_Timer::COMM_W);
+  }
 
-    // now calculate the forces
-    // f_i = W_ij w_j
-    for(size_t i = 0; i != nlocal; ++i) {
-      if(mask[i] & groupbit) {
-        int itype = type[i];
-        int *jlist = firstneigh[i];
-        int jnum = numneigh[i];
+  // now calculate the friction and random forces
+  // f_i = W_ij w_j and f_i = W_ij xi_j
+  for(size_t i = 0; i != nlocal; ++i)
+  {
+    if(!(rho_i[i] > 0)) continue;
 
-        if( not(rho_i[i] > 0) ) continue;
+    for(size_t p = pair_first[i]; p != pair_first[i + 1]; ++p)
+    {
+      int jj = pair[p].j;
+      const double* e_ij = pair[p].e_ij;
 
-        double alpha_i = beta.get_alpha(type_map[itype - 1], rho_i[i]);
+      if(!(rho_i[jj] > 0)) continue;
 
-        for(size_t j = 0; j != jnum; ++j)
-        {
-          int jj = jlist[j];
-          jj &= NEIGHMASK;
-          int jtype = type[jj];
+      if(friction)
+      {
+        double e_v_v1 = get_scalar(e_ij, w_i[i]);
+        double var1 = alpha_rho_i[i] * pair[p].rho_ji * e_v_v1 * pair[p].inv_r_sq;
 
-          // calculate the e_ij vector
-          double e_ij[3];
-          double e_r_sq = get_difference_sq(x[jj], x[i], e_ij);
+        double e_v_v2 = get_scalar(e_ij, w_i[jj]);
+        double var2 = alpha_rho_i[jj] * pair[p].rho_ij * e_v_v2 * pair[p].inv_r_sq;
 
-          if(e_r_sq >= r_cutoff_sq or not(rho_i[jj] > 0)) continue;
+        double dvar = var1 - var2;
+        // friction is negative!
+        f_EPH[i][0] -= dvar * e_ij[0];
+        f_EPH[i][1] -= dvar * e_ij[1];
+        f_EPH[i][2] -= dvar * e_ij[2];
 
-          double alpha_j = beta.get_alpha(type_map[jtype - 1], rho_i[jj]);
+        f_EPH[jj][0] += dvar * e_ij[0];
+        f_EPH[jj][1] += dvar * e_ij[1];
+        f_EPH[jj][2] += dvar * e_ij[2];
+      }
 
-          double v_rho_ji = beta.get_rho_r_sq(type_map[jtype - 1], e_r_sq);
-          double e_v_v1 = get_scalar(e_ij, w_i[i]);
-          double var1 = alpha_i * v_rho_ji * e_v_v1 / (rho_i[i] * e_r_sq);
+      if(random)
+      {
+        double e_v_xi1 = get_scalar(e_ij, xi_i[i]);
+        double var1 = alpha_rho_i[i] * pair[p].rho_ji * e_v_xi1 * pair[p].inv_r_sq;
 
-          double v_rho_ij = beta.get_rho_r_sq(type_map[itype - 1], e_r_sq);
-          double e_v_v2 = get_scalar(e_ij, w_i[jj]);
-          double var2 = alpha_j * v_rho_ij * e_v_v2 / (rho_i[jj] * e_r_sq);
+        double e_v_xi2 = get_scalar(e_ij, xi_i[jj]);
+        double var2 = alpha_rho_i[jj] * pair[p].rho_ij * e_v_xi2 * pair[p].inv_r_sq;
 
-          double dvar = var1 - var2;
-          // friction is negative!
-          f_EPH[i][0] -= dvar * e_ij[0];
-          f_EPH[i][1] -= dvar * e_ij[1];
-          f_EPH[i][2] -= dvar * e_ij[2];
-        }
+        double dvar = var1 - var2;
+        f_RNG[i][0] += dvar * e_ij[0];
+        f_RNG[i][1] += dvar * e_ij[1];
+        f_RNG[i][2] += dvar * e_ij[2];
+
+        f_RNG[jj][0] -= dvar * e_ij[0];
+        f_RNG[jj][1] -= dvar * e_ij[1];
+        f_RNG[jj][2] -= dvar * e_ij[2];
       }
     }
   }
 
-  // create random forces
-  if(eph_flag & Flag::RANDOM) {
-    for(size_t i = 0; i != nlocal; i++) {
-      if(mask[i] & groupbit) {
-        int itype = type[i];
-        int *jlist = firstneigh[i];
-        int jnum = numneigh[i];
+  timer.lap(EPH_Timer::FORCES);
 
-        if(!(rho_i[i] > 0)) continue;
+  state = FixState::FORCE;
+  comm->reverse_comm(this);
+  timer.lap(EPH_Timer::COMM_REVERSE);
 
-        double alpha_i = beta.get_alpha(type_map[itype - 1], rho_i[i]);
+  // the temperature scaling is per atom so it has to wait for the ghost contributions
+  if(random)
+  {
+    for(size_t i = 0; i != nlocal; ++i)
+    {
+      if(!(group_all || (mask[i] & groupbit))) continue;
+      if(!(rho_i[i] > 0)) continue;
+
+      double v_Te = fdm.get_T(x[i][0], x[i][1], x[i][2]);
+      double var = eta_factor * sqrt(v_Te);
+      f_RNG[i][0] *= var;
+      f_RNG[i][1] *= var;
+      f_RNG[i][2] *= var;
+    }
+  }
+}
 
-        for(size_t j = 0; j != jnum; ++j) {
-          int jj = jlist[j];
-          jj &= NEIGHMASK;
-          int jtype = type[jj];
+void FixEPH::force_none() {}
 
-          // calculate the e_ij vector
-          double e_ij[3];
-          double e_r_sq = get_difference_sq(x[jj], x[i], e_ij);
+void FixEPH::force_testing() {};
 
-          if((e_r_sq >= r_cutoff_sq) || !(rho_i[jj] > 0)) continue;
+// kernel of the selected model for one combination of terms and group
+template<bool friction, bool random, bool group_all>
+FixEPH::ForceKernel FixEPH::get_force_kernel() {
+  switch(eph_model) {
+    case Model::NONE: return &FixEPH::force_none;
+    case Model::TTM: return &FixEPH::force_ttm<friction, random, group_all>;
+    case Model::PRB: return &FixEPH::force_prb<friction, random, group_all>;
+    case Model::PRLCM: return &FixEPH::force_prlcm<friction, random, group_all>;
+    case Model::PRL:
+      if(eph_flag & Flag::HALF_LIST) return &FixEPH::force_prl_half<friction, random, group_all>;
+      return &FixEPH::force_prl<friction, random, group_all>;
+    case Model::TESTING: return &FixEPH::force_testing;
+    default: error->all(FLERR, "FixEPH: unknown model");
+  }
 
-          double alpha_j = beta.get_alpha(type_map[jtype - 1], rho_i[jj]);
+  return nullptr;
+}
 
-          double v_rho_ji = beta.get_rho_r_sq(type_map[jtype - 1], e_r_sq);
-          double e_v_xi1 = get_scalar(e_ij, xi_i[i]);
-          double var1 = alpha_i * v_rho_ji * e_v_xi1 / (rho_i[i] * e_r_sq);
+void FixEPH::select_force_kernel() {
+  const bool friction = (eph_flag & Flag::FRICTION);
+  const bool random = (eph_flag & Flag::RANDOM);
+  const bool group_all = (igroup == 0); // group all is always the first group
 
-          double v_rho_ij = beta.get_rho_r_sq(type_map[itype - 1], e_r_sq);
-          double e_v_xi2 = get_scalar(e_ij, xi_i[jj]);
-          double var2 = alpha_j * v_rho_ij * e_v_xi2 / (rho_i[jj] * e_r_sq);
+  if(friction && random) {
+    force_kernel = group_all ? get_force_kernel<true, true, true>() : get_force_kernel<true, true, false>();
+  }
+  else if(friction) {
+    force_kernel = group_all ? get_force_kernel<true, false, true>() : get_force_kernel<true, false, false>();
+  }
+  else if(random) {
+    force_kernel = group_all ? get_force_kernel<false, true, true>() : get_force_kernel<false, true, false>();
+  }
+  else {
+    force_kernel = group_all ? get_force_kernel<false, false, true>() : get_force_kernel<false, false, false>();
+  }
+}
 
-          double dvar = var1 - var2;
-          f_RNG[i][0] += dvar * e_ij[0];
-          f_RNG[i][1] += dvar * e_ij[1];
-          f_RNG[i][2] += dvar * e_ij[2];
-        }
+// draw xi_i of the local atoms (and of the ghosts with PHILOX) and return the
+// state that forward communication has to send after calculate_environment()
+FixEPH::FixState FixEPH::generate_xi() {
+  int *mask = atom->mask;
+  int nlocal = atom->nlocal;
 
-        double v_Te = fdm.get_T(x[i][0], x[i][1], x[i][2]);
-        double var = eta_factor * sqrt(v_Te);
-        f_RNG[i][0] *= var;
-        f_RNG[i][1] *= var;
-        f_RNG[i][2] *= var;
+  std::fill_n(&(xi_i[0][0]), 3 * nlocal, 0);
+
+  // xi_i travels together with rho_i unless the ghosts draw it themselves
+  FixState comm_state = FixState::RHO;
+
+  if(eph_flag & Flag::RANDOM) {
+    if(eph_flag & Flag::PHILOX) {
+      // xi_i depends only on (seed, tag, step); ghosts draw the numbers of their owners
+      tagint *tag = atom->tag;
+      int ntotal = nlocal + atom->nghost;
+      for(size_t i = 0; i < ntotal; ++i) {
+        if(mask[i] & groupbit) {
+          philox.get_gaussian3(tag[i], update->ntimestep, xi_i[i]);
+        }
+        else {
+          xi_i[i][0] = 0;
+          xi_i[i][1] = 0;
+          xi_i[i][2] = 0;
+        }
+      }
+    }
+    else {
+      // one call for all local atoms, atoms outside of the group get no noise
+      gaussian.fill(&(xi_i[0][0]), 3 * nlocal);
+      for(size_t i = 0; i < nlocal; ++i) {
+        if(!(mask[i] & groupbit)) {
+          xi_i[i][0] = 0;
+          xi_i[i][1] = 0;
+          xi_i[i][2] = 0;
+        }
       }
+
+      comm_state = FixState::RHO | FixState::XI;
     }
   }
-}
 
-void FixEPH::force_testing() {};
+  return comm_state;
+}
 
 void FixEPH::post_force(int vflag) {
   double **f = atom->f;
-  int *mask = atom->mask;
   int nlocal = atom->nlocal;
   int *numneigh = list->numneigh;
 
-  //zero all arrays
-  std::fill_n(&(w_i[0][0]), 3 * nlocal, 0);
-  std::fill_n(&(xi_i[0][0]), 3 * nlocal, 0);
-  std::fill_n(&(f_EPH[0][0]), 3 * nlocal, 0);
-  std::fill_n(&(f_RNG[0][0]), 3 * nlocal, 0);
+  timer.start();
 
-  // generate random forces and distribute them
-  if(eph_flag & Flag::RANDOM) {
-    for(size_t i = 0; i < nlocal; ++i) {
-      if(mask[i] & groupbit) {
-        xi_i[i][0] = random->gaussian();
-        xi_i[i][1] = random->gaussian();
-        xi_i[i][2] = random->gaussian();
-      }
-    }
+  // ghosts collect pair contributions with a half list
+  const int nsum = (eph_flag & Flag::HALF_LIST) ? nlocal + atom->nghost : nlocal;
 
-    state = FixState::XI;
-    comm->forward_comm(this);
-  }
+  //zero all arrays
+  std::fill_n(&(w_i[0][0]), 3 * nsum, 0);
+  std::fill_n(&(f_EPH[0][0]), 3 * nsum, 0);
+  std::fill_n(&(f_RNG[0][0]), 3 * nsum, 0);
+
+  // generate random forces, they are distributed with rho_i
+  FixState comm_state = generate_xi();
+  timer.lap(EPH_Timer::RANDOM);
 
   // calculate the site densities, gradients (future) and beta(rho)
   calculate_environment();
+  timer.lap(EPH_Timer::ENVIRONMENT);
 
-  state = FixState::RHO;
+  state = comm_state;
   comm->forward_comm(this);
+  timer.lap(EPH_Timer::COMM_RHO);
 
   /*
    * we have separated the model specific codes to make it more readable
-   * at the expense of code duplication
+   * at the expense of code duplication; init() selected the kernel
    */
-  switch(eph_model) {
-    case Model::TTM: force_ttm();
-      break;
-    case Model::PRB: force_prb();
-      break;
-    case Model::PRLCM: force_prlcm();
-      break;
-    case Model::PRL: force_prl();
-      break;
-    case Model::TESTING: force_testing();
-      break;
-    default: throw;
-  }
+  (this->*force_kernel)();
 
   // second loop over atoms if needed
   if((eph_flag & Flag::FRICTION) && !(eph_flag & Flag::NOFRICTION)) {
@@ -901,6 +1193,8 @@ void FixEPH::post_force(int vflag) {
       f[i][2] += f_RNG[i][2];
     }
   }
+
+  timer.lap(EPH_Timer::FORCES);
 }
 
 void FixEPH::reset_dt() {
@@ -922,6 +1216,7 @@ void FixEPH::grow_arrays(int ngrow) {
   memory->grow(f_RNG, ngrow, 3,"EPH:fRNG");
 
   memory->grow(rho_i, ngrow, "eph:rho_i");
+  memory->grow(alpha_rho_i, ngrow, "eph:alpha_rho_i");
 
   memory->grow(w_i, ngrow, 3, "eph:w_i");
   memory->grow(xi_i, ngrow, 3, "eph:xi_i");
@@ -940,6 +1235,9 @@ double FixEPH::compute_vector(int i) {
   else if(i == 1) {
     return fdm.get_T_total();
   }
+  else if(i < size_vector) {
+    return timer.total[i - 2];
+  }
 
   return Ee;
 }
@@ -948,24 +1246,84 @@ double FixEPH::compute_vector(int i) {
 int FixEPH::pack_forward_comm(int n, int *list, double *data, int pbc_flag, int *pbc) {
   int m;
   m = 0;
+
+  // every part of a composite state is packed per atom
+  for(size_t i = 0; i < n; ++i) {
+    int j = list[i];
+
+    if(has_state(state, FixState::RHO)) {
+      data[m++] = rho_i[j];
+      data[m++] = alpha_rho_i[j];
+    }
+
+    if(has_state(state, FixState::XI)) {
+      data[m++] = xi_i[j][0];
+      data[m++] = xi_i[j][1];
+      data[m++] = xi_i[j][2];
+    }
+
+    if(has_state(state, FixState::WI)) {
+      data[m++] = w_i[j][0];
+      data[m++] = w_i[j][1];
+      data[m++] = w_i[j][2];
+    }
+  }
+
+  return m;
+}
+
+void FixEPH::unpack_forward_comm(int n, int first, double *data) {
+  int m, last;
+  m = 0;
+  last = first + n;
+
+  for(size_t i = first; i < last; ++i) {
+    if(has_state(state, FixState::RHO)) {
+      rho_i[i] = data[m++];
+      alpha_rho_i[i] = data[m++];
+    }
+
+    if(has_state(state, FixState::XI)) {
+      xi_i[i][0] = data[m++];
+      xi_i[i][1] = data[m++];
+      xi_i[i][2] = data[m++];
+    }
+
+    if(has_state(state, FixState::WI)) {
+      w_i[i][0] = data[m++];
+      w_i[i][1] = data[m++];
+      w_i[i][2] = data[m++];
+    }
+  }
+}
+
+// reverse communication adds the contributions of ghost atoms to their owners
+int FixEPH::pack_reverse_comm(int n, int first, double *data) {
+  int m, last;
+  m = 0;
+  last = first + n;
+
   switch(state) {
     case FixState::RHO:
-      for(size_t i = 0; i < n; ++i) {
-        data[m++] = rho_i[list[i]];
+      for(size_t i = first; i < last; ++i) {
+        data[m++] = rho_i[i];
       }
       break;
-    case FixState::XI:
-      for(size_t i = 0; i < n; ++i) {
-        data[m++] = xi_i[list[i]][0];
-        data[m++] = xi_i[list[i]][1];
-        data[m++] = xi_i[list[i]][2];
+    case FixState::WI:
+      for(size_t i = first; i < last; ++i) {
+        data[m++] = w_i[i][0];
+        data[m++] = w_i[i][1];
+        data[m++] = w_i[i][2];
       }
       break;
-    case FixState::WI:
-      for(size_t i = 0; i < n; ++i) {
-        data[m++] = w_i[list[i]][0];
-        data[m++] = w_i[list[i]][1];
-        data[m++] = w_i[list[i]][2];
+    case FixState::FORCE:
+      for(size_t i = first; i < last; ++i) {
+        data[m++] = f_EPH[i][0];
+        data[m++] = f_EPH[i][1];
+        data[m++] = f_EPH[i][2];
+        data[m++] = f_RNG[i][0];
+        data[m++] = f_RNG[i][1];
+        data[m++] = f_RNG[i][2];
       }
       break;
     default:
@@ -975,29 +1333,31 @@ int FixEPH::pack_forward_comm(int n, int *list, double *data, int pbc_flag, int
   return m;
 }
 
-void FixEPH::unpack_forward_comm(int n, int first, double *data) {
-  int m, last;
+void FixEPH::unpack_reverse_comm(int n, int *list, double *data) {
+  int m;
   m = 0;
-  last = first + n;
 
   switch(state) {
     case FixState::RHO:
-      for(size_t i = first; i < last; ++i) {
-        rho_i[i] = data[m++];
+      for(size_t i = 0; i < n; ++i) {
+        rho_i[list[i]] += data[m++];
       }
       break;
-    case FixState::XI:
-      for(size_t i = first; i < last; ++i) {
-        xi_i[i][0] = data[m++];
-        xi_i[i][1] = data[m++];
-        xi_i[i][2] = data[m++];
+    case FixState::WI:
+      for(size_t i = 0; i < n; ++i) {
+        w_i[list[i]][0] += data[m++];
+        w_i[list[i]][1] += data[m++];
+        w_i[list[i]][2] += data[m++];
       }
       break;
-    case FixState::WI:
-      for(size_t i = first; i < last; ++i) {
-        w_i[i][0] = data[m++];
-        w_i[i][1] = data[m++];
-        w_i[i][2] = data[m++];
+    case FixState::FORCE:
+      for(size_t i = 0; i < n; ++i) {
+        f_EPH[list[i]][0] += data[m++];
+        f_EPH[list[i]][1] += data[m++];
+        f_EPH[list[i]][2] += data[m++];
+        f_RNG[list[i]][0] += data[m++];
+        f_RNG[list[i]][1] += data[m++];
+        f_RNG[list[i]][2] += data[m++];
       }
       break;
     default:
@@ -1005,15 +1365,111 @@ void FixEPH::unpack_forward_comm(int n, int first, double *data) {
   }
 }
 
-/** TODO **/
 double FixEPH::memory_usage() {
-    double bytes = 0;
+  double bytes = 0;
+
+  for(const auto& component : get_memory_components())
+    bytes += component.second;
+
+  return bytes;
+}
+
+FixEPH::MemoryComponents FixEPH::get_memory_components() {
+  MemoryComponents components;
+
+  // f_EPH, f_RNG, w_i, xi_i and array are 2d arrays with row pointers
+  double atom_bytes = (4 * 3 + 3 + size_peratom_cols) * sizeof(double) + 5 * sizeof(double*);
+  components.emplace_back("Per atom arrays", n * atom_bytes);
+
+  components.emplace_back("Pair cache",
+    pairs.capacity() * sizeof(Pair) + pair_first.capacity() * sizeof(size_t));
+  components.emplace_back("W operator", w_operator.memory_bytes());
+  components.emplace_back("Beta(rho) tables", beta.memory_bytes() + types * sizeof(int));
+  if(shared_tables) components.emplace_back("Node shared tables", shared_tables->memory_bytes());
+  components.emplace_back("FDM grid", fdm.memory_bytes());
+
+  return components;
+}
+
+void FixEPH::print_memory_usage() {
+  MemoryComponents components = get_memory_components();
+  const int n_components = components.size() + 1;
+
+  std::vector<double> bytes(n_components, 0);
+  for(int i = 0; i < n_components - 1; ++i) {
+    bytes[i] = components[i].second;
+    bytes.back() += components[i].second;
+  }
 
-    return bytes;
+  std::vector<double> b_min(n_components);
+  std::vector<double> b_max(n_components);
+  std::vector<double> b_sum(n_components);
+
+  MPI_Reduce(bytes.data(), b_min.data(), n_components, MPI_DOUBLE, MPI_MIN, 0, world);
+  MPI_Reduce(bytes.data(), b_max.data(), n_components, MPI_DOUBLE, MPI_MAX, 0, world);
+  MPI_Reduce(bytes.data(), b_sum.data(), n_components, MPI_DOUBLE, MPI_SUM, 0, world);
+
+  if(myID != 0) return;
+
+  constexpr double mbytes = 1024.0 * 1024.0;
+  char line[128];
+
+  std::cout << "\nFix eph memory usage per rank (Mbytes):\n";
+  snprintf(line, sizeof(line), "%-18s | %10s | %10s | %10s\n", "Component", "min", "avg", "max");
+  std::cout << line;
+
+  for(int i = 0; i < n_components; ++i) {
+    const char* name = i < n_components - 1 ? components[i].first.c_str() : "Total";
+    snprintf(line, sizeof(line), "%-18s | %10.4g | %10.4g | %10.4g\n", name,
+      b_min[i] / mbytes, b_sum[i] / nrPS / mbytes, b_max[i] / mbytes);
+    std::cout << line;
+  }
+
+  std::cout << std::endl;
 }
 
-/* save temperature state after run */
+/* save temperature state after run; the writer finishes the file at the latest when the fix is deleted */
 void FixEPH::post_run() {
-  if(myID == 0) fdm.save_state(T_state);
+  if(myID == 0 || fdm.is_distributed()) fdm.save_state(T_state);
+
+  if(timer.enabled) print_timing();
+}
+
+void FixEPH::print_timing() {
+  constexpr int n_phases = EPH_Timer::N_PHASES;
+
+  double t_min[n_phases];
+  double t_max[n_phases];
+  double t_sum[n_phases];
+
+  MPI_Reduce(timer.total, t_min, n_phases, MPI_DOUBLE, MPI_MIN, 0, world);
+  MPI_Reduce(timer.total, t_max, n_phases, MPI_DOUBLE, MPI_MAX, 0, world);
+  MPI_Reduce(timer.total, t_sum, n_phases, MPI_DOUBLE, MPI_SUM, 0, world);
+
+  if(myID != 0) return;
+
+  double t_total = 0;
+  for(int i = 0; i < n_phases; ++i) { t_total += t_sum[i] / nrPS; }
+
+  char line[128];
+
+  std::cout << "\nFix eph timing breakdown over " << nrPS << " ranks:\n";
+  snprintf(line, sizeof(line), "%-16s | %10s | %10s | %10s | %6s\n",
+    "Phase", "min time", "avg time", "max time", "%total");
+  std::cout << line;
+
+  // phases that never ran are left out
+  for(int i = 0; i < n_phases; ++i) {
+    if(!(t_max[i] > 0)) continue;
+
+    double t_avg = t_sum[i] / nrPS;
+    snprintf(line, sizeof(line), "%-16s | %10.4g | %10.4g | %10.4g | %6.2f\n",
+      EPH_Timer::get_name(i), t_min[i], t_avg, t_max[i],
+      t_total > 0 ? 100.0 * t_avg / t_total : 0.0);
+    std::cout << line;
+  }
+
+  snprintf(line, sizeof(line), "%-16s | %10s | %10.4g | %10s |\n", "Total", "", t_total, "");
+  std::cout << line << std::endl;
 }
 
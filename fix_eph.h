@@ -18,6 +18,8 @@ FixStyle(eph,FixEPH)
 // external headers
 #include <memory>
 #include <vector>
+#include <string>
+#include <utility>
 #include <cstddef>
 
 // lammps headers
@@ -25,19 +27,35 @@ FixStyle(eph,FixEPH)
 
 // internal headers
 #include "eph_beta.h"
+#include "eph_philox.h"
+#include "eph_gaussian.h"
+#include "eph_block_csr.h"
 #include "eph_fdm.h"
+#include "eph_timer.h"
+#include "eph_writer.h"
+#include "eph_shared.h"
 
 namespace LAMMPS_NS {
 
 class FixEPH : public Fix {
  public:
-    // enumeration for tracking fix state, this is used in comm forward
+    // enumeration for tracking fix state, this is used in comm forward and reverse
+    // states are bits; a composite state (e.g. RHO | XI) sends its parts in one message
     enum class FixState : unsigned int {
-      NONE,
-      RHO,
-      XI,
-      WI
+      NONE = 0x00,
+      RHO = 0x01,
+      XI = 0x02,
+      WI = 0x04,
+      FORCE = 0x08 // f_EPH and f_RNG, reverse only
     };
+
+    friend constexpr FixState operator|(FixState a, FixState b) {
+      return static_cast<FixState>(static_cast<unsigned int>(a) | static_cast<unsigned int>(b));
+    }
+
+    static constexpr bool has_state(FixState a, FixState b) {
+      return (static_cast<unsigned int>(a) & static_cast<unsigned int>(b)) != 0;
+    }
     
     // enumeration for selecting fix functionality
     enum Flag : int {
@@ -46,7 +64,16 @@ class FixEPH : public Fix {
       FDM = 0x04,
       NOINT = 0x08, // disable integration
       NOFRICTION = 0x10, // disable effect of friction force
-      NORANDOM = 0x20 // disable effect of random force
+      NORANDOM = 0x20, // disable effect of random force
+      FDM_DISTRIBUTED = 0x40, // solve FDM grid on the lammps domain decomposition
+      FDM_IMPLICIT = 0x80, // solve FDM grid with the implicit ADI scheme
+      HALF_LIST = 0x100, // PRL model on a half neighbour list with reverse communication
+      PHILOX = 0x200, // counter based xi_i keyed by atom tag, no XI communication
+      NOTIMING = 0x400, // disable the timers of the phases
+      BINARY_T = 0x800, // temperature frames in one binary file (float)
+      BINARY_T_DOUBLE = 0x1000, // temperature frames in one binary file (double)
+      BINARY_STATE = 0x2000, // final state of the grid in the binary format
+      NODE_SHARED = 0x4000 // one copy of the beta(rho) tables per node (-DEPH_SHARED_TABLES)
     };
     
     // enumeration for selecting the model for friction
@@ -70,7 +97,7 @@ class FixEPH : public Fix {
     void reset_dt() override; // called by lammps if dt changes
     void grow_arrays(int) override; // called by lammps if number of atoms changes for some task
     double compute_vector(int) override; // called by lammps if a value is requested
-    double memory_usage() override; // prints the memory usage // TODO
+    double memory_usage() override; // bytes of all components on this rank
     void post_run() override; // called by lammps after run ends
     
     /* integrator functionality */
@@ -81,6 +108,8 @@ class FixEPH : public Fix {
     // atoms, reverse communication does the opposite
     int pack_forward_comm(int, int *, double *, int, int *) override;
     void unpack_forward_comm(int, int, double *) override;
+    int pack_reverse_comm(int, int, double *) override;
+    void unpack_reverse_comm(int, int *, double *) override;
   
   protected:
     static constexpr size_t max_file_length = 256; // max filename length
@@ -97,8 +126,10 @@ class FixEPH : public Fix {
     int* type_map; // TODO: type map // change this to vector
     //Container<uint8_t, Allocator<uint8_t> type_map; // type map // change this to vector
     
+    std::shared_ptr<EPH_NodeShared> shared_tables; // node memory viewed by beta, outlives it
     Beta beta; // instance for beta(rho) parametrisation
     EPH_FDM fdm; // electronic FDM grid
+    EPH_Writer writer; // writes the temperature files and the final state in the background
     
     /** integrator functionality **/
     double dtv;
@@ -111,11 +142,13 @@ class FixEPH : public Fix {
     int T_freq; // frequency for printing electronic temperatures to files 
     char T_out[max_file_length]; // this will print temperature heatmap
     char T_state[max_file_length]; // this will store the final state into file
+    std::shared_ptr<EPH_FrameFile> T_frames; // binary temperature frames, task 0 only
     
     double eta_factor; // this is for the conversion from energy/ps -> force
     
     int seed; // seed for random number generator
-    class RanMars *random; // rng
+    EPH_Gaussian gaussian; // batched normal variates for xi_i
+    EPH_Philox philox; // counter based rng keyed by atom tag and timestep
     
     // Neighbor list
     class NeighList *list;
@@ -123,6 +156,9 @@ class FixEPH : public Fix {
     // energy of the electronic system
     double Ee;
     
+    // wall time of the phases on this rank since init()
+    EPH_Timer timer;
+    
     size_t n; // size of peratom arrays
     
     // friction force
@@ -134,8 +170,8 @@ class FixEPH : public Fix {
     // Electronic density at each atom
     double* rho_i; // size = [nlocal] // TODO: try switching to vector
     
-    // Inverse of electronic density in order to avoid 1./rho_i
-    double* inv_rho_i; // size = [nlocal] // TODO: try switching to vector
+    // alpha(rho_i) / rho_i in order to avoid get_alpha() and 1./rho_i per neighbour
+    double* alpha_rho_i; // size = [nlocal + nghost]
     
     // dissipation vector W_ij v_j
     double** w_i; // size = [nlocal][3] // TODO: try switching to vector
@@ -149,12 +185,47 @@ class FixEPH : public Fix {
     // per atom array
     double **array; // size = [nlocal][8] // TODO: try switching to vector
     
+    // neighbour pairs within r_cutoff; built in calculate_environment() for PRB, PRLCM and PRL with HALF_LIST
+    struct Pair {
+      int j; // index of the neighbour
+      double e_ij[3]; // x_j - x_i
+      double inv_r_sq; // 1 / r_ij^2
+      double rho_ji; // rho_j(r_ij), density contribution of j at i
+      double rho_ij; // rho_i(r_ij), density contribution of i at j
+    };
+    
+    std::vector<Pair> pairs; // pairs of all local atoms (every pair once with HALF_LIST)
+    std::vector<size_t> pair_first; // pairs of atom i are [pair_first[i], pair_first[i + 1])
+    
+    // W operator of the PRL model over the local atoms; built once per step in place of the pairs
+    EPH_BlockCSR w_operator;
+    
     // private member functions
-    void calculate_environment(); // calculate the site density and coupling for every atom
-    void force_ttm(); // two temperature model with beta(rho)
-    void force_prb(); // older version with CM correction
-    void force_prlcm(); // PRL model with CM correction
-    void force_prl(); // PRL model with full functionality
+    virtual void calculate_environment(); // calculate the site density and coupling for every atom
+    virtual double deposit_energy(); // insert the work of the forces into the FDM grid, returns the local sum
+    virtual void populate_array(); // populate per atom array with values
+    FixState generate_xi(); // draw xi_i for the random force, returns the state to communicate with rho_i
+    void print_timing(); // print min, avg and max time of the phases over the ranks
+    
+    // bytes held on this rank by every component of the fix
+    using MemoryComponents = std::vector<std::pair<std::string, double>>;
+    virtual MemoryComponents get_memory_components();
+    void print_memory_usage(); // print min, avg and max size of the components over the ranks
+    
+    // force kernels are specialised for the friction and random terms and for a
+    // group holding all atoms; init() selects the one post_force() calls
+    using ForceKernel = void (FixEPH::*)();
+    ForceKernel force_kernel;
+    
+    virtual void select_force_kernel(); // pick the kernel for eph_model, eph_flag and the group
+    template<bool friction, bool random, bool group_all> ForceKernel get_force_kernel();
+    
+    template<bool friction, bool random, bool group_all> void force_ttm(); // two temperature model with beta(rho)
+    template<bool friction, bool random, bool group_all> void force_prb(); // older version with CM correction
+    template<bool friction, bool random, bool group_all> void force_prlcm(); // PRL model with CM correction
+    template<bool friction, bool random, bool group_all> void force_prl(); // PRL model with full functionality
+    template<bool friction, bool random, bool group_all> void force_prl_half(); // PRL model on a half neighbour list
+    void force_none(); // no friction model, only the densities
     void force_testing(); // reserved for testing purposes
     
     // TODO: remove
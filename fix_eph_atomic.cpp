@@ -8,8 +8,10 @@
 #include <cstring> // TODO: remove
 #include <string>
 #include <cstdlib>
+#include <cstdio>
 #include <limits>
 #include <algorithm>
+#include <cmath>
 #include <cassert>
 
 // lammps headers
@@ -20,7 +22,6 @@
 #include "neigh_list.h"
 #include "atom.h"
 #include "memory.h"
-#include "random_mars.h"
 #include "force.h"
 #include "update.h"
 #include "comm.h"
@@ -29,6 +30,7 @@
 #include "fix_eph_atomic.h"
 #include "eph_beta.h"
 #include "eph_kappa.h"
+#include "eph_broadcast.h"
 
 using namespace LAMMPS_NS;
 using namespace FixConst;
@@ -46,7 +48,7 @@ using namespace FixConst;
    * arg[ 4] <- eph parameter; 0 disable all terms; 1 enable friction term; 2 enable random force; 4 enable fde;
    * arg[ 5] <- initial electronic temperature
    * arg[ 6] <- input file for initial temperatures; how do we load temperatures?
-   * arg[ 7] <- number of inner loops n < 1 -> automatic selection
+   * arg[ 7] <- number of inner loops n < 1 -> automatic selection (f_ID[3] loops, f_ID[4] stability)
    * arg[ 8] <- output file for temperatures
    * arg[ 9] <- input file for eph model functions
    * arg[10] <- input file for kappa model functions
@@ -74,7 +76,7 @@ FixEPHAtomic::FixEPHAtomic(LAMMPS *lmp, int narg, char **arg) :
   state = FixState::NONE;
   { // setup fix properties
     vector_flag = 1; // fix is able to output a vector compute
-    size_vector = 2; // 2 elements in the vector
+    size_vector = 4; // 4 elements in the vector
     global_freq = 1; // frequency for vector data
     extvector = 1; // external vector allocated by this fix???
     nevery = 1; // call end_of_step every step
@@ -83,7 +85,7 @@ FixEPHAtomic::FixEPHAtomic(LAMMPS *lmp, int narg, char **arg) :
     peratom_freq = 1; // per atom values are provided every step
     //ghostneigh = 1; // neighbours of neighbours
 
-    comm_forward = 3; // forward communication is needed
+    comm_forward = 7; // forward communication is needed, at most RHO | XI | EI
     //~ comm_forward = 1; // forward communication is needed
     comm->ghost_velocity = 1; // special: fix requires velocities for ghost atoms
   }
@@ -95,6 +97,7 @@ FixEPHAtomic::FixEPHAtomic(LAMMPS *lmp, int narg, char **arg) :
     w_i = nullptr;
 
     rho_i = nullptr;
+    alpha_rho_i = nullptr;
     array = nullptr;
 
     xi_i = nullptr;
@@ -103,6 +106,7 @@ FixEPHAtomic::FixEPHAtomic(LAMMPS *lmp, int narg, char **arg) :
     E_a_i = nullptr;
     dE_a_i = nullptr;
     T_a_i = nullptr;
+    K_a_i = nullptr;
 
     list = nullptr;
 
@@ -115,6 +119,7 @@ FixEPHAtomic::FixEPHAtomic(LAMMPS *lmp, int narg, char **arg) :
     size_t ntotal = atom->nghost + nlocal;
 
     std::fill_n(&(rho_i[0]), ntotal, 0);
+    std::fill_n(&(alpha_rho_i[0]), ntotal, 0);
     std::fill_n(&(xi_i[0][0]), 3 * ntotal, 0);
     std::fill_n(&(w_i[0][0]), 3 * ntotal, 0);
 
@@ -141,7 +146,8 @@ FixEPHAtomic::FixEPHAtomic(LAMMPS *lmp, int narg, char **arg) :
 
   // initialise rng
   seed = atoi(arg[3]);
-  random = new RanMars(lmp, seed + my_id);
+  gaussian = EPH_Gaussian(seed + my_id);
+  philox = EPH_Philox(seed);
 
   // read model behaviour parameters
   eph_flag = strtol(arg[4], NULL, 0);
@@ -156,15 +162,22 @@ FixEPHAtomic::FixEPHAtomic(LAMMPS *lmp, int narg, char **arg) :
     if(eph_flag & Flag::NOINT) { std::cout << "No integration: ON\n"; }
     if(eph_flag & Flag::NOFRICTION) { std::cout << "No friction application: ON\n"; }
     if(eph_flag & Flag::NORANDOM) { std::cout << "No random application: ON\n"; }
+    if(eph_flag & Flag::PHILOX) { std::cout << "Counter based random numbers: ON\n"; }
     std::cout << '\n';
   }
 
+  if((eph_flag & Flag::PHILOX) && !atom->tag_enable)
+    error->all(FLERR, "FixEPHAtomic: counter based random numbers require atom IDs");
+
   // argument 5  and 6 are handled below
 
   { // setup automagic inner loops or not
     inner_loops = atoi(arg[7]);
 
     if(inner_loops < 1) { inner_loops = 0; }
+    
+    heat_loops = 1;
+    heat_stability = 0.;
   }
 
   { // setup output
@@ -180,8 +193,14 @@ FixEPHAtomic::FixEPHAtomic(LAMMPS *lmp, int narg, char **arg) :
   type_map_beta.resize(types);
   type_map_kappa.resize(types);
 
-  beta = Beta(arg[9]);
-  kappa = Kappa(arg[10]);
+  // task 0 reads the files and broadcasts the knots
+  try {
+    beta = Beta(eph_broadcast_table(arg[9], world));
+    kappa = Kappa(eph_broadcast_table(arg[10], world));
+  }
+  catch(std::runtime_error& e) {
+    error->one(FLERR, e.what());
+  }
 
   if(beta.get_n_elements() < 1) {
     error->all(FLERR, "fix_eph_atomic: no elements found in beta file");
@@ -191,6 +210,9 @@ FixEPHAtomic::FixEPHAtomic(LAMMPS *lmp, int narg, char **arg) :
     error->all(FLERR, "fix_eph_atomic: no elements found in kappa file");
   }
 
+  // one column per element is known only now
+  memory->grow(K_a_i, n, kappa.n_elements, "eph:K_a_i");
+
   r_cutoff = beta.get_r_cutoff();
   r_cutoff_sq = beta.get_r_cutoff_sq();
   rho_cutoff = beta.get_rho_cutoff();
@@ -270,10 +292,10 @@ FixEPHAtomic::FixEPHAtomic(LAMMPS *lmp, int narg, char **arg) :
 
 // destructor
 FixEPHAtomic::~FixEPHAtomic() {
-  delete random;
 
   atom->delete_callback(id, 0);
   memory->destroy(rho_i);
+  memory->destroy(alpha_rho_i);
 
   memory->destroy(array);
 
@@ -286,6 +308,7 @@ FixEPHAtomic::~FixEPHAtomic() {
   memory->destroy(E_a_i);
   memory->destroy(dE_a_i);
   memory->destroy(T_a_i);
+  memory->destroy(K_a_i);
 }
 
 void FixEPHAtomic::init() {
@@ -459,6 +482,7 @@ void FixEPHAtomic::calculate_environment() {
   // loop over atoms and their neighbours and calculate rho and beta(rho)
   for(size_t i = 0; i != nlocal; ++i) {
     rho_i[i] = 0;
+    alpha_rho_i[i] = 0;
     rho_a_i[i] = 0;
 
     // check if current atom belongs to fix group and if an atom is local
@@ -485,6 +509,9 @@ void FixEPHAtomic::calculate_environment() {
           rho_a_i[i] += kappa.rho_r_sq[type_map_kappa[jtype - 1]](r_sq);
         }
       }
+
+      // prefactor used by every neighbour of i
+      if(rho_i[i] > 0) { alpha_rho_i[i] = beta.get_alpha(type_map_beta[itype - 1], rho_i[i]) / rho_i[i]; }
     }
   }
 }
@@ -506,14 +533,11 @@ void FixEPHAtomic::force_prl() {
     // w_i = W_ij^T v_j
     for(size_t i = 0; i != nlocal; ++i) {
       if(mask[i] & groupbit) {
-        int itype = type[i];
         int *jlist = firstneigh[i];
         int jnum = numneigh[i];
 
         if(!(rho_i[i] > 0)) { continue; }
 
-        double alpha_i = beta.get_alpha(type_map_beta[itype - 1], rho_i[i]);
-
         for(size_t j = 0; j != jnum; ++j) {
           int jj = jlist[j];
           jj &= NEIGHMASK;
@@ -529,7 +553,7 @@ void FixEPHAtomic::force_prl() {
           if(e_r_sq >= r_cutoff_sq) { continue; }
 
           double v_rho_ji = beta.get_rho_r_sq(type_map_beta[jtype - 1], e_r_sq);
-          double prescaler = alpha_i * v_rho_ji / (rho_i[i] * e_r_sq);
+          double prescaler = alpha_rho_i[i] * v_rho_ji / e_r_sq;
 
           double e_v_v1 = get_scalar(e_ij, v[i]);
           double var1 = prescaler * e_v_v1;
@@ -558,8 +582,6 @@ void FixEPHAtomic::force_prl() {
 
         if( not(rho_i[i] > 0) ) { continue; }
 
-        double alpha_i = beta.get_alpha(type_map_beta[itype - 1], rho_i[i]);
-
         for(size_t j = 0; j != jnum; ++j) {
           int jj = jlist[j];
           jj &= NEIGHMASK;
@@ -573,15 +595,13 @@ void FixEPHAtomic::force_prl() {
 
           if(e_r_sq >= r_cutoff_sq or not(rho_i[jj] > 0)) { continue; }
           
-          double alpha_j = beta.get_alpha(type_map_beta[jtype - 1], rho_i[jj]);
-
           double v_rho_ji = beta.get_rho_r_sq(type_map_beta[jtype - 1], e_r_sq);
           double e_v_v1 = get_scalar(e_ij, w_i[i]);
-          double var1 = alpha_i * v_rho_ji * e_v_v1 / (rho_i[i] * e_r_sq);
+          double var1 = alpha_rho_i[i] * v_rho_ji * e_v_v1 / e_r_sq;
 
           double v_rho_ij = beta.get_rho_r_sq(type_map_beta[itype - 1], e_r_sq);
           double e_v_v2 = get_scalar(e_ij, w_i[jj]);
-          double var2 = alpha_j * v_rho_ij * e_v_v2 / (rho_i[jj] * e_r_sq);
+          double var2 = alpha_rho_i[jj] * v_rho_ij * e_v_v2 / e_r_sq;
 
           double dvar = var1 - var2;
           double const f_ij[3] = {dvar * e_ij[0], dvar * e_ij[1], dvar * e_ij[2]};
@@ -611,7 +631,6 @@ void FixEPHAtomic::force_prl() {
 
         if(!(rho_i[i] > 0)) { continue; }
 
-        double alpha_i = beta.get_alpha(type_map_beta[itype - 1], rho_i[i]);
         double v_Ti = sqrt(kappa.E_T_atomic[type_map_kappa[itype - 1]].reverse(E_a_i[i][0]));
 
         for(size_t j = 0; j != jnum; ++j) {
@@ -626,18 +645,16 @@ void FixEPHAtomic::force_prl() {
           double e_r_sq = get_difference_sq(x[jj], x[i], e_ij);
 
           if((e_r_sq >= r_cutoff_sq) || !(rho_i[jj] > 0)) { continue; }
-
-          double alpha_j = beta.get_alpha(type_map_beta[jtype - 1], rho_i[jj]);
           
           double v_Tj = sqrt(kappa.E_T_atomic[type_map_kappa[jtype - 1]].reverse(E_a_i[jj][0]));
 
           double v_rho_ji = beta.get_rho_r_sq(type_map_beta[jtype - 1], e_r_sq);
           double e_v_xi1 = get_scalar(e_ij, xi_i[i]);
-          double var1 = v_Ti * alpha_i * v_rho_ji * e_v_xi1 / (rho_i[i] * e_r_sq);
+          double var1 = v_Ti * alpha_rho_i[i] * v_rho_ji * e_v_xi1 / e_r_sq;
 
           double v_rho_ij = beta.get_rho_r_sq(type_map_beta[itype - 1], e_r_sq);
           double e_v_xi2 = get_scalar(e_ij, xi_i[jj]);
-          double var2 = v_Tj * alpha_j * v_rho_ij * e_v_xi2 / (rho_i[jj] * e_r_sq);
+          double var2 = v_Tj * alpha_rho_i[jj] * v_rho_ij * e_v_xi2 / e_r_sq;
           
           double const dvar = eta_factor * (var1 - var2);
           
@@ -657,6 +674,77 @@ void FixEPHAtomic::force_prl() {
   }
 }
 
+void FixEPHAtomic::calculate_temperatures() {
+  int *type = atom->type;
+  int *mask = atom->mask;
+  int ntotal = atom->nlocal + atom->nghost;
+
+  for(size_t j = 0; j < ntotal; ++j) {
+    if(mask[j] & groupbit) {
+      int j_elem = type_map_kappa[type[j] - 1];
+      T_a_i[j] = kappa.E_T_atomic[j_elem].reverse(E_a_i[j][0]);
+      
+      for(size_t k = 0; k < kappa.n_elements; ++k) {
+        K_a_i[j][k] = kappa.get_K_T(j_elem, k)(T_a_i[j]);
+      }
+    }
+  }
+}
+
+/*
+ * heat_solve() updates E_j += 0.5 dt sum_k w_jk (T_k - T_j), so the explicit
+ * step keeps temperatures positive if dt 0.5 sum_k w_jk / C_j < 1 with 
+ * C_j = dE/dT. T_a_i and K_a_i have to be up to date.
+ */
+double FixEPHAtomic::get_max_heat_rate() {
+  double **x = atom->x;
+  int *type = atom->type;
+  int *mask = atom->mask;
+  int nlocal = atom->nlocal;
+
+  int *numneigh = list->numneigh;
+  int **firstneigh = list->firstneigh;
+
+  double rate = 0.;
+
+  for(size_t j = 0; j < nlocal; ++j) {
+    if(!(mask[j] & groupbit)) { continue; }
+    
+    int j_elem = type_map_kappa[type[j] - 1];
+    int *klist = firstneigh[j];
+    int knum = numneigh[j];
+    
+    double const C_j = kappa.E_T_atomic[j_elem].derivative(T_a_i[j]);
+    if(!(C_j > 0.)) { continue; } // no estimate for constant energy
+    
+    double const rho_j {rho_a_i[j]};
+    double w_j {0.};
+    
+    for(size_t k = 0; k != knum; ++k) {
+      int kk = klist[k];
+      kk &= NEIGHMASK;
+      
+      if(!(mask[kk] & groupbit)) {continue;}
+      
+      double e_r_sq = get_distance_sq(x[kk], x[j]);
+      if(e_r_sq >= kappa.r_cutoff_sq) {continue;}
+      
+      int k_elem = type_map_kappa[type[kk] - 1];
+      double const rho_k {rho_a_i[kk]};
+      double const l_K {0.5 * (K_a_i[j][k_elem] + K_a_i[kk][j_elem])};
+      
+      if(rho_j > 0.) {w_j += std::fabs(l_K * kappa.rho_r_sq[k_elem](e_r_sq) / rho_j);}
+      if(rho_k > 0.) {w_j += std::fabs(l_K * kappa.rho_r_sq[j_elem](e_r_sq) / rho_k);}
+    }
+    
+    rate = std::max(rate, 0.5 * w_j / C_j);
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, &rate, 1, MPI_DOUBLE, MPI_MAX, world);
+
+  return rate;
+}
+
 void FixEPHAtomic::heat_solve() {
   double **x = atom->x;
   int *type = atom->type;
@@ -667,16 +755,36 @@ void FixEPHAtomic::heat_solve() {
   int **firstneigh = list->firstneigh;
 
   int loops = 1;
+  double rate = 0.;
 
   // test stability
   if(inner_loops > 0) { loops = inner_loops; } // user defined number of loops
   else { // automatic number of loops
-    double stability = 1.0;
-    loops = 1;
+    calculate_temperatures();
+    rate = get_max_heat_rate();
+    
+    // rate is reduced over all tasks, so they all stop here together
+    if(!std::isfinite(rate)) {
+      error->all(FLERR, "FixEPHAtomic: heat diffusion rate is not finite; check the kappa file and the temperatures");
+    }
+    
+    double l_loops = std::ceil(update->dt * rate / max_heat_stability);
+    if(l_loops > max_heat_loops) {
+      char line[256];
+      snprintf(line, sizeof(line), 
+        "FixEPHAtomic: heat diffusion needs %g loops per step (rate %g, limit %d); decrease dt or set the number of loops",
+        l_loops, rate, max_heat_loops);
+      error->all(FLERR, line);
+    }
+    
+    loops = std::max(1, static_cast<int>(l_loops));
   }
 
   double scaling = 1.0 / static_cast<double>(loops);
   double dt = update->dt * scaling;
+  
+  heat_loops = loops;
+  heat_stability = rate * dt;
 
   for(size_t i = 0; i < loops; ++i) {
     { // add small portion of energy and redistribute temperatures
@@ -698,18 +806,20 @@ void FixEPHAtomic::heat_solve() {
       comm->forward_comm(this);
     }
 
+    calculate_temperatures();
+
     { // solve diffusion a bit
       for(size_t j = 0; j < nlocal; ++j) {
         E_a_i[j][1] = E_a_i[j][0];
         
         if(mask[j] & groupbit) {
           int jtype = type[j];
+          int j_elem = type_map_kappa[jtype - 1];
           int *klist = firstneigh[j];
           int knum = numneigh[j];
           
           double l_dE_j {0.};
-          double l_T_j = kappa.E_T_atomic[type_map_kappa[jtype - 1]].reverse(E_a_i[j][0]);
-          double l_K_j = kappa.K_T_atomic[type_map_kappa[jtype - 1]](l_T_j);
+          double const l_T_j {T_a_i[j]};
           
           double const rho_j {rho_a_i[j]};
           double const rho_j_inv = {1. / rho_a_i[j]};
@@ -721,22 +831,22 @@ void FixEPHAtomic::heat_solve() {
             
             if(!(mask[kk] & groupbit)) {continue;}
             
-            double const rho_k {rho_a_i[kk]};
-            double const rho_k_inv = {1. / rho_a_i[kk]};
-            
-            double l_T_k = kappa.E_T_atomic[type_map_kappa[ktype - 1]].reverse(E_a_i[kk][0]);
-            double l_K_k = kappa.K_T_atomic[type_map_kappa[ktype - 1]](l_T_k);
-            
-            double const l_K {0.5 * (l_K_j + l_K_k)}; // we use average heat conduction
-            double const v_dT {l_T_k - l_T_j};
-            
             double e_jk[3];
             double e_r_sq = get_difference_sq(x[kk], x[j], e_jk);
             
             if(e_r_sq >= kappa.r_cutoff_sq) {continue;}
             
-            double v_rho_j = kappa.rho_r_sq[type_map_kappa[jtype - 1]](e_r_sq);
-            double v_rho_k = kappa.rho_r_sq[type_map_kappa[ktype - 1]](e_r_sq);
+            int k_elem = type_map_kappa[ktype - 1];
+            
+            double const rho_k {rho_a_i[kk]};
+            double const rho_k_inv = {1. / rho_a_i[kk]};
+            
+            // pair resolved conductivities; we use average heat conduction
+            double const l_K {0.5 * (K_a_i[j][k_elem] + K_a_i[kk][j_elem])};
+            double const v_dT {T_a_i[kk] - l_T_j};
+            
+            double v_rho_j = kappa.rho_r_sq[j_elem](e_r_sq);
+            double v_rho_k = kappa.rho_r_sq[k_elem](e_r_sq);
             
             if(rho_j > 0.) {l_dE_j += l_K * v_rho_k * rho_j_inv * v_dT;}
             if(rho_k > 0.) {l_dE_j += l_K * v_rho_j * rho_k_inv * v_dT;}
@@ -774,29 +884,46 @@ void FixEPHAtomic::post_force(int vflag) {
   std::fill_n(&(f_RNG[0][0]), 3 * nlocal, 0);
   std::fill_n(&(dE_a_i[0]), nlocal, 0);
 
-  // TODO: TEMPORARY
-  state = FixState::EI;
-  comm->forward_comm(this);
-  // END TODO
+  // E_a_i of ghosts is first needed in force_prl(); it travels together with
+  // rho_i and, unless the ghosts draw it themselves, xi_i
+  FixState comm_state = FixState::RHO | FixState::EI;
 
   // generate random forces and distribute them
   if(eph_flag & Flag::RANDOM) {
-    for(size_t i = 0; i < nlocal; ++i) {
-      if(mask[i] & groupbit) {
-        xi_i[i][0] = random->gaussian();
-        xi_i[i][1] = random->gaussian();
-        xi_i[i][2] = random->gaussian();
+    if(eph_flag & Flag::PHILOX) {
+      // xi_i depends only on (seed, tag, step); ghosts draw the numbers of their owners
+      tagint *tag = atom->tag;
+      int ntotal = nlocal + atom->nghost;
+      for(size_t i = 0; i < ntotal; ++i) {
+        if(mask[i] & groupbit) {
+          philox.get_gaussian3(tag[i], update->ntimestep, xi_i[i]);
+        }
+        else {
+          xi_i[i][0] = 0;
+          xi_i[i][1] = 0;
+          xi_i[i][2] = 0;
+        }
       }
     }
+    else {
+      // one call for all local atoms, atoms outside of the group get no noise
+      gaussian.fill(&(xi_i[0][0]), 3 * nlocal);
+      for(size_t i = 0; i < nlocal; ++i) {
+        if(!(mask[i] & groupbit)) {
+          xi_i[i][0] = 0;
+          xi_i[i][1] = 0;
+          xi_i[i][2] = 0;
+        }
+      }
 
-    state = FixState::XI;
-    comm->forward_comm(this);
+      comm_state = comm_state | FixState::XI;
+    }
   }
 
   // calculate the site densities, gradients (future) and beta(rho)
   calculate_environment();
 
-  state = FixState::RHO;
+  state = comm_state;
   comm->forward_comm(this);
 
   force_prl();
@@ -837,6 +964,7 @@ void FixEPHAtomic::grow_arrays(int ngrow) {
   memory->grow(f_RNG, ngrow, 3,"eph_atomic:fRNG");
 
   memory->grow(rho_i, ngrow, "eph:rho_i");
+  memory->grow(alpha_rho_i, ngrow, "eph:alpha_rho_i");
 
   memory->grow(w_i, ngrow, 3, "eph:w_i");
   memory->grow(xi_i, ngrow, 3, "eph:xi_i");
@@ -845,6 +973,7 @@ void FixEPHAtomic::grow_arrays(int ngrow) {
   memory->grow(E_a_i, ngrow, 2, "eph:E_a_i"); // TODO: change to 2 dimensions for keeping old data
   memory->grow(dE_a_i, ngrow, "eph:dE_a_i");
   memory->grow(T_a_i, ngrow, "eph:T_a_i");
+  memory->grow(K_a_i, ngrow, std::max<int>(kappa.n_elements, 1), "eph:K_a_i");
 
   // per atom values
   // we need only nlocal elements here
@@ -858,6 +987,12 @@ double FixEPHAtomic::compute_vector(int i) {
   else if(i == 1) {
     return Te;
   }
+  else if(i == 2) {
+    return heat_loops;
+  }
+  else if(i == 3) {
+    return heat_stability;
+  }
 
   return Ee;
 }
@@ -866,34 +1001,32 @@ double FixEPHAtomic::compute_vector(int i) {
 int FixEPHAtomic::pack_forward_comm(int n, int *list, double *data, int pbc_flag, int *pbc) {
   int m;
   m = 0;
-  switch(state) {
-    case FixState::RHO:
-      for(size_t i = 0; i < n; ++i) { // TODO: things can break here in mpi
-        data[m++] = rho_i[list[i]];
-        data[m++] = rho_a_i[list[i]];
-      }
-      break;
-    case FixState::XI:
-      for(size_t i = 0; i < n; ++i) {
-        data[m++] = xi_i[list[i]][0];
-        data[m++] = xi_i[list[i]][1];
-        data[m++] = xi_i[list[i]][2];
-      }
-      break;
-    case FixState::WI:
-      for(size_t i = 0; i < n; ++i) {
-        data[m++] = w_i[list[i]][0];
-        data[m++] = w_i[list[i]][1];
-        data[m++] = w_i[list[i]][2];
-      }
-      break;
-    case FixState::EI:
-      for(size_t i = 0; i < n; ++i) {
-        data[m++] = E_a_i[list[i]][0];
-      }
-      break;
-    default:
-      break;
+
+  // every part of a composite state is packed per atom
+  for(size_t i = 0; i < n; ++i) {
+    int j = list[i];
+
+    if(has_state(state, FixState::RHO)) { // TODO: things can break here in mpi
+      data[m++] = rho_i[j];
+      data[m++] = alpha_rho_i[j];
+      data[m++] = rho_a_i[j];
+    }
+
+    if(has_state(state, FixState::XI)) {
+      data[m++] = xi_i[j][0];
+      data[m++] = xi_i[j][1];
+      data[m++] = xi_i[j][2];
+    }
+
+    if(has_state(state, FixState::WI)) {
+      data[m++] = w_i[j][0];
+      data[m++] = w_i[j][1];
+      data[m++] = w_i[j][2];
+    }
+
+    if(has_state(state, FixState::EI)) {
+      data[m++] = E_a_i[j][0];
+    }
   }
 
   return m;
@@ -904,42 +1037,42 @@ void FixEPHAtomic::unpack_forward_comm(int n, int first, double *data) {
   m = 0;
   last = first + n;
 
-  switch(state) {
-    case FixState::RHO:
-      for(size_t i = first; i < last; ++i) {
-        rho_i[i] = data[m++];
-        rho_a_i[i] = data[m++];
-      }
-      break;
-    case FixState::XI:
-      for(size_t i = first; i < last; ++i) {
-        xi_i[i][0] = data[m++];
-        xi_i[i][1] = data[m++];
-        xi_i[i][2] = data[m++];
-      }
-      break;
-    case FixState::WI:
-      for(size_t i = first; i < last; ++i) {
-        w_i[i][0] = data[m++];
-        w_i[i][1] = data[m++];
-        w_i[i][2] = data[m++];
-      }
-      break;
-    case FixState::EI:
-      for(size_t i = first; i < last; ++i) {
-        E_a_i[i][0] = data[m++];
-      }
-      break;
-    default:
-      break;
+  for(size_t i = first; i < last; ++i) {
+    if(has_state(state, FixState::RHO)) {
+      rho_i[i] = data[m++];
+      alpha_rho_i[i] = data[m++];
+      rho_a_i[i] = data[m++];
+    }
+
+    if(has_state(state, FixState::XI)) {
+      xi_i[i][0] = data[m++];
+      xi_i[i][1] = data[m++];
+      xi_i[i][2] = data[m++];
+    }
+
+    if(has_state(state, FixState::WI)) {
+      w_i[i][0] = data[m++];
+      w_i[i][1] = data[m++];
+      w_i[i][2] = data[m++];
+    }
+
+    if(has_state(state, FixState::EI)) {
+      E_a_i[i][0] = data[m++];
+    }
   }
 }
 
 /** TODO **/
 double FixEPHAtomic::memory_usage() {
-    double bytes = 0;
+  // f_EPH, f_RNG, w_i, xi_i, E_a_i, K_a_i and array are 2d arrays with row pointers
+  double atom_bytes = (4 * 3 + 5 + 2 + std::max<int>(kappa.n_elements, 1) + size_peratom_cols) * sizeof(double)
+    + 7 * sizeof(double*);
+
+  double bytes = n * atom_bytes;
+  bytes += (type_map_beta.capacity() + type_map_kappa.capacity()) * sizeof(int);
+  bytes += beta.memory_bytes() + kappa.memory_bytes();
 
-    return bytes;
+  return bytes;
 }
 
 /* save temperature state after run */
@@ -25,6 +25,8 @@ FixStyle(eph/atomic, FixEPHAtomic)
 
 // internal headers
 #include "eph_beta.h"
+#include "eph_philox.h"
+#include "eph_gaussian.h"
 #include "eph_kappa.h"
 
 namespace LAMMPS_NS {
@@ -32,14 +34,23 @@ namespace LAMMPS_NS {
 class FixEPHAtomic : public Fix {
  public:
     // enumeration for tracking fix state, this is used in comm forward
+    // states are bits; a composite state (e.g. RHO | XI | EI) sends its parts in one message
     enum class FixState : unsigned int {
-      NONE,
-      RHO,
-      XI,
-      WI,
-      EI // update temperatures // update energies
+      NONE = 0x00,
+      RHO = 0x01,
+      XI = 0x02,
+      WI = 0x04,
+      EI = 0x08 // update temperatures // update energies
     };
 
+    friend constexpr FixState operator|(FixState a, FixState b) {
+      return static_cast<FixState>(static_cast<unsigned int>(a) | static_cast<unsigned int>(b));
+    }
+
+    static constexpr bool has_state(FixState a, FixState b) {
+      return (static_cast<unsigned int>(a) & static_cast<unsigned int>(b)) != 0;
+    }
+
     // enumeration for selecting fix functionality
     enum Flag : int {
       FRICTION = 0x01,
@@ -47,7 +58,8 @@ class FixEPHAtomic : public Fix {
       HEAT = 0x04,
       NOINT = 0x08, // disable integration
       NOFRICTION = 0x10, // disable effect of friction force
-      NORANDOM = 0x20 // disable effect of random force
+      NORANDOM = 0x20, // disable effect of random force
+      PHILOX = 0x200 // counter based xi_i keyed by atom tag, no XI communication
     };
 
     FixEPHAtomic(class LAMMPS *, int, char **); // constructor
@@ -61,7 +73,7 @@ class FixEPHAtomic : public Fix {
     void reset_dt() override; // called by lammps if dt changes
     void grow_arrays(int) override; // called by lammps if number of atoms changes for some task
     double compute_vector(int) override; // called by lammps if a value is requested
-    double memory_usage() override; // prints the memory usage // TODO
+    double memory_usage() override; // bytes of the per atom arrays and the tables
     void post_run() override; // called by lammps after run ends
     
     /* integrator functionality */
@@ -108,7 +120,8 @@ class FixEPHAtomic : public Fix {
     double kB;
     
     int seed; // seed for random number generator
-    class RanMars *random; // rng
+    EPH_Gaussian gaussian; // batched normal variates for xi_i
+    EPH_Philox philox; // counter based rng keyed by atom tag and timestep
 
     // Neighbor list
     class NeighList *list;
@@ -127,8 +140,8 @@ class FixEPHAtomic : public Fix {
     // electronic density at each atom
     double* rho_i; // size = [nlocal]
 
-    // inverse of electronic density in order to avoid 1./rho_i
-    double* inv_rho_i; // size = [nlocal]
+    // alpha(rho_i) / rho_i in order to avoid get_alpha() and 1./rho_i per neighbour
+    double* alpha_rho_i; // size = [nlocal + nghost]
 
     // dissipation vector W_ij v_j
     double** w_i; // size = [nlocal][3]
@@ -141,8 +154,16 @@ class FixEPHAtomic : public Fix {
     double** E_a_i; // electronic energy per atom placeholder for future
     double* dE_a_i; // energy deposition by stochastic forces
     double* T_a_i; // this is for convenience
+    double** K_a_i; // conductivity K_T(T_a_i) towards every element size = [nlocal + nghost][n_elements]
 
     int inner_loops; // automatic loop selection override
+    int heat_loops; // number of heat diffusion loops in the last step
+    double heat_stability; // loop dt times the largest heat diffusion rate (automatic loops)
+    
+    // automatic loops keep heat_stability below this (1 keeps temperatures positive)
+    static constexpr double max_heat_stability = 0.5;
+    // more automatic loops than this means dt or the kappa file is wrong
+    static constexpr int max_heat_loops = 10000;
 
     // per atom array
     double **array; // size = [nlocal][8]
@@ -151,6 +172,8 @@ class FixEPHAtomic : public Fix {
     void calculate_environment(); // calculate the site density and coupling for every atom
     void force_prl(); // PRL model with full functionality
     void heat_solve(); // atomic heat diffusion solving
+    void calculate_temperatures(); // T_a_i and K_a_i for local and ghost atoms
+    double get_max_heat_rate(); // largest explicit heat diffusion rate over all tasks
     void populate_array(); // populate per atom array with values
 
     // TODO: remove
@@ -20,7 +20,6 @@
 #include "neigh_list.h"
 #include "atom.h"
 #include "memory.h"
-#include "random_mars.h"
 #include "force.h"
 #include "update.h"
 #include "comm.h"
@@ -29,6 +28,7 @@
 #include "fix_eph_coloured.h"
 #include "eph_beta.h"
 #include "eph_fdm.h"
+#include "eph_broadcast.h"
 
 using namespace LAMMPS_NS;
 using namespace FixConst;
@@ -85,12 +85,13 @@ FixEPHColoured::FixEPHColoured(LAMMPS *lmp, int narg, char **arg) :
   peratom_freq = 1; // per atom values are provided every step
   //ghostneigh = 1; // neighbours of neighbours
 
-  comm_forward = 3; // forward communication is needed
+  comm_forward = 5; // forward communication is needed, at most RHO | XI
   comm->ghost_velocity = 1; // special: fix requires velocities for ghost atoms
 
   // initialise rng
   seed = atoi(arg[3]);
-  random = new RanMars(lmp, seed + myID);
+  gaussian = EPH_Gaussian(seed + myID);
+  philox = EPH_Philox(seed);
 
   // read model behaviour parameters
   eph_flag = strtol(arg[4], NULL, 0);
@@ -105,9 +106,13 @@ FixEPHColoured::FixEPHColoured(LAMMPS *lmp, int narg, char **arg) :
     if(eph_flag & Flag::NOINT) std::cout << "No integration: ON\n";
     if(eph_flag & Flag::NOFRICTION) std::cout << "No friction application: ON\n";
     if(eph_flag & Flag::NORANDOM) std::cout << "No random application: ON\n";
+    if(eph_flag & Flag::PHILOX) std::cout << "Counter based random numbers: ON\n";
     std::cout << '\n';
   }
 
+  if((eph_flag & Flag::PHILOX) && !atom->tag_enable)
+    error->all(FLERR, "FixEPHColoured: counter based random numbers require atom IDs");
+
   // read model selection
   eph_model = atoi(arg[5]);
 
@@ -151,7 +156,13 @@ FixEPHColoured::FixEPHColoured(LAMMPS *lmp, int narg, char **arg) :
     strcpy(T_state, "T.restart");
   }
   else {
-    fdm = EPH_FDM(arg[13]);
+    // task 0 reads the state (text or binary) and broadcasts it
+    try {
+      fdm = EPH_FDM(arg[13], world);
+    }
+    catch(std::runtime_error& e) {
+      error->one(FLERR, e.what());
+    }
 
     sprintf(T_state, "%s.restart", arg[13]);
   }
@@ -172,7 +183,13 @@ FixEPHColoured::FixEPHColoured(LAMMPS *lmp, int narg, char **arg) :
 
   type_map = new int[types]; // TODO: switch to vector
 
-  beta = Beta(arg[16]);
+  // task 0 reads the file and broadcasts the knots
+  try {
+    beta = Beta(eph_broadcast_table(arg[16], world));
+  }
+  catch(std::runtime_error& e) {
+    error->one(FLERR, e.what());
+  }
 
   if(beta.get_n_elements() < 1)
     error->all(FLERR, "Fix eph: no elements found in input file");
@@ -206,6 +223,7 @@ FixEPHColoured::FixEPHColoured(LAMMPS *lmp, int narg, char **arg) :
   w_i = nullptr;
 
   rho_i = nullptr;
+  alpha_rho_i = nullptr;
   array = nullptr;
 
   xi_i = nullptr;
@@ -223,6 +241,7 @@ FixEPHColoured::FixEPHColoured(LAMMPS *lmp, int narg, char **arg) :
   size_t ntotal = atom->nghost + nlocal;
 
   std::fill_n(&(rho_i[0]), ntotal, 0);
+  std::fill_n(&(alpha_rho_i[0]), ntotal, 0);
   std::fill_n(&(xi_i[0][0]), 3 * ntotal, 0);
   std::fill_n(&(w_i[0][0]), 3 * ntotal, 0);
 
@@ -238,12 +257,12 @@ FixEPHColoured::FixEPHColoured(LAMMPS *lmp, int narg, char **arg) :
 
 // destructor
 FixEPHColoured::~FixEPHColoured() {
-  delete random;
   delete[] type_map;
 
   atom->delete_callback(id, 0);
 
   memory->destroy(rho_i);
+  memory->destroy(alpha_rho_i);
 
   memory->destroy(array);
 
@@ -437,6 +456,7 @@ void FixEPHColoured::calculate_environment()
   for(size_t i = 0; i != nlocal; ++i)
   {
     rho_i[i] = 0;
+    alpha_rho_i[i] = 0;
 
     // check if current atom belongs to fix group and if an atom is local
     if(mask[i] & groupbit)
@@ -457,6 +477,9 @@ void FixEPHColoured::calculate_environment()
           rho_i[i] += beta.get_rho_r_sq(type_map[jtype-1], r_sq);
         }
       }
+
+      // prefactor used by every neighbour of i
+      if(rho_i[i] > 0) { alpha_rho_i[i] = beta.get_alpha(type_map[itype - 1], rho_i[i]) / rho_i[i]; }
     }
   }
 }
@@ -479,14 +502,11 @@ void FixEPHColoured::force_prl()
     for(size_t i = 0; i != nlocal; ++i)
     {
       if(mask[i] & groupbit) {
-        int itype = type[i];
         int *jlist = firstneigh[i];
         int jnum = numneigh[i];
 
         if(!(rho_i[i] > 0)) continue;
 
-        double alpha_i = beta.get_alpha(type_map[itype - 1], rho_i[i]);
-
         for(size_t j = 0; j != jnum; ++j)
         {
           int jj = jlist[j];
@@ -501,7 +521,7 @@ void FixEPHColoured::force_prl()
           if(e_r_sq >= r_cutoff_sq) continue;
 
           double v_rho_ji = beta.get_rho_r_sq(type_map[jtype - 1], e_r_sq);
-          double prescaler = alpha_i * v_rho_ji / (rho_i[i] * e_r_sq);
+          double prescaler = alpha_rho_i[i] * v_rho_ji / e_r_sq;
 
           double e_v_v1 = get_scalar(e_ij, v[i]);
           double var1 = prescaler * e_v_v1;
@@ -530,8 +550,6 @@ void FixEPHColoured::force_prl()
 
         if( not(rho_i[i] > 0) ) continue;
 
-        double alpha_i = beta.get_alpha(type_map[itype - 1], rho_i[i]);
-
         for(size_t j = 0; j != jnum; ++j)
         {
           int jj = jlist[j];
@@ -544,15 +562,13 @@ void FixEPHColoured::force_prl()
 
           if(e_r_sq >= r_cutoff_sq or not(rho_i[jj] > 0)) continue;
 
-          double alpha_j = beta.get_alpha(type_map[jtype - 1], rho_i[jj]);
-
           double v_rho_ji = beta.get_rho_r_sq(type_map[jtype - 1], e_r_sq);
           double e_v_v1 = get_scalar(e_ij, w_i[i]);
-          double var1 = alpha_i * v_rho_ji * e_v_v1 / (rho_i[i] * e_r_sq);
+          double var1 = alpha_rho_i[i] * v_rho_ji * e_v_v1 / e_r_sq;
 
           double v_rho_ij = beta.get_rho_r_sq(type_map[itype - 1], e_r_sq);
           double e_v_v2 = get_scalar(e_ij, w_i[jj]);
-          double var2 = alpha_j * v_rho_ij * e_v_v2 / (rho_i[jj] * e_r_sq);
+          double var2 = alpha_rho_i[jj] * v_rho_ij * e_v_v2 / e_r_sq;
 
           double dvar = var1 - var2;
           // friction is negative!
@@ -574,8 +590,6 @@ void FixEPHColoured::force_prl()
 
         if(!(rho_i[i] > 0)) continue;
 
-        double alpha_i = beta.get_alpha(type_map[itype - 1], rho_i[i]);
-
         for(size_t j = 0; j != jnum; ++j) {
           int jj = jlist[j];
           jj &= NEIGHMASK;
@@ -587,15 +601,13 @@ void FixEPHColoured::force_prl()
 
           if((e_r_sq >= r_cutoff_sq) || !(rho_i[jj] > 0)) continue;
 
-          double alpha_j = beta.get_alpha(type_map[jtype - 1], rho_i[jj]);
-
           double v_rho_ji = beta.get_rho_r_sq(type_map[jtype - 1], e_r_sq);
           double e_v_xi1 = get_scalar(e_ij, xi_i[i]);
-          double var1 = alpha_i * v_rho_ji * e_v_xi1 / (rho_i[i] * e_r_sq);
+          double var1 = alpha_rho_i[i] * v_rho_ji * e_v_xi1 / e_r_sq;
 
           double v_rho_ij = beta.get_rho_r_sq(type_map[itype - 1], e_r_sq);
           double e_v_xi2 = get_scalar(e_ij, xi_i[jj]);
-          double var2 = alpha_j * v_rho_ij * e_v_xi2 / (rho_i[jj] * e_r_sq);
+          double var2 = alpha_rho_i[jj] * v_rho_ij * e_v_xi2 / e_r_sq;
 
           double dvar = var1 - var2;
           f_RNG[i][0] += dvar * e_ij[0];
@@ -625,24 +637,45 @@ void FixEPHColoured::post_force(int vflag) {
   std::fill_n(&(f_EPH[0][0]), 3 * nlocal, 0);
   std::fill_n(&(f_RNG[0][0]), 3 * nlocal, 0);
 
+  // xi_i travels together with rho_i unless the ghosts draw it themselves
+  FixState comm_state = FixState::RHO;
+
   // generate random forces and distribute them
   if(eph_flag & Flag::RANDOM) {
-    for(size_t i = 0; i < nlocal; ++i) {
-      if(mask[i] & groupbit) {
-        xi_i[i][0] = random->gaussian();
-        xi_i[i][1] = random->gaussian();
-        xi_i[i][2] = random->gaussian();
+    if(eph_flag & Flag::PHILOX) {
+      // xi_i depends only on (seed, tag, step); ghosts draw the numbers of their owners
+      tagint *tag = atom->tag;
+      int ntotal = nlocal + atom->nghost;
+      for(size_t i = 0; i < ntotal; ++i) {
+        if(mask[i] & groupbit) {
+          philox.get_gaussian3(tag[i], update->ntimestep, xi_i[i]);
+        }
+        else {
+          xi_i[i][0] = 0;
+          xi_i[i][1] = 0;
+          xi_i[i][2] = 0;
+        }
       }
     }
+    else {
+      // one call for all local atoms, atoms outside of the group get no noise
+      gaussian.fill(&(xi_i[0][0]), 3 * nlocal);
+      for(size_t i = 0; i < nlocal; ++i) {
+        if(!(mask[i] & groupbit)) {
+          xi_i[i][0] = 0;
+          xi_i[i][1] = 0;
+          xi_i[i][2] = 0;
+        }
+      }
 
-    state = FixState::XI;
-    comm->forward_comm(this);
+      comm_state = FixState::RHO | FixState::XI;
+    }
   }
 
   // calculate the site densities, gradients (future) and beta(rho)
   calculate_environment();
 
-  state = FixState::RHO;
+  state = comm_state;
   comm->forward_comm(this);
 
   /*
@@ -688,6 +721,7 @@ void FixEPHColoured::grow_arrays(int ngrow) {
   memory->grow(f_RNG, ngrow, 3,"EPH:fRNG");
 
   memory->grow(rho_i, ngrow, "eph:rho_i");
+  memory->grow(alpha_rho_i, ngrow, "eph:alpha_rho_i");
 
   memory->grow(w_i, ngrow, 3, "eph:w_i");
   memory->grow(xi_i, ngrow, 3, "eph:xi_i");
@@ -714,58 +748,23 @@ double FixEPHColoured::compute_vector(int i) {
 int FixEPHColoured::pack_forward_comm(int n, int *list, double *data, int pbc_flag, int *pbc) {
   int m;
   m = 0;
-  switch(state) {
-    case FixState::RHO:
-      for(size_t i = 0; i < n; ++i) {
-        data[m++] = rho_i[list[i]];
-      }
-      break;
-    case FixState::XI:
-      for(size_t i = 0; i < n; ++i) {
-        data[m++] = xi_i[list[i]][0];
-        data[m++] = xi_i[list[i]][1];
-        data[m++] = xi_i[list[i]][2];
-      }
-      break;
-    case FixState::XIX:
-      for(size_t i = 0; i < n; ++i) {
-        data[m++] = xi_i[list[i]][0];
-      }
-      break;
-    case FixState::XIY:
-      for(size_t i = 0; i < n; ++i) {
-        data[m++] = xi_i[list[i]][1];
-      }
-      break;
-    case FixState::XIZ:
-      for(size_t i = 0; i < n; ++i) {
-        data[m++] = xi_i[list[i]][2];
-      }
-      break;
-    case FixState::WI:
-      for(size_t i = 0; i < n; ++i) {
-        data[m++] = w_i[list[i]][0];
-        data[m++] = w_i[list[i]][1];
-        data[m++] = w_i[list[i]][2];
-      }
-      break;
-    case FixState::WX:
-      for(size_t i = 0; i < n; ++i) {
-        data[m++] = w_i[list[i]][0];
-      }
-      break;
-    case FixState::WY:
-      for(size_t i = 0; i < n; ++i) {
-        data[m++] = w_i[list[i]][1];
-      }
-      break;
-    case FixState::WZ:
-      for(size_t i = 0; i < n; ++i) {
-        data[m++] = w_i[list[i]][2];
-      }
-      break;
-    default:
-      break;
+
+  // every part of a composite state is packed per atom
+  for(size_t i = 0; i < n; ++i) {
+    int j = list[i];
+
+    if(has_state(state, FixState::RHO)) {
+      data[m++] = rho_i[j];
+      data[m++] = alpha_rho_i[j];
+    }
+
+    if(has_state(state, FixState::XIX)) { data[m++] = xi_i[j][0]; }
+    if(has_state(state, FixState::XIY)) { data[m++] = xi_i[j][1]; }
+    if(has_state(state, FixState::XIZ)) { data[m++] = xi_i[j][2]; }
+
+    if(has_state(state, FixState::WX)) { data[m++] = w_i[j][0]; }
+    if(has_state(state, FixState::WY)) { data[m++] = w_i[j][1]; }
+    if(has_state(state, FixState::WZ)) { data[m++] = w_i[j][2]; }
   }
 
   return m;
@@ -776,63 +775,33 @@ void FixEPHColoured::unpack_forward_comm(int n, int first, double *data) {
   m = 0;
   last = first + n;
 
-  switch(state) {
-    case FixState::RHO:
-      for(size_t i = first; i < last; ++i) {
-        rho_i[i] = data[m++];
-      }
-      break;
-    case FixState::XI:
-      for(size_t i = first; i < last; ++i) {
-        xi_i[i][0] = data[m++];
-        xi_i[i][1] = data[m++];
-        xi_i[i][2] = data[m++];
-      }
-      break;
-    case FixState::XIX:
-      for(size_t i = first; i < last; ++i) {
-        xi_i[i][0] = data[m++];
-      }
-      break;
-    case FixState::XIY:
-      for(size_t i = first; i < last; ++i) {
-        xi_i[i][1] = data[m++];
-      }
-      break;
-    case FixState::XIZ:
-      for(size_t i = first; i < last; ++i) {
-        xi_i[i][2] = data[m++];
-      }
-      break;
-    case FixState::WI:
-      for(size_t i = first; i < last; ++i) {
-        w_i[i][0] = data[m++];
-        w_i[i][1] = data[m++];
-        w_i[i][2] = data[m++];
-      }
-      break;
-    case FixState::WX:
-      for(size_t i = first; i < last; ++i) {
-        w_i[i][0] = data[m++];
-      }
-      break;
-    case FixState::WY:
-      for(size_t i = first; i < last; ++i) {
-        w_i[i][1] = data[m++];
-      }
-      break;
-    case FixState::WZ:
-      for(size_t i = first; i < last; ++i) {
-        w_i[i][2] = data[m++];
-      }
-      break;
-    default:
-      break;
+  for(size_t i = first; i < last; ++i) {
+    if(has_state(state, FixState::RHO)) {
+      rho_i[i] = data[m++];
+      alpha_rho_i[i] = data[m++];
+    }
+
+    if(has_state(state, FixState::XIX)) { xi_i[i][0] = data[m++]; }
+    if(has_state(state, FixState::XIY)) { xi_i[i][1] = data[m++]; }
+    if(has_state(state, FixState::XIZ)) { xi_i[i][2] = data[m++]; }
+
+    if(has_state(state, FixState::WX)) { w_i[i][0] = data[m++]; }
+    if(has_state(state, FixState::WY)) { w_i[i][1] = data[m++]; }
+    if(has_state(state, FixState::WZ)) { w_i[i][2] = data[m++]; }
   }
 }
 
 /** TODO **/
-double FixEPHColoured::memory_usage() { return 0.; }
+double FixEPHColoured::memory_usage() {
+  // f_EPH, f_RNG, w_i, xi_i and array are 2d arrays with row pointers
+  double atom_bytes = (4 * 3 + 3 + size_peratom_cols) * sizeof(double) + 5 * sizeof(double*);
+
+  double bytes = n * atom_bytes;
+  bytes += beta.memory_bytes() + types * sizeof(int);
+  bytes += fdm.memory_bytes();
+
+  return bytes;
+}
 
 /* save temperature state after run */
 void FixEPHColoured::post_run() {
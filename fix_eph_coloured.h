@@ -20,24 +20,35 @@ FixStyle(eph/coloured,FixEPHColoured)
 
 // internal headers
 #include "eph_beta.h"
+#include "eph_philox.h"
+#include "eph_gaussian.h"
 #include "eph_fdm.h"
 
 namespace LAMMPS_NS {
 class FixEPHColoured : public Fix {
  public:
     // enumeration for tracking fix state, this is used in comm forward
+    // states are bits; a composite state (e.g. RHO | XI) sends its parts in one message
     enum class FixState : unsigned int {
-      NONE,
-      XIX,
-      XIY,
-      XIZ,
-      RHO,
-      WX,
-      WY,
-      WZ,
-      XI,
-      WI
+      NONE = 0x00,
+      XIX = 0x01,
+      XIY = 0x02,
+      XIZ = 0x04,
+      RHO = 0x08,
+      WX = 0x10,
+      WY = 0x20,
+      WZ = 0x40,
+      XI = 0x07, // XIX | XIY | XIZ
+      WI = 0x70 // WX | WY | WZ
     };
+
+    friend constexpr FixState operator|(FixState a, FixState b) {
+      return static_cast<FixState>(static_cast<unsigned int>(a) | static_cast<unsigned int>(b));
+    }
+
+    static constexpr bool has_state(FixState a, FixState b) {
+      return (static_cast<unsigned int>(a) & static_cast<unsigned int>(b)) != 0;
+    }
     
     // enumeration for selecting fix functionality
     enum Flag : int {
@@ -46,7 +57,8 @@ class FixEPHColoured : public Fix {
       FDM = 0x04,
       NOINT = 0x08, // disable integration
       NOFRICTION = 0x10, // disable effect of friction force
-      NORANDOM = 0x20 // disable effect of random force
+      NORANDOM = 0x20, // disable effect of random force
+      PHILOX = 0x200 // counter based xi_i keyed by atom tag, no XI communication
     };
     
     FixEPHColoured(class LAMMPS *, int, char **); // constructor
@@ -60,7 +72,7 @@ class FixEPHColoured : public Fix {
     void reset_dt() override; // called by lammps if dt changes
     void grow_arrays(int) override; // called by lammps if number of atoms changes for some task
     double compute_vector(int) override; // called by lammps if a value is requested
-    double memory_usage() override; // prints the memory usage // TODO
+    double memory_usage() override; // bytes of the per atom arrays, the tables and the grid
     void post_run() override; // called by lammps after run ends
     
     /* integrator functionality */
@@ -105,7 +117,8 @@ class FixEPHColoured : public Fix {
     double eta_factor; // this is for the conversion from energy/ps -> force
     
     int seed; // seed for random number generator
-    class RanMars *random; // rng
+    EPH_Gaussian gaussian; // batched normal variates for xi_i
+    EPH_Philox philox; // counter based rng keyed by atom tag and timestep
     
     // Neighbor list
     class NeighList *list;
@@ -124,8 +137,8 @@ class FixEPHColoured : public Fix {
     // Electronic density at each atom
     double* rho_i; // size = [nlocal] // TODO: try switching to vector
     
-    // Inverse of electronic density in order to avoid 1./rho_i
-    double* inv_rho_i; // size = [nlocal] // TODO: try switching to vector
+    // alpha(rho_i) / rho_i in order to avoid get_alpha() and 1./rho_i per neighbour
+    double* alpha_rho_i; // size = [nlocal + nghost]
     
     // dissipation vector W_ij v_j
     double** w_i; // size = [nlocal][3] // TODO: try switching to vector
@@ -29,6 +29,7 @@
 #include "fix_eph_coloured_exp_v1.h"
 #include "eph_beta.h"
 #include "eph_fdm.h"
+#include "eph_broadcast.h"
 
 using namespace LAMMPS_NS;
 using namespace FixConst;
@@ -143,7 +144,13 @@ FixEPHColouredExpV1::FixEPHColouredExpV1(LAMMPS *lmp, int narg, char **arg) :
     strcpy(T_state, "T.restart");
   }
   else {
-    fdm = EPH_FDM(arg[13]);
+    // task 0 reads the state (text or binary) and broadcasts it
+    try {
+      fdm = EPH_FDM(arg[13], world);
+    }
+    catch(std::runtime_error& e) {
+      error->one(FLERR, e.what());
+    }
 
     sprintf(T_state, "%s.restart", arg[13]);
   }
@@ -164,7 +171,13 @@ FixEPHColouredExpV1::FixEPHColouredExpV1(LAMMPS *lmp, int narg, char **arg) :
 
   type_map = new int[types]; // TODO: switch to vector
 
-  beta = Beta(arg[16]);
+  // task 0 reads the file and broadcasts the knots
+  try {
+    beta = Beta(eph_broadcast_table(arg[16], world));
+  }
+  catch(std::runtime_error& e) {
+    error->one(FLERR, e.what());
+  }
 
   if(beta.get_n_elements() < 1) {
     error->all(FLERR, "Fix eph: no elements found in input file");
@@ -202,6 +215,7 @@ FixEPHColouredExpV1::FixEPHColouredExpV1(LAMMPS *lmp, int narg, char **arg) :
   w_i = nullptr;
 
   rho_i = nullptr;
+  alpha_rho_i = nullptr;
   array = nullptr;
 
   xi_i = nullptr;
@@ -222,6 +236,7 @@ FixEPHColouredExpV1::FixEPHColouredExpV1(LAMMPS *lmp, int narg, char **arg) :
   size_t ntotal = atom->nghost + nlocal;
 
   std::fill_n(&(rho_i[0]), ntotal, 0);
+  std::fill_n(&(alpha_rho_i[0]), ntotal, 0);
   std::fill_n(&(xi_i[0][0]), 3 * ntotal, 0);
   std::fill_n(&(zi_i[0][0]), 3 * ntotal, 0);
   
@@ -246,6 +261,7 @@ FixEPHColouredExpV1::~FixEPHColouredExpV1() {
   atom->delete_callback(id, 0);
 
   memory->destroy(rho_i);
+  memory->destroy(alpha_rho_i);
 
   memory->destroy(array);
 
@@ -441,6 +457,7 @@ void FixEPHColouredExpV1::calculate_environment() {
   // loop over atoms and their neighbours and calculate rho and beta(rho)
   for(size_t i = 0; i != nlocal; ++i) {
     rho_i[i] = 0;
+    alpha_rho_i[i] = 0;
 
     // check if current atom belongs to fix group and if an atom is local
     if(mask[i] & groupbit) {
@@ -459,6 +476,9 @@ void FixEPHColouredExpV1::calculate_environment() {
           rho_i[i] += beta.get_rho_r_sq(type_map[jtype-1], r_sq);
         }
       }
+
+      // prefactor used by every neighbour of i
+      if(rho_i[i] > 0) { alpha_rho_i[i] = beta.get_alpha(type_map[itype - 1], rho_i[i]) / rho_i[i]; }
     }
   }
 }
@@ -488,14 +508,11 @@ void FixEPHColouredExpV1::force_prl() {
     // w_i = W_ij^T v_j
     for(size_t i = 0; i < nlocal; ++i) {
       if(mask[i] & groupbit) {
-        int itype = type[i];
         int *jlist = firstneigh[i];
         int jnum = numneigh[i];
 
         if(!(rho_i[i] > 0)) continue;
 
-        double alpha_i = beta.get_alpha(type_map[itype - 1], rho_i[i]);
-
         for(size_t j = 0; j != jnum; ++j) {
           int jj = jlist[j];
           jj &= NEIGHMASK;
@@ -509,7 +526,7 @@ void FixEPHColouredExpV1::force_prl() {
           if(e_r_sq >= r_cutoff_sq) continue;
 
           double v_rho_ji = beta.get_rho_r_sq(type_map[jtype - 1], e_r_sq);
-          double prescaler = alpha_i * v_rho_ji / (rho_i[i] * e_r_sq);
+          double prescaler = alpha_rho_i[i] * v_rho_ji / e_r_sq;
 
           double e_v_v1 = get_scalar(e_ij, zv_i[i]);
           double var1 = prescaler * e_v_v1;
@@ -538,8 +555,6 @@ void FixEPHColouredExpV1::force_prl() {
 
         if(not(rho_i[i] > 0.)) { continue; }
 
-        double alpha_i = beta.get_alpha(type_map[itype - 1], rho_i[i]);
-
         for(size_t j = 0; j != jnum; ++j) {
           int jj = jlist[j];
           jj &= NEIGHMASK;
@@ -551,15 +566,13 @@ void FixEPHColouredExpV1::force_prl() {
 
           if(e_r_sq >= r_cutoff_sq or not(rho_i[jj] > 0)) { continue; }
 
-          double alpha_j = beta.get_alpha(type_map[jtype - 1], rho_i[jj]);
-
           double v_rho_ji = beta.get_rho_r_sq(type_map[jtype - 1], e_r_sq);
           double e_v_v1 = get_scalar(e_ij, w_i[i]);
-          double var1 = alpha_i * v_rho_ji * e_v_v1 / (rho_i[i] * e_r_sq);
+          double var1 = alpha_rho_i[i] * v_rho_ji * e_v_v1 / e_r_sq;
 
           double v_rho_ij = beta.get_rho_r_sq(type_map[itype - 1], e_r_sq);
           double e_v_v2 = get_scalar(e_ij, w_i[jj]);
-          double var2 = alpha_j * v_rho_ij * e_v_v2 / (rho_i[jj] * e_r_sq);
+          double var2 = alpha_rho_i[jj] * v_rho_ij * e_v_v2 / e_r_sq;
 
           double dvar = var1 - var2;
           // friction is negative!
@@ -581,8 +594,6 @@ void FixEPHColouredExpV1::force_prl() {
 
         if(!(rho_i[i] > 0)) continue;
 
-        double alpha_i = beta.get_alpha(type_map[itype - 1], rho_i[i]);
-
         for(size_t j = 0; j != jnum; ++j) {
           int jj = jlist[j];
           jj &= NEIGHMASK;
@@ -594,15 +605,13 @@ void FixEPHColouredExpV1::force_prl() {
 
           if((e_r_sq >= r_cutoff_sq) || !(rho_i[jj] > 0)) continue;
 
-          double alpha_j = beta.get_alpha(type_map[jtype - 1], rho_i[jj]);
-
           double v_rho_ji = beta.get_rho_r_sq(type_map[jtype - 1], e_r_sq);
           double e_v_zi1 = get_scalar(e_ij, zi_i[i]);
-          double var1 = alpha_i * v_rho_ji * e_v_zi1 / (rho_i[i] * e_r_sq);
+          double var1 = alpha_rho_i[i] * v_rho_ji * e_v_zi1 / e_r_sq;
 
           double v_rho_ij = beta.get_rho_r_sq(type_map[itype - 1], e_r_sq);
           double e_v_zi2 = get_scalar(e_ij, zi_i[jj]);
-          double var2 = alpha_j * v_rho_ij * e_v_zi2 / (rho_i[jj] * e_r_sq);
+          double var2 = alpha_rho_i[jj] * v_rho_ij * e_v_zi2 / e_r_sq;
 
           double dvar = var1 - var2;
           f_RNG[i][0] += dvar * e_ij[0];
@@ -696,6 +705,7 @@ void FixEPHColouredExpV1::grow_arrays(int ngrow) {
   memory->grow(f_RNG, ngrow, 3,"EPH:fRNG");
 
   memory->grow(rho_i, ngrow, "eph:rho_i");
+  memory->grow(alpha_rho_i, ngrow, "eph:alpha_rho_i");
 
   memory->grow(w_i, ngrow, 3, "eph:w_i");
   memory->grow(xi_i, ngrow, 3, "eph:xi_i");
@@ -729,6 +739,7 @@ int FixEPHColouredExpV1::pack_forward_comm(int n, int *list, double *data, int p
     case FixState::RHO:
       for(size_t i = 0; i < n; ++i) {
         data[m++] = rho_i[list[i]];
+        data[m++] = alpha_rho_i[list[i]];
       }
       break;
     case FixState::ZI:
@@ -768,6 +779,7 @@ void FixEPHColouredExpV1::unpack_forward_comm(int n, int first, double *data) {
     case FixState::RHO:
       for(size_t i = first; i < last; ++i) {
         rho_i[i] = data[m++];
+        alpha_rho_i[i] = data[m++];
       }
       break;
     case FixState::ZI:
@@ -797,7 +809,16 @@ void FixEPHColouredExpV1::unpack_forward_comm(int n, int first, double *data) {
 }
 
 /** TODO **/
-double FixEPHColouredExpV1::memory_usage() { return 0; }
+double FixEPHColouredExpV1::memory_usage() {
+  // f_EPH, f_RNG, w_i, xi_i, zi_i, zv_i and array are 2d arrays with row pointers
+  double atom_bytes = (6 * 3 + 3 + size_peratom_cols) * sizeof(double) + 7 * sizeof(double*);
+
+  double bytes = n * atom_bytes;
+  bytes += beta.memory_bytes() + types * sizeof(int);
+  bytes += fdm.memory_bytes();
+
+  return bytes;
+}
 
 /* save temperature state after run */
 void FixEPHColouredExpV1::post_run() {
@@ -56,7 +56,7 @@ class FixEPHColouredExpV1 : public Fix {
   void reset_dt() override; // called by lammps if dt changes
   void grow_arrays(int) override; // called by lammps if number of atoms changes for some task
   double compute_vector(int) override; // called by lammps if a value is requested
-  double memory_usage() override; // prints the memory usage // TODO
+  double memory_usage() override; // bytes of the per atom arrays, the tables and the grid
   void post_run() override; // called by lammps after run ends
   
   /* integrator functionality */
@@ -122,8 +122,8 @@ class FixEPHColouredExpV1 : public Fix {
   // Electronic density at each atom
   double* rho_i; // size = [nlocal] // TODO: try switching to vector
   
-  // Inverse of electronic density in order to avoid 1./rho_i
-  double* inv_rho_i; // size = [nlocal] // TODO: try switching to vector
+  // alpha(rho_i) / rho_i in order to avoid get_alpha() and 1./rho_i per neighbour
+  double* alpha_rho_i; // size = [nlocal + nghost]
   
   // dissipation vector W_ij v_j
   double** w_i; // size = [nlocal][3]
@@ -20,7 +20,6 @@
 #include "neigh_list.h"
 #include "atom.h"
 #include "memory.h"
-#include "random_mars.h"
 #include "force.h"
 #include "update.h"
 #include "comm.h"
@@ -37,6 +36,10 @@ using namespace FixConst;
 FixEPHGPU::FixEPHGPU(LAMMPS *lmp, int narg, char **arg) :
   FixEPH(lmp, narg, arg) 
 {
+  // the kernels expect every neighbour of an atom in its own list
+  if(eph_flag & Flag::HALF_LIST)
+    error->all(FLERR, "FixEPHGPU: half neighbour list cannot be used with eph/gpu");
+
   eph_gpu = allocate_EPH_GPU(beta, types, type_map);
   eph_gpu.groupbit = groupbit;
   
@@ -81,6 +84,16 @@ void FixEPHGPU::grow_arrays(int ngrow)
   }
 }
 
+FixEPH::MemoryComponents FixEPHGPU::get_memory_components()
+{
+  MemoryComponents components = FixEPH::get_memory_components();
+  
+  components.emplace_back("Neighbour list copy", (2 * nmax + n_neighs) * sizeof(int));
+  components.emplace_back("GPU arrays", eph_gpu.memory_bytes());
+  
+  return components;
+}
+
 void FixEPHGPU::reset_dt()
 {
   FixEPH::reset_dt();
@@ -123,35 +136,51 @@ void FixEPHGPU::post_force(int)
   
   zero_data_gpu(eph_gpu);
   
+  // xi_i travels together with rho_i unless the ghosts draw it themselves
+  FixState comm_state = FixState::RHO;
+
   // generate random forces and distribute them
   // push this into gpu
   if(eph_flag & Flag::RANDOM) {
-    for(size_t i = 0; i < nlocal; ++i) {
-      if(mask[i] & groupbit) {
-        xi_i[i][0] = random->gaussian();
-        xi_i[i][1] = random->gaussian();
-        xi_i[i][2] = random->gaussian();
+    if(eph_flag & Flag::PHILOX) {
+      // xi_i depends only on (seed, tag, step); ghosts draw the numbers of their owners
+      tagint *tag = atom->tag;
+      for(size_t i = 0; i < ntotal; ++i) {
+        if(mask[i] & groupbit) {
+          philox.get_gaussian3(tag[i], update->ntimestep, xi_i[i]);
+        }
+        else {
+          xi_i[i][0] = 0;
+          xi_i[i][1] = 0;
+          xi_i[i][2] = 0;
+        }
       }
     }
-    
-    state = FixState::XIX;
-    comm->forward_comm_fix(this);
-    state = FixState::XIY;
-    comm->forward_comm_fix(this);
-    state = FixState::XIZ;
-    comm->forward_comm_fix(this);
+    else {
+      // one call for all local atoms, atoms outside of the group get no noise
+      gaussian.fill(&(xi_i[0][0]), 3 * nlocal);
+      for(size_t i = 0; i < nlocal; ++i) {
+        if(!(mask[i] & groupbit)) {
+          xi_i[i][0] = 0;
+          xi_i[i][1] = 0;
+          xi_i[i][2] = 0;
+        }
+      }
+      
+      comm_state = FixState::RHO | FixState::XI;
+    }
   }
   
-  cpu_to_device_EPH_GPU((void*) eph_gpu.xi_i_gpu, (void*) xi_i[0], 3*ntotal*sizeof(double));
-  
   // calculate site densities
   calculate_environment();
   
   device_to_cpu_EPH_GPU((void*) rho_i, (void*) eph_gpu.rho_i_gpu, nlocal*sizeof(double));
   
-  state = FixState::RHO;
+  state = comm_state;
   comm->forward_comm_fix(this);
   
+  cpu_to_device_EPH_GPU((void*) eph_gpu.xi_i_gpu, (void*) xi_i[0], 3*ntotal*sizeof(double));
+  
   // TODO: transfer only necessary parts
   cpu_to_device_EPH_GPU((void*) (eph_gpu.rho_i_gpu+nlocal), (void*) (rho_i+nlocal), nghost*sizeof(double));
   
@@ -161,7 +190,8 @@ void FixEPHGPU::post_force(int)
    */
   
   // get temperatures this will be pushed to gpu
-  for(int i = 0; i != ntotal; ++i)
+  // ghost atoms can lie outside of a distributed grid and their values are not used
+  for(int i = 0; i != nlocal; ++i)
   {
     T_e_i[i] = fdm.get_T(x[i][0], x[i][1], x[i][2]);
   }
@@ -169,22 +199,15 @@ void FixEPHGPU::post_force(int)
   cpu_to_device_EPH_GPU((void*) eph_gpu.v_gpu, (void*) v[0], 3*ntotal*sizeof(double));
   cpu_to_device_EPH_GPU((void*) eph_gpu.T_e_i_gpu, (void*) T_e_i, nlocal*sizeof(double));
   
-  switch(eph_model) {
-    case Model::TTM: force_ttm();
-      break;
-    case Model::PRB: force_prb();
-      break;
-    case Model::PRLCM: force_prlcm();
-      break;
-    case Model::PRL: force_prl();
-      break;
-    case Model::TESTING: force_testing();
-      break;
-    default: throw;
+  // the PRL model runs on the device, the rest use the host kernel selected in init()
+  if(eph_model == Model::PRL) 
+  {
+    force_prl();
+    
+    device_to_cpu_EPH_GPU((void*) f_EPH[0], (void*) eph_gpu.f_EPH_gpu, 3*nlocal*sizeof(double));
+    device_to_cpu_EPH_GPU((void*) f_RNG[0], (void*) eph_gpu.f_RNG_gpu, 3*nlocal*sizeof(double));
   }
-  
-  device_to_cpu_EPH_GPU((void*) f_EPH[0], (void*) eph_gpu.f_EPH_gpu, 3*nlocal*sizeof(double));
-  device_to_cpu_EPH_GPU((void*) f_RNG[0], (void*) eph_gpu.f_RNG_gpu, 3*nlocal*sizeof(double));
+  else (this->*force_kernel)();
   
   // second loop over atoms if needed
   if((eph_flag & Flag::FRICTION) && !(eph_flag & Flag::NOFRICTION)) {
@@ -204,9 +227,20 @@ void FixEPHGPU::post_force(int)
   }
 }
 
+// only PRL runs on the device; the host kernels of the other models need the
+// pair cache and alpha(rho) / rho of FixEPH::calculate_environment()
 void FixEPHGPU::calculate_environment()
 {
-  calculate_environment_gpu(eph_gpu);
+  if(eph_model == Model::PRL) 
+  {
+    calculate_environment_gpu(eph_gpu);
+    return;
+  }
+  
+  FixEPH::calculate_environment();
+  
+  // post_force() reads the densities back from the device
+  cpu_to_device_EPH_GPU((void*) eph_gpu.rho_i_gpu, (void*) rho_i, atom->nlocal*sizeof(double));
 }
 
 void FixEPHGPU::force_prl()
@@ -224,11 +258,7 @@ void FixEPHGPU::force_prl()
   
   device_to_cpu_EPH_GPU((void*) w_i[0], (void*) eph_gpu.w_i_gpu, 3*ntotal*sizeof(double));
   
-  state = FixState::WX;
-  comm->forward_comm_fix(this);
-  state = FixState::WY;
-  comm->forward_comm_fix(this);
-  state = FixState::WZ;
+  state = FixState::WI;
   comm->forward_comm_fix(this);
   
   // TODO: copy only ghost values
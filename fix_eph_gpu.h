@@ -43,8 +43,9 @@ class FixEPHGPU : public FixEPH {
   private:
     EPH_GPU eph_gpu;
     
-    void calculate_environment(); 
+    void calculate_environment() override;
     void force_prl();
+    MemoryComponents get_memory_components() override;
     
     void transfer_neighbour_list();
     
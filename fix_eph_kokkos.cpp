@@ -0,0 +1,421 @@
+/*
+ * Authors of the extension Artur Tamm, Alfredo Correa
+ * e-mail: artur.tamm.work@gmail.com
+ */
+
+#ifdef LMP_KOKKOS
+
+// external headers
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+
+// lammps headers
+#include "error.h"
+#include "neighbor.h"
+#include "neigh_request.h"
+#include "neigh_list_kokkos.h"
+#include "atom_kokkos.h"
+#include "atom_masks.h"
+#include "memory_kokkos.h"
+#include "update.h"
+#include "comm.h"
+
+// internal headers
+#include "fix_eph.h"
+#include "fix_eph_kokkos.h"
+
+using namespace LAMMPS_NS;
+using namespace FixConst;
+
+// constructor
+template<class DeviceType>
+FixEPHKokkos<DeviceType>::FixEPHKokkos(LAMMPS *lmp, int narg, char **arg) :
+  FixEPH(lmp, narg, arg)
+{
+  kokkosable = 1;
+  atomKK = (AtomKokkos *) atom;
+  execution_space = ExecutionSpaceFromDevice<DeviceType>::space;
+
+  // every member function synchronises the atom data it uses
+  datamask_read = EMPTY_MASK;
+  datamask_modify = EMPTY_MASK;
+
+  // with a half list a pair writes to both atoms and owner computes does not hold
+  if(eph_flag & Flag::HALF_LIST)
+    error->all(FLERR, "FixEPHKokkos: half neighbour list cannot be used with eph/kk");
+
+  // FixEPH allocated plain arrays, replace them by dual views
+  memory->destroy(rho_i);
+  memory->destroy(alpha_rho_i);
+  memory->destroy(T_e_i);
+  memory->destroy(w_i);
+  memory->destroy(xi_i);
+  memory->destroy(f_EPH);
+  memory->destroy(f_RNG);
+
+  grow_arrays(atom->nmax);
+
+  size_t ntotal = atom->nlocal + atom->nghost;
+
+  std::fill_n(&(rho_i[0]), ntotal, 0);
+  std::fill_n(&(alpha_rho_i[0]), ntotal, 0);
+  std::fill_n(&(T_e_i[0]), ntotal, 0);
+  std::fill_n(&(w_i[0][0]), 3 * ntotal, 0);
+  std::fill_n(&(xi_i[0][0]), 3 * ntotal, 0);
+  std::fill_n(&(f_EPH[0][0]), 3 * ntotal, 0);
+  std::fill_n(&(f_RNG[0][0]), 3 * ntotal, 0);
+
+  k_rho_i.template modify<LMPHostType>();
+  k_alpha_rho_i.template modify<LMPHostType>();
+  k_T_e_i.template modify<LMPHostType>();
+  k_w_i.template modify<LMPHostType>();
+  k_xi_i.template modify<LMPHostType>();
+  k_f_EPH.template modify<LMPHostType>();
+  k_f_RNG.template modify<LMPHostType>();
+
+  // beta(rho) tables and the type map are copied once
+  kernels.beta = EPH_BetaKokkos<DeviceType>(beta);
+
+  kernels.type_map = Kokkos::View<int*, DeviceType>("eph:type_map", types);
+  auto h_type_map = Kokkos::create_mirror_view(kernels.type_map);
+  for(int i = 0; i < types; ++i) { h_type_map(i) = type_map[i]; }
+  Kokkos::deep_copy(kernels.type_map, h_type_map);
+
+  kernels.r_cutoff_sq = r_cutoff_sq;
+}
+
+// destructor
+template<class DeviceType>
+FixEPHKokkos<DeviceType>::~FixEPHKokkos() {
+  memoryKK->destroy_kokkos(k_rho_i, rho_i);
+  memoryKK->destroy_kokkos(k_alpha_rho_i, alpha_rho_i);
+  memoryKK->destroy_kokkos(k_T_e_i, T_e_i);
+  memoryKK->destroy_kokkos(k_w_i, w_i);
+  memoryKK->destroy_kokkos(k_xi_i, xi_i);
+  memoryKK->destroy_kokkos(k_f_EPH, f_EPH);
+  memoryKK->destroy_kokkos(k_f_RNG, f_RNG);
+}
+
+template<class DeviceType>
+void FixEPHKokkos<DeviceType>::init() {
+  FixEPH::init();
+
+  // the neighbour list of FixEPH is built by Kokkos on the space of the fix
+  auto request = neighbor->find_request(this);
+  request->set_kokkos_host(std::is_same<DeviceType, LMPHostType>::value &&
+    !std::is_same<DeviceType, LMPDeviceType>::value);
+  request->set_kokkos_device(std::is_same<DeviceType, LMPDeviceType>::value);
+
+  atomKK->k_mass.template modify<LMPHostType>();
+  atomKK->k_mass.template sync<DeviceType>();
+}
+
+template<class DeviceType>
+void FixEPHKokkos<DeviceType>::grow_arrays(int ngrow) {
+  n = ngrow;
+
+  // the [3] arrays are grown like atom->k_f, the second extent is fixed by the type
+
+  memoryKK->grow_kokkos(k_f_EPH, f_EPH, ngrow, "eph:f_EPH");
+  memoryKK->grow_kokkos(k_f_RNG, f_RNG, ngrow, "eph:f_RNG");
+
+  memoryKK->grow_kokkos(k_rho_i, rho_i, ngrow, "eph:rho_i");
+  memoryKK->grow_kokkos(k_alpha_rho_i, alpha_rho_i, ngrow, "eph:alpha_rho_i");
+
+  memoryKK->grow_kokkos(k_w_i, w_i, ngrow, "eph:w_i");
+  memoryKK->grow_kokkos(k_xi_i, xi_i, ngrow, "eph:xi_i");
+
+  memoryKK->grow_kokkos(k_T_e_i, T_e_i, ngrow, "eph:T_e_i");
+
+  // per atom values are only used on the host
+  memory->grow(array, ngrow, size_peratom_cols, "eph:array");
+  array_atom = array;
+}
+
+// the host side of the dual views is counted by fix eph
+template<class DeviceType>
+FixEPH::MemoryComponents FixEPHKokkos<DeviceType>::get_memory_components() {
+  MemoryComponents components = FixEPH::get_memory_components();
+
+  // dual views on a host execution space share one allocation
+  double device_bytes = 0;
+  if(k_rho_i.d_view.data() != k_rho_i.h_view.data()) {
+    device_bytes += (k_rho_i.d_view.size() + k_alpha_rho_i.d_view.size() + k_T_e_i.d_view.size()
+      + k_w_i.d_view.size() + k_xi_i.d_view.size()
+      + k_f_EPH.d_view.size() + k_f_RNG.d_view.size()) * sizeof(double);
+  }
+
+  components.emplace_back("Device atom views", device_bytes);
+  components.emplace_back("Kokkos beta tables",
+    kernels.beta.memory_bytes() + kernels.type_map.size() * sizeof(int));
+
+  return components;
+}
+
+template<class DeviceType>
+void FixEPHKokkos<DeviceType>::update_kernels() {
+  kernels.x = atomKK->k_x.template view<DeviceType>();
+  kernels.v = atomKK->k_v.template view<DeviceType>();
+  kernels.f = atomKK->k_f.template view<DeviceType>();
+  kernels.type = atomKK->k_type.template view<DeviceType>();
+  kernels.mask = atomKK->k_mask.template view<DeviceType>();
+  kernels.mass = atomKK->k_mass.template view<DeviceType>();
+
+  NeighListKokkos<DeviceType>* k_list = static_cast<NeighListKokkos<DeviceType>*>(list);
+  kernels.numneigh = k_list->d_numneigh;
+  kernels.neighbors = k_list->d_neighbors;
+
+  kernels.rho_i = k_rho_i.template view<DeviceType>();
+  kernels.alpha_rho_i = k_alpha_rho_i.template view<DeviceType>();
+  kernels.T_e_i = k_T_e_i.template view<DeviceType>();
+  kernels.w_i = k_w_i.template view<DeviceType>();
+  kernels.xi_i = k_xi_i.template view<DeviceType>();
+  kernels.f_EPH = k_f_EPH.template view<DeviceType>();
+  kernels.f_RNG = k_f_RNG.template view<DeviceType>();
+
+  kernels.groupbit = groupbit;
+  kernels.eta_factor = eta_factor;
+  kernels.dtv = dtv;
+  kernels.dtf = dtf;
+}
+
+template<class DeviceType>
+template<class Tag>
+void FixEPHKokkos<DeviceType>::launch() {
+  Kokkos::parallel_for(Kokkos::RangePolicy<DeviceType, Tag>(0, atom->nlocal), kernels);
+}
+
+// kernels run asynchronously; the device is fenced only when the timers are on
+template<class DeviceType>
+void FixEPHKokkos<DeviceType>::timer_lap(int phase) {
+  if(!timer.enabled) return;
+
+  Kokkos::fence();
+  timer.lap(phase);
+}
+
+template<class DeviceType>
+void FixEPHKokkos<DeviceType>::forward_comm_host(FixState comm_state) {
+  if(has_state(comm_state, FixState::RHO)) {
+    k_rho_i.template sync<LMPHostType>();
+    k_alpha_rho_i.template sync<LMPHostType>();
+  }
+
+  if(has_state(comm_state, FixState::XI)) { k_xi_i.template sync<LMPHostType>(); }
+  if(has_state(comm_state, FixState::WI)) { k_w_i.template sync<LMPHostType>(); }
+
+  state = comm_state;
+  comm->forward_comm(this);
+
+  if(has_state(comm_state, FixState::RHO)) {
+    k_rho_i.template modify<LMPHostType>();
+    k_alpha_rho_i.template modify<LMPHostType>();
+    k_rho_i.template sync<DeviceType>();
+    k_alpha_rho_i.template sync<DeviceType>();
+  }
+
+  if(has_state(comm_state, FixState::XI)) {
+    k_xi_i.template modify<LMPHostType>();
+    k_xi_i.template sync<DeviceType>();
+  }
+
+  if(has_state(comm_state, FixState::WI)) {
+    k_w_i.template modify<LMPHostType>();
+    k_w_i.template sync<DeviceType>();
+  }
+}
+
+template<class DeviceType>
+void FixEPHKokkos<DeviceType>::post_force(int vflag) {
+  int nlocal = atom->nlocal;
+
+  timer.start();
+
+  // random numbers are drawn on the host in the order of fix eph
+  atomKK->sync(Host, MASK_MASK | TAG_MASK);
+  FixState comm_state = generate_xi();
+  k_xi_i.template modify<LMPHostType>();
+  timer_lap(EPH_Timer::RANDOM);
+
+  atomKK->sync(execution_space, X_MASK | V_MASK | F_MASK | MASK_MASK | TYPE_MASK);
+  update_kernels();
+
+  // site densities; the ghosts get them together with xi_i
+  launch<TagFixEPHEnvironment>();
+  k_rho_i.template modify<DeviceType>();
+  k_alpha_rho_i.template modify<DeviceType>();
+  timer_lap(EPH_Timer::ENVIRONMENT);
+
+  forward_comm_host(comm_state);
+  k_xi_i.template sync<DeviceType>();
+  timer_lap(EPH_Timer::COMM_RHO);
+
+  // electronic temperature at the atoms for the random force
+  if(eph_flag & Flag::RANDOM) {
+    atomKK->sync(Host, X_MASK);
+
+    double **x = atom->x;
+    int *mask = atom->mask;
+
+    for(size_t i = 0; i < nlocal; ++i) {
+      T_e_i[i] = (mask[i] & groupbit) ? fdm.get_T(x[i][0], x[i][1], x[i][2]) : 0;
+    }
+
+    k_T_e_i.template modify<LMPHostType>();
+    k_T_e_i.template sync<DeviceType>();
+  }
+
+  Kokkos::deep_copy(kernels.w_i, 0.0);
+  Kokkos::deep_copy(kernels.f_EPH, 0.0);
+  Kokkos::deep_copy(kernels.f_RNG, 0.0);
+  k_w_i.template modify<DeviceType>();
+
+  (this->*force_kernel)();
+
+  k_f_EPH.template modify<DeviceType>();
+  k_f_RNG.template modify<DeviceType>();
+
+  const bool friction = (eph_flag & Flag::FRICTION) && !(eph_flag & Flag::NOFRICTION);
+  const bool random = (eph_flag & Flag::RANDOM) && !(eph_flag & Flag::NORANDOM);
+
+  if(friction && random) launch<TagFixEPHApply<true, true>>();
+  else if(friction) launch<TagFixEPHApply<true, false>>();
+  else if(random) launch<TagFixEPHApply<false, true>>();
+
+  atomKK->modified(execution_space, F_MASK);
+  timer_lap(EPH_Timer::FORCES);
+}
+
+// the energy deposition and the FDM grid use the host code of fix eph
+template<class DeviceType>
+void FixEPHKokkos<DeviceType>::end_of_step() {
+  atomKK->sync(Host, X_MASK | V_MASK | MASK_MASK | TYPE_MASK);
+
+  k_rho_i.template sync<LMPHostType>();
+  k_f_EPH.template sync<LMPHostType>();
+  k_f_RNG.template sync<LMPHostType>();
+
+  FixEPH::end_of_step();
+}
+
+/* integrator functionality */
+template<class DeviceType>
+void FixEPHKokkos<DeviceType>::initial_integrate(int) {
+  if(eph_flag & Flag::NOINT) return;
+
+  timer.start();
+
+  atomKK->sync(execution_space, X_MASK | V_MASK | F_MASK | MASK_MASK | TYPE_MASK);
+  update_kernels();
+
+  launch<TagFixEPHInitialIntegrate>();
+
+  atomKK->modified(execution_space, X_MASK | V_MASK);
+  timer_lap(EPH_Timer::INTEGRATE);
+}
+
+template<class DeviceType>
+void FixEPHKokkos<DeviceType>::final_integrate() {
+  if(eph_flag & Flag::NOINT) return;
+
+  timer.start();
+
+  atomKK->sync(execution_space, V_MASK | F_MASK | MASK_MASK | TYPE_MASK);
+  update_kernels();
+
+  launch<TagFixEPHFinalIntegrate>();
+
+  atomKK->modified(execution_space, V_MASK);
+  timer_lap(EPH_Timer::INTEGRATE);
+}
+
+template<class DeviceType>
+template<bool friction, bool random, bool group_all>
+void FixEPHKokkos<DeviceType>::force_ttm() {
+  launch<TagFixEPHTTM<friction, random, group_all>>();
+}
+
+template<class DeviceType>
+template<bool friction, bool random, bool group_all>
+void FixEPHKokkos<DeviceType>::force_prb() {
+  launch<TagFixEPHPRB<friction, random, group_all>>();
+}
+
+template<class DeviceType>
+template<bool friction, bool random, bool group_all>
+void FixEPHKokkos<DeviceType>::force_prlcm() {
+  // w_i of the friction has to reach the ghosts before the forces
+  if(friction) {
+    launch<TagFixEPHPRLCMW<group_all>>();
+    k_w_i.template modify<DeviceType>();
+    timer_lap(EPH_Timer::W_PASS);
+
+    forward_comm_host(FixState::WI);
+    timer_lap(EPH_Timer::COMM_W);
+  }
+
+  launch<TagFixEPHPRLCM<friction, random, group_all>>();
+}
+
+template<class DeviceType>
+template<bool friction, bool random, bool group_all>
+void FixEPHKokkos<DeviceType>::force_prl() {
+  // w_i = W_ij^T v_j has to reach the ghosts before the forces
+  if(friction) {
+    launch<TagFixEPHPRLW<group_all>>();
+    k_w_i.template modify<DeviceType>();
+    timer_lap(EPH_Timer::W_PASS);
+
+    forward_comm_host(FixState::WI);
+    timer_lap(EPH_Timer::COMM_W);
+  }
+
+  launch<TagFixEPHPRL<friction, random, group_all>>();
+}
+
+// kernel of the selected model for one combination of terms and group
+template<class DeviceType>
+template<bool friction, bool random, bool group_all>
+FixEPH::ForceKernel FixEPHKokkos<DeviceType>::get_force_kernel() {
+  switch(eph_model) {
+    case Model::NONE: return &FixEPHKokkos::force_none;
+    case Model::TTM: return static_cast<ForceKernel>(&FixEPHKokkos::force_ttm<friction, random, group_all>);
+    case Model::PRB: return static_cast<ForceKernel>(&FixEPHKokkos::force_prb<friction, random, group_all>);
+    case Model::PRLCM: return static_cast<ForceKernel>(&FixEPHKokkos::force_prlcm<friction, random, group_all>);
+    case Model::PRL: return static_cast<ForceKernel>(&FixEPHKokkos::force_prl<friction, random, group_all>);
+    case Model::TESTING: return &FixEPHKokkos::force_testing;
+    default: error->all(FLERR, "FixEPHKokkos: unknown model");
+  }
+
+  return nullptr;
+}
+
+template<class DeviceType>
+void FixEPHKokkos<DeviceType>::select_force_kernel() {
+  const bool friction = (eph_flag & Flag::FRICTION);
+  const bool random = (eph_flag & Flag::RANDOM);
+  const bool group_all = (igroup == 0); // group all is always the first group
+
+  if(friction && random) {
+    force_kernel = group_all ? get_force_kernel<true, true, true>() : get_force_kernel<true, true, false>();
+  }
+  else if(friction) {
+    force_kernel = group_all ? get_force_kernel<true, false, true>() : get_force_kernel<true, false, false>();
+  }
+  else if(random) {
+    force_kernel = group_all ? get_force_kernel<false, true, true>() : get_force_kernel<false, true, false>();
+  }
+  else {
+    force_kernel = group_all ? get_force_kernel<false, false, true>() : get_force_kernel<false, false, false>();
+  }
+}
+
+namespace LAMMPS_NS {
+template class FixEPHKokkos<LMPDeviceType>;
+#ifdef LMP_KOKKOS_GPU
+template class FixEPHKokkos<LMPHostType>;
+#endif
+}
+
+#endif
@@ -0,0 +1,87 @@
+/**
+ * This fix is a rewrite of our previous USER-EPH (a mod of fix_ttm) code and is based on our
+ * PRB 94, 024305 (2016) paper
+ **/
+
+/*
+ * Authors of the extension Artur Tamm, Alfredo Caro, Alfredo Correa, Mattias Klintenberg
+ * e-mail: artur.tamm.work@gmail.com
+ */
+
+#ifdef LMP_KOKKOS
+
+#ifdef FIX_CLASS
+FixStyle(eph/kk,FixEPHKokkos<LMPDeviceType>)
+FixStyle(eph/kk/device,FixEPHKokkos<LMPDeviceType>)
+FixStyle(eph/kk/host,FixEPHKokkos<LMPHostType>)
+#else
+
+#ifndef LMP_FIX_EPH_KOKKOS_H
+#define LMP_FIX_EPH_KOKKOS_H
+
+// external headers
+
+// lammps headers
+#include "kokkos_type.h"
+
+// internal headers
+#include "fix_eph.h"
+#include "fix_eph_kokkos_kernels.h"
+
+namespace LAMMPS_NS {
+
+/*
+ * fix eph on Kokkos views
+ *
+ * The densities, the force kernels and the integrator run on the execution
+ * space of DeviceType. The random numbers, the forward communication and the
+ * FDM grid stay on the host and use the code of fix eph; the per atom arrays
+ * are dual views that are synchronised around them.
+ */
+template<class DeviceType>
+class FixEPHKokkos : public FixEPH {
+ public:
+    typedef ArrayTypes<DeviceType> AT;
+
+    FixEPHKokkos(class LAMMPS *, int, char **); // constructor
+    ~FixEPHKokkos(); // destructor
+
+    void init() override;
+    void post_force(int) override;
+    void end_of_step() override;
+    void grow_arrays(int) override;
+
+    void initial_integrate(int) override;
+    void final_integrate() override;
+
+  protected:
+    FixEPHKokkosKernels<DeviceType> kernels;
+
+    DAT::tdual_float_1d k_rho_i;
+    DAT::tdual_float_1d k_alpha_rho_i;
+    DAT::tdual_float_1d k_T_e_i;
+    DAT::tdual_f_array k_w_i;
+    DAT::tdual_f_array k_xi_i;
+    DAT::tdual_f_array k_f_EPH;
+    DAT::tdual_f_array k_f_RNG;
+
+    void update_kernels(); // point the kernels to the current views
+    void forward_comm_host(FixState); // forward communication of the dual views on the host
+    void timer_lap(int); // timer.lap() after the launched kernels have finished
+
+    template<class Tag> void launch(); // run Tag over the local atoms
+
+    void select_force_kernel() override;
+    MemoryComponents get_memory_components() override;
+    template<bool friction, bool random, bool group_all> ForceKernel get_force_kernel();
+
+    template<bool friction, bool random, bool group_all> void force_ttm();
+    template<bool friction, bool random, bool group_all> void force_prb();
+    template<bool friction, bool random, bool group_all> void force_prlcm();
+    template<bool friction, bool random, bool group_all> void force_prl();
+};
+
+}
+#endif
+#endif
+#endif
@@ -0,0 +1,472 @@
+/*
+ * Authors of the extension Artur Tamm, Alfredo Correa
+ * e-mail: artur.tamm.work@gmail.com
+ */
+
+#ifndef LMP_FIX_EPH_KOKKOS_KERNELS_H
+#define LMP_FIX_EPH_KOKKOS_KERNELS_H
+
+// external headers
+#include <cmath>
+
+// lammps headers
+#include "kokkos_type.h"
+
+// internal headers
+#include "eph_beta_kokkos.h"
+
+/*
+ * The kernels of fix eph/kk live in this header so that they can be tested
+ * on their own views (Tests/EPH_KokkosKernels) without a LAMMPS instance.
+ */
+
+namespace LAMMPS_NS {
+
+// kernel tags; the force kernels are specialised like the ones of FixEPH
+struct TagFixEPHEnvironment {};
+template<bool friction, bool random, bool group_all> struct TagFixEPHTTM {};
+template<bool friction, bool random, bool group_all> struct TagFixEPHPRB {};
+template<bool group_all> struct TagFixEPHPRLCMW {};
+template<bool friction, bool random, bool group_all> struct TagFixEPHPRLCM {};
+template<bool group_all> struct TagFixEPHPRLW {};
+template<bool friction, bool random, bool group_all> struct TagFixEPHPRL {};
+template<bool friction, bool random> struct TagFixEPHApply {};
+struct TagFixEPHInitialIntegrate {};
+struct TagFixEPHFinalIntegrate {};
+
+/*
+ * Views and parameters of the kernels of fix eph/kk.
+ *
+ * Every kernel computes the values of one local atom from the full neighbour
+ * list (owner computes). The pair geometry and densities are evaluated in
+ * place instead of being cached, and the PRL W operator is applied pair by
+ * pair. The struct is copied by value into every kernel launch.
+ */
+template<class DeviceType>
+struct FixEPHKokkosKernels {
+  typedef ArrayTypes<DeviceType> AT;
+
+  typename AT::t_x_array x;
+  typename AT::t_v_array v;
+  typename AT::t_f_array f;
+  typename AT::t_int_1d type;
+  typename AT::t_int_1d mask;
+  typename AT::t_float_1d mass;
+
+  typename AT::t_int_1d numneigh;
+  typename AT::t_neighbors_2d neighbors;
+
+  typename AT::t_float_1d rho_i;
+  typename AT::t_float_1d alpha_rho_i;
+  typename AT::t_float_1d T_e_i;
+  typename AT::t_f_array w_i;
+  typename AT::t_f_array xi_i;
+  typename AT::t_f_array f_EPH;
+  typename AT::t_f_array f_RNG;
+
+  EPH_BetaKokkos<DeviceType> beta;
+  Kokkos::View<int*, DeviceType> type_map;
+
+  int groupbit;
+  double r_cutoff_sq;
+  double eta_factor;
+  double dtv;
+  double dtf;
+
+  // e_ij = x_j - x_i, returns r_ij^2
+  KOKKOS_INLINE_FUNCTION
+  double get_difference_sq(int i, int j, double* e_ij) const {
+    e_ij[0] = x(j, 0) - x(i, 0);
+    e_ij[1] = x(j, 1) - x(i, 1);
+    e_ij[2] = x(j, 2) - x(i, 2);
+
+    return e_ij[0] * e_ij[0] + e_ij[1] * e_ij[1] + e_ij[2] * e_ij[2];
+  }
+
+  KOKKOS_INLINE_FUNCTION void operator()(TagFixEPHEnvironment, const int& i) const;
+
+  template<bool friction, bool random, bool group_all>
+  KOKKOS_INLINE_FUNCTION void operator()(TagFixEPHTTM<friction, random, group_all>, const int& i) const;
+
+  template<bool friction, bool random, bool group_all>
+  KOKKOS_INLINE_FUNCTION void operator()(TagFixEPHPRB<friction, random, group_all>, const int& i) const;
+
+  template<bool group_all>
+  KOKKOS_INLINE_FUNCTION void operator()(TagFixEPHPRLCMW<group_all>, const int& i) const;
+
+  template<bool friction, bool random, bool group_all>
+  KOKKOS_INLINE_FUNCTION void operator()(TagFixEPHPRLCM<friction, random, group_all>, const int& i) const;
+
+  template<bool group_all>
+  KOKKOS_INLINE_FUNCTION void operator()(TagFixEPHPRLW<group_all>, const int& i) const;
+
+  template<bool friction, bool random, bool group_all>
+  KOKKOS_INLINE_FUNCTION void operator()(TagFixEPHPRL<friction, random, group_all>, const int& i) const;
+
+  template<bool friction, bool random>
+  KOKKOS_INLINE_FUNCTION void operator()(TagFixEPHApply<friction, random>, const int& i) const;
+
+  KOKKOS_INLINE_FUNCTION void operator()(TagFixEPHInitialIntegrate, const int& i) const;
+  KOKKOS_INLINE_FUNCTION void operator()(TagFixEPHFinalIntegrate, const int& i) const;
+};
+
+/*
+ * Kernels; the arithmetic follows the kernels of FixEPH
+ */
+template<class DeviceType>
+KOKKOS_INLINE_FUNCTION
+void FixEPHKokkosKernels<DeviceType>::operator()(TagFixEPHEnvironment, const int& i) const {
+  rho_i(i) = 0;
+  alpha_rho_i(i) = 0;
+
+  if(!(mask(i) & groupbit)) return;
+
+  const int itype = type_map(type(i) - 1);
+  const int jnum = numneigh(i);
+
+  double rho = 0;
+
+  for(int jj = 0; jj < jnum; ++jj) {
+    const int j = neighbors(i, jj) & NEIGHMASK;
+
+    double e_ij[3];
+    double r_sq = get_difference_sq(i, j, e_ij);
+
+    if(r_sq < r_cutoff_sq) { rho += beta.get_rho_r_sq(type_map(type(j) - 1), r_sq); }
+  }
+
+  rho_i(i) = rho;
+
+  // prefactor used by every neighbour of i
+  if(rho > 0) { alpha_rho_i(i) = beta.get_alpha(itype, rho) / rho; }
+}
+
+template<class DeviceType>
+template<bool friction, bool random, bool group_all>
+KOKKOS_INLINE_FUNCTION
+void FixEPHKokkosKernels<DeviceType>::operator()(TagFixEPHTTM<friction, random, group_all>, const int& i) const {
+  if(!(group_all || (mask(i) & groupbit))) return;
+
+  const int itype = type_map(type(i) - 1);
+
+  // create friction forces
+  if(friction) {
+    double var = -beta.get_beta(itype, rho_i(i));
+
+    f_EPH(i, 0) = var * v(i, 0);
+    f_EPH(i, 1) = var * v(i, 1);
+    f_EPH(i, 2) = var * v(i, 2);
+  }
+
+  // create random forces
+  if(random) {
+    double var = eta_factor * beta.get_alpha(itype, rho_i(i)) * sqrt(T_e_i(i));
+
+    f_RNG(i, 0) = var * xi_i(i, 0);
+    f_RNG(i, 1) = var * xi_i(i, 1);
+    f_RNG(i, 2) = var * xi_i(i, 2);
+  }
+}
+
+template<class DeviceType>
+template<bool friction, bool random, bool group_all>
+KOKKOS_INLINE_FUNCTION
+void FixEPHKokkosKernels<DeviceType>::operator()(TagFixEPHPRB<friction, random, group_all>, const int& i) const {
+  if(!(group_all || (mask(i) & groupbit))) return;
+
+  const int itype = type_map(type(i) - 1);
+
+  // create friction forces
+  if(friction && rho_i(i) > 0) {
+    double inv_rho = 1.0 / rho_i(i);
+    double f_i[3] {v(i, 0), v(i, 1), v(i, 2)};
+
+    const int jnum = numneigh(i);
+
+    for(int jj = 0; jj < jnum; ++jj) {
+      const int j = neighbors(i, jj) & NEIGHMASK;
+
+      double e_ij[3];
+      double r_sq = get_difference_sq(i, j, e_ij);
+
+      if(!(r_sq < r_cutoff_sq)) continue;
+
+      double var = beta.get_rho_r_sq(type_map(type(j) - 1), r_sq) * inv_rho;
+
+      f_i[0] -= var * v(j, 0);
+      f_i[1] -= var * v(j, 1);
+      f_i[2] -= var * v(j, 2);
+    }
+
+    double var = beta.get_beta(itype, rho_i(i));
+    f_EPH(i, 0) = f_i[0] * var;
+    f_EPH(i, 1) = f_i[1] * var;
+    f_EPH(i, 2) = f_i[2] * var;
+  }
+
+  // create random forces
+  if(random) {
+    double var = eta_factor * beta.get_alpha(itype, rho_i(i)) * sqrt(T_e_i(i));
+
+    f_RNG(i, 0) = var * xi_i(i, 0);
+    f_RNG(i, 1) = var * xi_i(i, 1);
+    f_RNG(i, 2) = var * xi_i(i, 2);
+  }
+}
+
+template<class DeviceType>
+template<bool group_all>
+KOKKOS_INLINE_FUNCTION
+void FixEPHKokkosKernels<DeviceType>::operator()(TagFixEPHPRLCMW<group_all>, const int& i) const {
+  if(!(group_all || (mask(i) & groupbit))) return;
+
+  double alpha_i = beta.get_alpha(type_map(type(i) - 1), rho_i(i));
+  double w[3] {alpha_i * v(i, 0), alpha_i * v(i, 1), alpha_i * v(i, 2)};
+
+  if(rho_i(i) > 0.0) {
+    double inv_rho = 1.0 / rho_i(i);
+
+    const int jnum = numneigh(i);
+
+    for(int jj = 0; jj < jnum; ++jj) {
+      const int j = neighbors(i, jj) & NEIGHMASK;
+
+      double e_ij[3];
+      double r_sq = get_difference_sq(i, j, e_ij);
+
+      if(!(r_sq < r_cutoff_sq)) continue;
+
+      double var = alpha_i * beta.get_rho_r_sq(type_map(type(j) - 1), r_sq) * inv_rho;
+
+      w[0] -= var * v(j, 0);
+      w[1] -= var * v(j, 1);
+      w[2] -= var * v(j, 2);
+    }
+  }
+
+  w_i(i, 0) = w[0];
+  w_i(i, 1) = w[1];
+  w_i(i, 2) = w[2];
+}
+
+template<class DeviceType>
+template<bool friction, bool random, bool group_all>
+KOKKOS_INLINE_FUNCTION
+void FixEPHKokkosKernels<DeviceType>::operator()(TagFixEPHPRLCM<friction, random, group_all>, const int& i) const {
+  if(!(group_all || (mask(i) & groupbit))) return;
+
+  const int itype = type_map(type(i) - 1);
+
+  double alpha_i = beta.get_alpha(itype, rho_i(i));
+
+  double f_e[3] {0, 0, 0};
+  double f_r[3] {0, 0, 0};
+
+  if(friction) {
+    f_e[0] = alpha_i * w_i(i, 0);
+    f_e[1] = alpha_i * w_i(i, 1);
+    f_e[2] = alpha_i * w_i(i, 2);
+  }
+
+  if(random) {
+    f_r[0] = alpha_i * xi_i(i, 0);
+    f_r[1] = alpha_i * xi_i(i, 1);
+    f_r[2] = alpha_i * xi_i(i, 2);
+  }
+
+  const int jnum = numneigh(i);
+
+  for(int jj = 0; jj < jnum; ++jj) {
+    const int j = neighbors(i, jj) & NEIGHMASK;
+
+    double e_ij[3];
+    double r_sq = get_difference_sq(i, j, e_ij);
+
+    if(!(r_sq < r_cutoff_sq)) continue;
+    if(!(rho_i(j) > 0.0)) continue;
+
+    double var = alpha_rho_i(j) * beta.get_rho_r_sq(itype, r_sq);
+
+    if(friction) {
+      f_e[0] -= var * w_i(j, 0);
+      f_e[1] -= var * w_i(j, 1);
+      f_e[2] -= var * w_i(j, 2);
+    }
+
+    if(random) {
+      f_r[0] -= var * xi_i(j, 0);
+      f_r[1] -= var * xi_i(j, 1);
+      f_r[2] -= var * xi_i(j, 2);
+    }
+  }
+
+  if(friction) {
+    f_EPH(i, 0) = f_e[0];
+    f_EPH(i, 1) = f_e[1];
+    f_EPH(i, 2) = f_e[2];
+  }
+
+  if(random) {
+    double var = eta_factor * sqrt(T_e_i(i));
+    f_RNG(i, 0) = f_r[0] * var;
+    f_RNG(i, 1) = f_r[1] * var;
+    f_RNG(i, 2) = f_r[2] * var;
+  }
+}
+
+/*
+ * The PRL kernels apply the W operator of EPH_BlockCSR pair by pair:
+ *   (W^T x)_i = sum_j a_ij e_ij e_ij^T (x_i - x_j),
+ *   (W x)_i = sum_j e_ij e_ij^T (a_ij x_i - a_ji x_j),
+ * with a_ij = alpha(rho_i) / rho_i * rho_j(r_ij) / r_ij^2; a pair couples only
+ * if both atoms have a positive density.
+ */
+template<class DeviceType>
+template<bool group_all>
+KOKKOS_INLINE_FUNCTION
+void FixEPHKokkosKernels<DeviceType>::operator()(TagFixEPHPRLW<group_all>, const int& i) const {
+  if(!(group_all || (mask(i) & groupbit))) return;
+  if(!(alpha_rho_i(i) > 0)) return;
+
+  double w[3] {0, 0, 0};
+
+  const int jnum = numneigh(i);
+
+  for(int jj = 0; jj < jnum; ++jj) {
+    const int j = neighbors(i, jj) & NEIGHMASK;
+
+    double e_ij[3];
+    double r_sq = get_difference_sq(i, j, e_ij);
+
+    if(!(r_sq < r_cutoff_sq)) continue;
+    if(!(alpha_rho_i(j) > 0)) continue;
+
+    double inv_r_sq = 1.0 / r_sq;
+    double a_ij = beta.get_rho_r_sq(type_map(type(j) - 1), r_sq) * inv_r_sq * alpha_rho_i(i);
+    double var = a_ij * (
+      e_ij[0] * (v(i, 0) - v(j, 0)) +
+      e_ij[1] * (v(i, 1) - v(j, 1)) +
+      e_ij[2] * (v(i, 2) - v(j, 2)));
+
+    w[0] += var * e_ij[0];
+    w[1] += var * e_ij[1];
+    w[2] += var * e_ij[2];
+  }
+
+  w_i(i, 0) = w[0];
+  w_i(i, 1) = w[1];
+  w_i(i, 2) = w[2];
+}
+
+template<class DeviceType>
+template<bool friction, bool random, bool group_all>
+KOKKOS_INLINE_FUNCTION
+void FixEPHKokkosKernels<DeviceType>::operator()(TagFixEPHPRL<friction, random, group_all>, const int& i) const {
+  if(!(group_all || (mask(i) & groupbit))) return;
+  if(!(rho_i(i) > 0)) return;
+  if(!(alpha_rho_i(i) > 0)) return;
+
+  const int itype = type_map(type(i) - 1);
+
+  double f_e[3] {0, 0, 0};
+  double f_r[3] {0, 0, 0};
+
+  const int jnum = numneigh(i);
+
+  for(int jj = 0; jj < jnum; ++jj) {
+    const int j = neighbors(i, jj) & NEIGHMASK;
+
+    double e_ij[3];
+    double r_sq = get_difference_sq(i, j, e_ij);
+
+    if(!(r_sq < r_cutoff_sq)) continue;
+    if(!(alpha_rho_i(j) > 0)) continue;
+
+    double inv_r_sq = 1.0 / r_sq;
+    double a_ij = beta.get_rho_r_sq(type_map(type(j) - 1), r_sq) * inv_r_sq * alpha_rho_i(i);
+    double a_ji = beta.get_rho_r_sq(itype, r_sq) * inv_r_sq * alpha_rho_i(j);
+
+    if(friction) {
+      double var =
+        e_ij[0] * (a_ij * w_i(i, 0) - a_ji * w_i(j, 0)) +
+        e_ij[1] * (a_ij * w_i(i, 1) - a_ji * w_i(j, 1)) +
+        e_ij[2] * (a_ij * w_i(i, 2) - a_ji * w_i(j, 2));
+
+      // friction is negative!
+      f_e[0] -= var * e_ij[0];
+      f_e[1] -= var * e_ij[1];
+      f_e[2] -= var * e_ij[2];
+    }
+
+    if(random) {
+      double var =
+        e_ij[0] * (a_ij * xi_i(i, 0) - a_ji * xi_i(j, 0)) +
+        e_ij[1] * (a_ij * xi_i(i, 1) - a_ji * xi_i(j, 1)) +
+        e_ij[2] * (a_ij * xi_i(i, 2) - a_ji * xi_i(j, 2));
+
+      f_r[0] += var * e_ij[0];
+      f_r[1] += var * e_ij[1];
+      f_r[2] += var * e_ij[2];
+    }
+  }
+
+  if(friction) {
+    f_EPH(i, 0) = f_e[0];
+    f_EPH(i, 1) = f_e[1];
+    f_EPH(i, 2) = f_e[2];
+  }
+
+  if(random) {
+    double var = eta_factor * sqrt(T_e_i(i));
+    f_RNG(i, 0) = f_r[0] * var;
+    f_RNG(i, 1) = f_r[1] * var;
+    f_RNG(i, 2) = f_r[2] * var;
+  }
+}
+
+template<class DeviceType>
+template<bool friction, bool random>
+KOKKOS_INLINE_FUNCTION
+void FixEPHKokkosKernels<DeviceType>::operator()(TagFixEPHApply<friction, random>, const int& i) const {
+  if(friction) {
+    f(i, 0) += f_EPH(i, 0);
+    f(i, 1) += f_EPH(i, 1);
+    f(i, 2) += f_EPH(i, 2);
+  }
+
+  if(random) {
+    f(i, 0) += f_RNG(i, 0);
+    f(i, 1) += f_RNG(i, 1);
+    f(i, 2) += f_RNG(i, 2);
+  }
+}
+
+template<class DeviceType>
+KOKKOS_INLINE_FUNCTION
+void FixEPHKokkosKernels<DeviceType>::operator()(TagFixEPHInitialIntegrate, const int& i) const {
+  if(!(mask(i) & groupbit)) return;
+
+  double dtfm = dtf / mass(type(i));
+  v(i, 0) += dtfm * f(i, 0);
+  v(i, 1) += dtfm * f(i, 1);
+  v(i, 2) += dtfm * f(i, 2);
+
+  x(i, 0) += dtv * v(i, 0);
+  x(i, 1) += dtv * v(i, 1);
+  x(i, 2) += dtv * v(i, 2);
+}
+
+template<class DeviceType>
+KOKKOS_INLINE_FUNCTION
+void FixEPHKokkosKernels<DeviceType>::operator()(TagFixEPHFinalIntegrate, const int& i) const {
+  if(!(mask(i) & groupbit)) return;
+
+  double dtfm = dtf / mass(type(i));
+  v(i, 0) += dtfm * f(i, 0);
+  v(i, 1) += dtfm * f(i, 1);
+  v(i, 2) += dtfm * f(i, 2);
+}
+
+}
+
+#endif
@@ -0,0 +1,588 @@
+/*
+ * Authors of the extension Artur Tamm, Alfredo Correa
+ * e-mail: artur.tamm.work@gmail.com
+ */
+
+#ifdef EPH_OMP
+
+// external headers
+#include <omp.h>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+// lammps headers
+#include "error.h"
+#include "neighbor.h"
+#include "neigh_list.h"
+#include "atom.h"
+#include "update.h"
+#include "comm.h"
+
+// internal headers
+#include "fix_eph.h"
+#include "fix_eph_omp.h"
+
+using namespace LAMMPS_NS;
+using namespace FixConst;
+
+// constructor
+FixEPHOMP::FixEPHOMP(LAMMPS *lmp, int narg, char **arg) :
+  FixEPH(lmp, narg, arg)
+{
+  // with a half list a pair writes to both atoms and owner computes does not hold
+  if(eph_flag & Flag::HALF_LIST)
+    error->all(FLERR, "FixEPHOMP: half neighbour list cannot be used with eph/omp");
+
+  if(myID == 0) {
+    std::cout << "OpenMP threads per task: " << omp_get_max_threads() << "\n\n";
+  }
+}
+
+void FixEPHOMP::init()
+{
+  // one block of atoms per thread
+  thread_data.resize(omp_get_max_threads());
+
+  FixEPH::init();
+}
+
+// the pairs and W operators live in the blocks of the threads
+FixEPH::MemoryComponents FixEPHOMP::get_memory_components()
+{
+  MemoryComponents components = FixEPH::get_memory_components();
+
+  double pair_bytes = 0;
+  double w_bytes = 0;
+
+  for(const ThreadData& td : thread_data)
+  {
+    pair_bytes += td.pairs.capacity() * sizeof(Pair) + td.pair_first.capacity() * sizeof(size_t);
+    w_bytes += td.w_operator.memory_bytes();
+  }
+
+  components.emplace_back("Thread pair caches", pair_bytes + thread_data.capacity() * sizeof(ThreadData));
+  components.emplace_back("Thread W operators", w_bytes);
+  components.emplace_back("Energy deposition",
+    dE_i.capacity() * sizeof(double) + 
+    (cell_i.capacity() + cell_start.capacity() + cell_atoms.capacity()) * sizeof(size_t));
+
+  return components;
+}
+
+void FixEPHOMP::calculate_environment()
+{
+  double **x = atom->x;
+  int *type = atom->type;
+  int *mask = atom->mask;
+  int nlocal = atom->nlocal;
+
+  int *numneigh = list->numneigh;
+  int **firstneigh = list->firstneigh;
+
+  // same as FixEPH::calculate_environment() on a full list; the pairs of a
+  // block go to its thread
+  const bool pair_densities = (eph_model == Model::PRB || eph_model == Model::PRLCM || eph_model == Model::PRL);
+  const bool build_w = (eph_model == Model::PRL);
+  const bool cache_pairs = pair_densities && !build_w;
+
+  const size_t n_blocks = thread_data.size();
+
+  EPH_PRAGMA_OMP(omp parallel for schedule(static, 1))
+  for(size_t b = 0; b < n_blocks; ++b)
+  {
+    ThreadData& td = thread_data[b];
+    td.first = (nlocal * b) / n_blocks;
+    td.last = (nlocal * (b + 1)) / n_blocks;
+
+    td.pairs.clear();
+    td.pair_first.resize(td.last - td.first + 1);
+    td.w_operator.clear();
+    td.w_operator.first_row = td.first;
+
+    for(size_t i = td.first; i != td.last; ++i)
+    {
+      rho_i[i] = 0;
+      alpha_rho_i[i] = 0;
+      td.pair_first[i - td.first] = td.pairs.size();
+      if(build_w) { td.w_operator.add_row(); }
+
+      if(!(mask[i] & groupbit)) continue;
+
+      int itype = type[i];
+      int *jlist = firstneigh[i];
+      int jnum = numneigh[i];
+
+      for(size_t j = 0; j != jnum; ++j) {
+        int jj = jlist[j];
+        jj &= NEIGHMASK;
+
+        int jtype = type[jj];
+        double e_ij[3];
+        double r_sq = get_difference_sq(x[jj], x[i], e_ij);
+
+        if(r_sq < r_cutoff_sq)
+        {
+          double v_rho_ji = beta.get_rho_r_sq(type_map[jtype-1], r_sq);
+          rho_i[i] += v_rho_ji;
+
+          double v_rho_ij = 0;
+          if(pair_densities) { v_rho_ij = beta.get_rho_r_sq(type_map[itype-1], r_sq); }
+
+          if(cache_pairs)
+          {
+            Pair pair;
+            pair.j = jj;
+            pair.e_ij[0] = e_ij[0];
+            pair.e_ij[1] = e_ij[1];
+            pair.e_ij[2] = e_ij[2];
+            pair.inv_r_sq = 1.0 / r_sq;
+            pair.rho_ji = v_rho_ji;
+            pair.rho_ij = v_rho_ij;
+            td.pairs.push_back(pair);
+          }
+
+          if(build_w)
+          {
+            double inv_r_sq = 1.0 / r_sq;
+            td.w_operator.add_pair(jj, e_ij, v_rho_ji * inv_r_sq, v_rho_ij * inv_r_sq);
+          }
+        }
+      }
+
+      // prefactor used by every neighbour of i
+      if(rho_i[i] > 0) { alpha_rho_i[i] = beta.get_alpha(type_map[itype - 1], rho_i[i]) / rho_i[i]; }
+    }
+
+    td.pair_first[td.last - td.first] = td.pairs.size();
+  }
+}
+
+template<bool friction, bool random, bool group_all>
+void FixEPHOMP::force_ttm()
+{
+  double **x = atom->x;
+  double **v = atom->v;
+  int *mask = atom->mask;
+  int *type = atom->type;
+  int nlocal = atom->nlocal;
+
+  EPH_PRAGMA_OMP(omp parallel for schedule(static))
+  for(int i = 0; i < nlocal; ++i) {
+    if(!(group_all || (mask[i] & groupbit))) continue;
+
+    int itype = type[i];
+
+    // create friction forces
+    if(friction) {
+      double var = -beta.get_beta(type_map[itype - 1], rho_i[i]);
+
+      f_EPH[i][0] = var * v[i][0];
+      f_EPH[i][1] = var * v[i][1];
+      f_EPH[i][2] = var * v[i][2];
+    }
+
+    // create random forces
+    if(random) {
+      double v_Te = fdm.get_T(x[i][0], x[i][1], x[i][2]);
+      double var = eta_factor * beta.get_alpha(type_map[itype - 1], rho_i[i]) * sqrt(v_Te);
+      f_RNG[i][0] = var * xi_i[i][0];
+      f_RNG[i][1] = var * xi_i[i][1];
+      f_RNG[i][2] = var * xi_i[i][2];
+    }
+  }
+}
+
+template<bool friction, bool random, bool group_all>
+void FixEPHOMP::force_prb()
+{
+  double **x = atom->x;
+  double **v = atom->v;
+  int *type = atom->type;
+  int *mask = atom->mask;
+
+  const size_t n_blocks = thread_data.size();
+
+  EPH_PRAGMA_OMP(omp parallel for schedule(static, 1))
+  for(size_t b = 0; b < n_blocks; ++b)
+  {
+    const ThreadData& td = thread_data[b];
+    const Pair* pair = td.pairs.data();
+
+    for(size_t i = td.first; i != td.last; ++i) {
+      if(!(group_all || (mask[i] & groupbit))) continue;
+
+      int itype = type[i];
+      const size_t k = i - td.first;
+
+      // create friction forces
+      if(friction && rho_i[i] > 0) {
+        double inv_rho = 1.0 / rho_i[i];
+
+        f_EPH[i][0] = v[i][0];
+        f_EPH[i][1] = v[i][1];
+        f_EPH[i][2] = v[i][2];
+
+        for(size_t p = td.pair_first[k]; p != td.pair_first[k + 1]; ++p) {
+          int jj = pair[p].j;
+          double var = pair[p].rho_ji * inv_rho;
+
+          f_EPH[i][0] -= var * v[jj][0];
+          f_EPH[i][1] -= var * v[jj][1];
+          f_EPH[i][2] -= var * v[jj][2];
+        }
+
+        double var = beta.get_beta(type_map[itype - 1], rho_i[i]);
+        f_EPH[i][0] *= var;
+        f_EPH[i][1] *= var;
+        f_EPH[i][2] *= var;
+      }
+
+      // create random forces
+      if(random) {
+        double v_Te = fdm.get_T(x[i][0], x[i][1], x[i][2]);
+        double var = eta_factor * beta.get_alpha(type_map[itype - 1], rho_i[i]) * sqrt(v_Te);
+
+        f_RNG[i][0] = var * xi_i[i][0];
+        f_RNG[i][1] = var * xi_i[i][1];
+        f_RNG[i][2] = var * xi_i[i][2];
+      }
+    }
+  }
+}
+
+template<bool friction, bool random, bool group_all>
+void FixEPHOMP::force_prlcm()
+{
+  double **x = atom->x;
+  double **v = atom->v;
+  int *type = atom->type;
+  int *mask = atom->mask;
+
+  const size_t n_blocks = thread_data.size();
+
+  // w_i of the friction has to reach the ghosts before the forces
+  if(friction) {
+    EPH_PRAGMA_OMP(omp parallel for schedule(static, 1))
+    for(size_t b = 0; b < n_blocks; ++b)
+    {
+      const ThreadData& td = thread_data[b];
+      const Pair* pair = td.pairs.data();
+
+      for(size_t i = td.first; i != td.last; ++i) {
+        if(!(group_all || (mask[i] & groupbit))) continue;
+
+        int itype = type[i];
+        const size_t k = i - td.first;
+
+        double alpha_i = beta.get_alpha(type_map[itype - 1], rho_i[i]);
+        w_i[i][0] = alpha_i * v[i][0];
+        w_i[i][1] = alpha_i * v[i][1];
+        w_i[i][2] = alpha_i * v[i][2];
+
+        if(!(rho_i[i] > 0.0)) continue;
+
+        double inv_rho = 1.0 / rho_i[i];
+
+        for(size_t p = td.pair_first[k]; p != td.pair_first[k + 1]; ++p) {
+          int jj = pair[p].j;
+          double var = alpha_i * pair[p].rho_ji * inv_rho;
+
+          w_i[i][0] -= var * v[jj][0];
+          w_i[i][1] -= var * v[jj][1];
+          w_i[i][2] -= var * v[jj][2];
+        }
+      }
+    }
+    timer.lap(EPH_Timer::W_PASS);
+
+    state = FixState::WI;
+    comm->forward_comm(this);
+    timer.lap(EPH_Timer::COMM_W);
+  }
+
+  // now calculate the friction and random forces
+  EPH_PRAGMA_OMP(omp parallel for schedule(static, 1))
+  for(size_t b = 0; b < n_blocks; ++b)
+  {
+    const ThreadData& td = thread_data[b];
+    const Pair* pair = td.pairs.data();
+
+    for(size_t i = td.first; i != td.last; ++i) {
+      if(!(group_all || (mask[i] & groupbit))) continue;
+
+      int itype = type[i];
+      const size_t k = i - td.first;
+
+      double alpha_i = beta.get_alpha(type_map[itype - 1], rho_i[i]);
+
+      if(friction) {
+        f_EPH[i][0] = alpha_i * w_i[i][0];
+        f_EPH[i][1] = alpha_i * w_i[i][1];
+        f_EPH[i][2] = alpha_i * w_i[i][2];
+      }
+
+      if(random) {
+        f_RNG[i][0] = alpha_i * xi_i[i][0];
+        f_RNG[i][1] = alpha_i * xi_i[i][1];
+        f_RNG[i][2] = alpha_i * xi_i[i][2];
+      }
+
+      for(size_t p = td.pair_first[k]; p != td.pair_first[k + 1]; ++p) {
+        int jj = pair[p].j;
+
+        if(!(rho_i[jj] > 0.0)) continue;
+
+        double var = alpha_rho_i[jj] * pair[p].rho_ij;
+
+        if(friction) {
+          f_EPH[i][0] -= var * w_i[jj][0];
+          f_EPH[i][1] -= var * w_i[jj][1];
+          f_EPH[i][2] -= var * w_i[jj][2];
+        }
+
+        if(random) {
+          f_RNG[i][0] -= var * xi_i[jj][0];
+          f_RNG[i][1] -= var * xi_i[jj][1];
+          f_RNG[i][2] -= var * xi_i[jj][2];
+        }
+      }
+
+      if(random) {
+        double v_Te = fdm.get_T(x[i][0], x[i][1], x[i][2]);
+        double var = eta_factor * sqrt(v_Te);
+        f_RNG[i][0] *= var;
+        f_RNG[i][1] *= var;
+        f_RNG[i][2] *= var;
+      }
+    }
+  }
+}
+
+template<bool friction, bool random, bool group_all>
+void FixEPHOMP::force_prl()
+{
+  double **x = atom->x;
+  double **v = atom->v;
+  int *mask = atom->mask;
+
+  const size_t n_blocks = thread_data.size();
+
+  // every thread applies the W operator of its block of atoms
+  EPH_PRAGMA_OMP(omp parallel for schedule(static, 1))
+  for(size_t b = 0; b < n_blocks; ++b)
+  {
+    EPH_BlockCSR& w_block = thread_data[b].w_operator;
+    w_block.assemble(alpha_rho_i);
+
+    // w_i = W_ij^T v_j
+    if(friction) { w_block.apply_transpose(v, w_i); }
+  }
+
+  if(friction)
+  {
+    timer.lap(EPH_Timer::W_PASS);
+
+    state = FixState::WI;
+    comm->forward_comm(this);
+    timer.lap(EPH_Timer::COMM_W);
+  }
+
+  EPH_PRAGMA_OMP(omp parallel for schedule(static, 1))
+  for(size_t b = 0; b < n_blocks; ++b)
+  {
+    const ThreadData& td = thread_data[b];
+
+    // f_i = W_ij w_j and f_i = W_ij xi_j
+    if(friction && random) td.w_operator.apply(w_i, f_EPH, xi_i, f_RNG);
+    else if(friction) td.w_operator.apply(w_i, f_EPH);
+    else if(random) td.w_operator.apply(xi_i, f_RNG);
+
+    for(size_t i = td.first; i != td.last; ++i)
+    {
+      if(!(group_all || (mask[i] & groupbit))) continue;
+      if(!(rho_i[i] > 0)) continue;
+
+      // friction is negative!
+      if(friction)
+      {
+        f_EPH[i][0] = -f_EPH[i][0];
+        f_EPH[i][1] = -f_EPH[i][1];
+        f_EPH[i][2] = -f_EPH[i][2];
+      }
+
+      if(random)
+      {
+        double v_Te = fdm.get_T(x[i][0], x[i][1], x[i][2]);
+        double var = eta_factor * sqrt(v_Te);
+        f_RNG[i][0] *= var;
+        f_RNG[i][1] *= var;
+        f_RNG[i][2] *= var;
+      }
+    }
+  }
+}
+
+// threaded kernel of the selected model for one combination of terms and group
+template<bool friction, bool random, bool group_all>
+FixEPH::ForceKernel FixEPHOMP::get_force_kernel() {
+  switch(eph_model) {
+    case Model::NONE: return &FixEPHOMP::force_none;
+    case Model::TTM: return static_cast<ForceKernel>(&FixEPHOMP::force_ttm<friction, random, group_all>);
+    case Model::PRB: return static_cast<ForceKernel>(&FixEPHOMP::force_prb<friction, random, group_all>);
+    case Model::PRLCM: return static_cast<ForceKernel>(&FixEPHOMP::force_prlcm<friction, random, group_all>);
+    case Model::PRL: return static_cast<ForceKernel>(&FixEPHOMP::force_prl<friction, random, group_all>);
+    case Model::TESTING: return &FixEPHOMP::force_testing;
+    default: error->all(FLERR, "FixEPHOMP: unknown model");
+  }
+
+  return nullptr;
+}
+
+void FixEPHOMP::select_force_kernel() {
+  const bool friction = (eph_flag & Flag::FRICTION);
+  const bool random = (eph_flag & Flag::RANDOM);
+  const bool group_all = (igroup == 0); // group all is always the first group
+
+  if(friction && random) {
+    force_kernel = group_all ? get_force_kernel<true, true, true>() : get_force_kernel<true, true, false>();
+  }
+  else if(friction) {
+    force_kernel = group_all ? get_force_kernel<true, false, true>() : get_force_kernel<true, false, false>();
+  }
+  else if(random) {
+    force_kernel = group_all ? get_force_kernel<false, true, true>() : get_force_kernel<false, true, false>();
+  }
+  else {
+    force_kernel = group_all ? get_force_kernel<false, false, true>() : get_force_kernel<false, false, false>();
+  }
+}
+
+double FixEPHOMP::deposit_energy()
+{
+  double **x = atom->x;
+  double **v = atom->v;
+  int *mask = atom->mask;
+  int nlocal = atom->nlocal;
+
+  const bool friction = (eph_flag & Flag::FRICTION);
+  const bool random = (eph_flag & Flag::RANDOM);
+
+  dE_i.resize(2 * nlocal);
+  cell_i.resize(nlocal);
+
+  // work of the forces and the grid cell of every atom
+  EPH_PRAGMA_OMP(omp parallel for schedule(static))
+  for(int i = 0; i < nlocal; ++i) {
+    double dE_f = 0.0;
+    double dE_r = 0.0;
+
+    if(mask[i] & groupbit) {
+      if(friction) {
+        dE_f -= f_EPH[i][0] * v[i][0] * update->dt;
+        dE_f -= f_EPH[i][1] * v[i][1] * update->dt;
+        dE_f -= f_EPH[i][2] * v[i][2] * update->dt;
+      }
+
+      if(random) {
+        dE_r -= f_RNG[i][0] * v[i][0] * update->dt;
+        dE_r -= f_RNG[i][1] * v[i][1] * update->dt;
+        dE_r -= f_RNG[i][2] * v[i][2] * update->dt;
+      }
+
+      cell_i[i] = fdm.get_cell(x[i][0], x[i][1], x[i][2]);
+    }
+
+    dE_i[2 * i] = dE_f;
+    dE_i[2 * i + 1] = dE_r;
+  }
+
+  // bucket the group atoms by cell with a stable counting sort, so the atoms
+  // of a cell stay in the order of FixEPH::deposit_energy()
+  const size_t n_cells = fdm.get_n_cells();
+
+  cell_start.assign(n_cells + 1, 0);
+  for(size_t i = 0; i < nlocal; ++i) {
+    if(mask[i] & groupbit) { ++cell_start[cell_i[i] + 1]; }
+  }
+
+  for(size_t c = 0; c < n_cells; ++c) { cell_start[c + 1] += cell_start[c]; }
+
+  cell_atoms.resize(cell_start[n_cells]);
+  for(size_t i = 0; i < nlocal; ++i) {
+    if(mask[i] & groupbit) { cell_atoms[cell_start[cell_i[i]]++] = i; }
+  }
+
+  // the insertion above moved every start to the next cell
+  for(size_t c = n_cells; c > 0; --c) { cell_start[c] = cell_start[c - 1]; }
+  cell_start[0] = 0;
+
+  // every thread takes about the same number of atoms, cut at cell boundaries,
+  // so no two threads insert into the same cell and every cell sums in the same order
+  const size_t n_atoms = cell_atoms.size();
+
+  EPH_PRAGMA_OMP(omp parallel)
+  {
+    size_t n_threads = omp_get_num_threads();
+    size_t thread = omp_get_thread_num();
+
+    // start of the cell of the atom at position n_atoms * t / n_threads
+    auto boundary = [&](size_t t) -> size_t {
+      size_t k = (n_atoms * t) / n_threads;
+      return k < n_atoms ? cell_start[cell_i[cell_atoms[k]]] : n_atoms;
+    };
+
+    size_t first = boundary(thread);
+    size_t last = boundary(thread + 1);
+
+    for(size_t term = 0; term < 2; ++term) {
+      if(term == 0 && !friction) continue;
+      if(term == 1 && !random) continue;
+
+      for(size_t k = first; k < last; ++k) {
+        size_t i = cell_atoms[k];
+        fdm.insert_energy(cell_i[i], dE_i[2 * i + term]);
+      }
+    }
+  }
+
+  double E_local = 0.0;
+
+  for(size_t term = 0; term < 2; ++term) {
+    if(term == 0 && !friction) continue;
+    if(term == 1 && !random) continue;
+
+    for(size_t i = 0; i < nlocal; ++i) {
+      if(mask[i] & groupbit) { E_local += dE_i[2 * i + term]; }
+    }
+  }
+
+  return E_local;
+}
+
+void FixEPHOMP::populate_array()
+{
+  int *type = atom->type;
+  int *mask = atom->mask;
+  int nlocal = atom->nlocal;
+
+  EPH_PRAGMA_OMP(omp parallel for schedule(static))
+  for(int i = 0; i < nlocal; ++i) {
+    if(mask[i] & groupbit) {
+      int itype = type[i];
+      array[i][ 0] = rho_i[i];
+      array[i][ 1] = beta.get_beta(type_map[itype - 1], rho_i[i]);
+      array[i][ 2] = f_EPH[i][0];
+      array[i][ 3] = f_EPH[i][1];
+      array[i][ 4] = f_EPH[i][2];
+      array[i][ 5] = f_RNG[i][0];
+      array[i][ 6] = f_RNG[i][1];
+      array[i][ 7] = f_RNG[i][2];
+    }
+    else {
+      std::fill_n(&(array[i][0]), size_peratom_cols, 0.0);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * This fix is a rewrite of our previous USER-EPH (a mod of fix_ttm) code and is based on our
+ * PRB 94, 024305 (2016) paper
+ **/
+
+/*
+ * Authors of the extension Artur Tamm, Alfredo Caro, Alfredo Correa, Mattias Klintenberg
+ * e-mail: artur.tamm.work@gmail.com
+ */
+
+#ifdef EPH_OMP
+
+#ifdef FIX_CLASS
+FixStyle(eph/omp,FixEPHOMP)
+#else
+
+#ifndef LMP_FIX_EPH_OMP_H
+#define LMP_FIX_EPH_OMP_H
+
+// external headers
+#include <vector>
+#include <cstddef>
+
+// lammps headers
+
+// internal headers
+#include "fix_eph.h"
+#include "eph_block_csr.h"
+
+namespace LAMMPS_NS {
+
+/*
+ * fix eph with OpenMP threads on every MPI rank
+ *
+ * Every thread owns a contiguous block of local atoms and computes only the
+ * values of its atoms from the full neighbour list (owner computes), so no
+ * two threads write to the same atom. The pairs and the W operator of a
+ * block are kept by its thread. The results are the same as with fix eph
+ * for any number of threads.
+ */
+class FixEPHOMP : public FixEPH {
+ public:
+    FixEPHOMP(class LAMMPS *, int, char **); // constructor
+
+    void init() override;
+
+  protected:
+    // neighbour pairs and W operator of the atoms [first, last) of one thread
+    struct ThreadData {
+      size_t first;
+      size_t last;
+      std::vector<Pair> pairs;
+      std::vector<size_t> pair_first; // pairs of atom first + k are [pair_first[k], pair_first[k + 1])
+      EPH_BlockCSR w_operator;
+    };
+
+    std::vector<ThreadData> thread_data;
+    std::vector<double> dE_i; // work of friction and random forces per atom, size = [2 * nlocal]
+    std::vector<size_t> cell_i; // FDM grid cell of every local atom, size = [nlocal]
+    std::vector<size_t> cell_start; // atoms of cell c are cell_atoms[cell_start[c], cell_start[c + 1]), size = [n_cells + 1]
+    std::vector<size_t> cell_atoms; // group atoms sorted by cell, in atom order within a cell
+
+    void calculate_environment() override;
+    double deposit_energy() override;
+    void populate_array() override;
+    void select_force_kernel() override;
+    MemoryComponents get_memory_components() override;
+
+    template<bool friction, bool random, bool group_all> ForceKernel get_force_kernel();
+
+    template<bool friction, bool random, bool group_all> void force_ttm();
+    template<bool friction, bool random, bool group_all> void force_prb();
+    template<bool friction, bool random, bool group_all> void force_prlcm();
+    template<bool friction, bool random, bool group_all> void force_prl();
+};
+
+}
+#endif
+#endif
+#endif
@@ -66,6 +66,13 @@ struct EPH_GPU
   // member functions  
   void grow(size_t ngrow);
   void grow_neigh(size_t ngrow);
+  
+  // bytes of the per atom and neighbour arrays in gpu memory, see grow()
+  size_t memory_bytes() const
+  {
+    size_t atom_bytes = 2 * sizeof(int) + 6 * sizeof(double3d) + 4 * sizeof(double);
+    return n * atom_bytes + n_neigh * sizeof(int);
+  }
 };
 
 // this is done on purpose
@@ -0,0 +1,71 @@
+/*
+ * Authors of the extension Artur Tamm, Alfredo Correa
+ * e-mail: artur.tamm.work@gmail.com
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <stdexcept>
+
+#include "eph_frames.h"
+
+/*
+ * Reads the binary temperature frames of fix eph (flags 2048 and 4096).
+ *
+ * usage:
+ *   convert <frames>                    list the header and the frames
+ *   convert <frames> <prefix>           every frame to <prefix>_<step>
+ *   convert <frames> <prefix> <frame>   frame number <frame> only
+ *
+ * The text files have the layout of the per frame output of fix eph, so
+ * they can be read by the same tools (e.g. visit Point3D).
+ */
+
+static void write_frame(EPH_FrameReader& reader, size_t frame, const char* prefix) {
+  char filename[4096];
+  sprintf(filename, "%s_%06ld", prefix, static_cast<long>(reader.get_step(frame)));
+
+  FILE* fd = fopen(filename, "w");
+  if(fd == nullptr) { throw std::runtime_error(std::string("cannot open ") + filename); }
+
+  reader.write_text(frame, fd);
+  fclose(fd);
+
+  printf("frame %zu (step %ld) -> %s\n", frame, static_cast<long>(reader.get_step(frame)), filename);
+}
+
+int main(int args, char **argv) {
+  if(args < 2) {
+    printf("usage: %s <frames> [prefix [frame]]\n", argv[0]);
+    return 1;
+  }
+
+  try {
+    EPH_FrameReader reader(argv[1]);
+    const EPH_FrameHeader& header = reader.get_header();
+
+    if(args == 2) {
+      printf("# version %u, %s values\n", header.version, header.value_size == sizeof(float) ? "float" : "double");
+      printf("# grid %lu %lu %lu\n",
+        static_cast<unsigned long>(header.n[0]), static_cast<unsigned long>(header.n[1]), static_cast<unsigned long>(header.n[2]));
+      printf("# box %.6e %.6e %.6e %.6e %.6e %.6e\n",
+        header.lo[0], header.hi[0], header.lo[1], header.hi[1], header.lo[2], header.hi[2]);
+      printf("# %zu frames\n# frame step\n", reader.get_n_frames());
+
+      for(size_t k = 0; k < reader.get_n_frames(); ++k) { printf("%zu %ld\n", k, static_cast<long>(reader.get_step(k))); }
+    }
+    else if(args == 3) {
+      for(size_t k = 0; k < reader.get_n_frames(); ++k) { write_frame(reader, k, argv[2]); }
+    }
+    else {
+      write_frame(reader, atol(argv[3]), argv[2]);
+    }
+  }
+  catch(std::exception& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
@@ -6,14 +6,10 @@ kB = 8.617333262145e-5;
 Zs = [29]; # use Zs = [1; 2; 3]; for multiple elements
 Elems = ["Cu"]; # use Elems = ["A"; "B"; "C"] for multiple elements
 N = length(Zs); # number of types
-N_pairs = 1;
+N_pairs = N*(N+1) / 2; # one table for every i <= j
 
 N_atoms = [2];
 
-if(N > 1)
-  N_pairs = (N+1)*(N-1) / 2;
-endif
-
 r_max = 5.0; # cutoff for spatial correlations
 N_r = 1001; # number of points for table
 dr = r_max / (N_r - 1);